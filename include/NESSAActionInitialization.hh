@@ -3,14 +3,31 @@
 
 #include "G4VUserActionInitialization.hh"
 
+class NESSARunMessenger;
+class NESSAMeshMessenger;
+class NESSASurfaceMessenger;
+class NESSACellMessenger;
+class NESSAWeightWindowMessenger;
+class NESSAAdjointMessenger;
+class NESSASourceMessenger;
+
 class NESSAActionInitialization : public G4VUserActionInitialization
 {
 public:
-    NESSAActionInitialization() = default;
-    ~NESSAActionInitialization() override = default;
+    NESSAActionInitialization();
+    ~NESSAActionInitialization() override;
 
     void BuildForMaster() const override;
     void Build() const override;
+    
+private:
+    NESSARunMessenger*     fRunMessenger;     // /nessa/run/ commands (master only)
+    NESSAMeshMessenger*    fMeshMessenger;    // /nessa/mesh/ commands (master only)
+    NESSASurfaceMessenger* fSurfaceMessenger; // /nessa/surface/ commands (master only)
+    NESSACellMessenger*    fCellMessenger;    // /nessa/cell/ commands (master only)
+    NESSAWeightWindowMessenger* fWeightWindowMessenger; // /nessa/ww/ commands (master only)
+    NESSAAdjointMessenger* fAdjointMessenger; // /nessa/adjoint/ commands (master only)
+    NESSASourceMessenger*  fSourceMessenger;  // /nessa/source/ commands (master only)
 };
 
 #endif
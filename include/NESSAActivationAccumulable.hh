@@ -0,0 +1,37 @@
+#ifndef NESSAActivationAccumulable_h
+#define NESSAActivationAccumulable_h 1
+
+#include "G4VAccumulable.hh"
+#include "NESSASteppingAction.hh"
+
+/// Run-level activation tables (global and per-volume isotope production).
+/// Each worker copies its NESSASteppingAction maps in once at end of run;
+/// G4AccumulableManager::Merge() then reduces them into the master copy,
+/// so transport itself never takes a lock.
+class NESSAActivationAccumulable : public G4VAccumulable
+{
+public:
+    using IsotopeMap       = NESSASteppingAction::IsotopeMap;
+    using VolumeIsotopeMap = NESSASteppingAction::VolumeIsotopeMap;
+    
+    explicit NESSAActivationAccumulable(const G4String& name = "activation")
+        : G4VAccumulable(name) {}
+    ~NESSAActivationAccumulable() override = default;
+    
+    void Merge(const G4VAccumulable& other) override;
+    void Reset() override;
+    
+    /// Add production tables (e.g. one thread's stepping action maps)
+    void Add(const IsotopeMap& global, const VolumeIsotopeMap& volumes);
+    
+    const IsotopeMap&       GetGlobalProduction() const { return fGlobalProd; }
+    const VolumeIsotopeMap& GetVolumeProduction() const { return fVolumeProd; }
+    
+private:
+    static void AddRecords(IsotopeMap& into, const IsotopeMap& from);
+    
+    IsotopeMap       fGlobalProd;
+    VolumeIsotopeMap fVolumeProd;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef NESSAAdjointConfig_h
+#define NESSAAdjointConfig_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include "G4AutoLock.hh"
+#include <vector>
+
+/// Set-up of the deterministic adjoint solver (NESSAAdjointSolver);
+/// a singleton like NESSAMeshConfig, changed from macros on the master.
+class NESSAAdjointConfig {
+public:
+    enum Response { kFlux, kDose };
+    
+    static NESSAAdjointConfig& Instance() {
+        static NESSAAdjointConfig instance;
+        return instance;
+    }
+    
+    /// Box [cm] and voxels per axis of the solver mesh (also the mesh of
+    /// the windows it writes)
+    const G4double* GetLo() const { return fLo; }
+    const G4double* GetHi() const { return fHi; }
+    const G4int* GetN() const { return fN; }
+    void SetMesh(const G4double lo[3], const G4double hi[3], const G4int n[3]) {
+        G4AutoLock lock(&fMutex);
+        for (G4int k = 0; k < 3; k++) {
+            fLo[k] = lo[k];
+            fHi[k] = hi[k];
+            fN[k] = n[k];
+        }
+    }
+    
+    /// Neutron group upper bounds [MeV], rising; the lowest group starts
+    /// at 1e-11 MeV
+    const std::vector<G4double>& GetGroups() const { return fGroups; }
+    void SetGroups(const std::vector<G4double>& bounds) {
+        G4AutoLock lock(&fMutex);
+        fGroups = bounds;
+    }
+    
+    /// Detectors (NESSAScoringConfig names) carrying the adjoint source
+    const std::vector<G4String>& GetTargets() const { return fTargets; }
+    void SetTargets(const std::vector<G4String>& names) {
+        G4AutoLock lock(&fMutex);
+        fTargets = names;
+    }
+    
+    /// Detector response: flux, or dose with the /nessa/dose/ coefficients
+    Response GetResponse() const { return fResponse; }
+    void SetResponse(Response r) { fResponse = r; }
+    
+    /// Material sampling points per voxel and axis (default 2)
+    G4int GetSampling() const { return fSampling; }
+    void SetSampling(G4int n) { fSampling = n; }
+    
+    /// Solver threads, 0 = all cores
+    G4int GetThreads() const { return fThreads; }
+    void SetThreads(G4int n) { fThreads = n; }
+    
+    /// Distance from the source [cm] at which the importance of an
+    /// emission direction is read (default 30)
+    G4double GetLookAhead() const { return fLookAhead; }
+    void SetLookAhead(G4double d) { fLookAhead = d; }
+    
+    /// Output base: <base>_ww.bin and <base>_bias.dat
+    const G4String& GetOutput() const { return fOutput; }
+    void SetOutput(const G4String& base) { fOutput = base; }
+    
+private:
+    NESSAAdjointConfig() = default;
+    
+    G4double fLo[3] = {-250., 50., 0.};    // the bunker and the detectors around it
+    G4double fHi[3] = {450., 1000., 450.};
+    G4int    fN[3] = {70, 95, 45};
+    std::vector<G4double> fGroups = {1e-7, 1e-5, 1e-3, 0.1, 1., 3., 10., 20.};
+    std::vector<G4String> fTargets;
+    Response fResponse = kFlux;
+    G4int    fSampling = 2;
+    G4int    fThreads = 0;
+    G4double fLookAhead = 30.;
+    G4String fOutput = "nessa_adjoint";
+    mutable G4Mutex fMutex = G4MUTEX_INITIALIZER;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef NESSAAdjointMessenger_h
+#define NESSAAdjointMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIdirectory.hh"
+
+/// Macro commands for the deterministic adjoint solver (NESSAAdjointSolver):
+///   /nessa/adjoint/mesh x0 y0 z0 x1 y1 z1 nx ny nz
+///   /nessa/adjoint/groups e1 e2 ...
+///   /nessa/adjoint/target name [name ...]
+///   /nessa/adjoint/response flux|dose
+///   /nessa/adjoint/sampling n
+///   /nessa/adjoint/threads n
+///   /nessa/adjoint/lookAhead d
+///   /nessa/adjoint/output base
+///   /nessa/adjoint/solve
+class NESSAAdjointMessenger : public G4UImessenger
+{
+public:
+    NESSAAdjointMessenger();
+    ~NESSAAdjointMessenger() override;
+    void SetNewValue(G4UIcommand*, G4String) override;
+    
+private:
+    G4UIdirectory*           fAdjointDir;
+    G4UIcmdWithAString*      fMeshCmd;
+    G4UIcmdWithAString*      fGroupsCmd;
+    G4UIcmdWithAString*      fTargetCmd;
+    G4UIcmdWithAString*      fResponseCmd;
+    G4UIcmdWithAnInteger*    fSamplingCmd;
+    G4UIcmdWithAnInteger*    fThreadsCmd;
+    G4UIcmdWithADouble*      fLookAheadCmd;
+    G4UIcmdWithAString*      fOutputCmd;
+    G4UIcmdWithoutParameter* fSolveCmd;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef NESSAAdjointSolver_h
+#define NESSAAdjointSolver_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include "G4ThreeVector.hh"
+#include <vector>
+
+class G4Material;
+class NESSAPrimaryGeneratorAction;
+
+/// Coarse-mesh multigroup diffusion solver for the neutron adjoint flux
+/// of a detector response, used for CADIS-style biasing:
+///   - the geometry is voxelised on a Cartesian mesh by sampling the
+///     material at a few points per voxel (volume-fraction mixtures of
+///     the materials of NESSADetectorConstruction)
+///   - group constants come from the Geant4 hadronic cross sections
+///     (elastic, inelastic, capture), averaged over each group in
+///     lethargy; elastic transfer is the exact isotropic-CM kernel per
+///     element, inelastic emits one neutron at min(E/2, 2 MeV), capture
+///     removes it, there is no upscatter
+///   - every group is a cell-centred finite-difference diffusion problem
+///     with Marshak vacuum boundaries, solved by Jacobi-preconditioned
+///     conjugate gradients on several threads, from the thermal group up
+///     (downscatter only, so one sweep is exact)
+///   - the adjoint source is the response (flux or dose coefficient) in
+///     the voxels holding the target detectors
+/// Outputs, with R the response per source neutron (adjoint flux folded
+/// with the source spectrum at the source voxel):
+///   <base>_ww.bin    weight windows, wl = 2/(1 + WUPN) R / phi+, also
+///                    loaded for the next runs (neutrons only)
+///   <base>_bias.dat  biased direction-bin probabilities of the Adelphi
+///                    source, p_i I_i / sum p_j I_j, with I_i the adjoint
+///                    flux a look-ahead distance along the bin, folded
+///                    with the bin's energy spectrum; also loaded, as
+///                    with /nessa/source/biasFile
+/// Run on the master between runs (/nessa/adjoint/solve).
+class NESSAAdjointSolver
+{
+public:
+    /// Solve with the settings of NESSAAdjointConfig and write the
+    /// outputs; false with a message
+    G4bool Run(G4String& error);
+    
+private:
+    /// Homogenised group constants [1/cm] of a material or a mixture
+    struct GroupConstants {
+        std::vector<G4double> transport;   // per group
+        std::vector<G4double> removal;     // total minus in-group scattering
+        std::vector<G4double> transfer;    // g*G + g', g' > g (to lower energy)
+    };
+    
+    G4int NVoxels() const { return fN[0] * fN[1] * fN[2]; }
+    G4int Voxel(const G4ThreeVector& x) const;  // [cm], -1 outside
+    G4ThreeVector VoxelCentre(G4long v) const;  // [cm]
+    G4double VoxelVolume() const { return fH[0] * fH[1] * fH[2]; }
+    G4int NThreads() const;
+    
+    GroupConstants MaterialConstants(const G4Material* material) const;
+    void Voxelise();
+    G4bool BuildAdjointSource(G4String& error);
+    /// Solve group g in place into fAdjoint; returns the iterations
+    G4int SolveGroup(G4int g, G4double& residual);
+    /// Weight windows and source bias from the adjoint flux
+    G4bool WriteOutputs(const NESSAPrimaryGeneratorAction& source, G4String& error);
+    
+    G4double fLo[3], fH[3];        // [cm]
+    G4int    fN[3];
+    G4int    fNGroups = 0;
+    std::vector<G4double> fBounds; // group boundaries [MeV], falling: group g is [fBounds[g+1], fBounds[g]]
+    std::vector<GroupConstants> fMixtures;
+    std::vector<G4int> fMixtureOfVoxel;
+    std::vector<G4double> fSource;   // adjoint source, g*NVoxels + voxel [1/cm3]
+    std::vector<G4double> fAdjoint;  // adjoint flux, g*NVoxels + voxel
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef NESSACellConfig_h
+#define NESSACellConfig_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include "G4AutoLock.hh"
+#include <array>
+#include <map>
+
+/// Per-cell settings, keyed by MCNP cell number (the copy number of the
+/// placement): the all-cell tally (NESSACellTally) and the neutron and
+/// photon importances (NESSACellImportance). A shared singleton like
+/// NESSAMeshConfig: changed from macros on the master between runs and
+/// read by every thread at the start of a run.
+class NESSACellConfig {
+public:
+    static NESSACellConfig& Instance() {
+        static NESSACellConfig instance;
+        return instance;
+    }
+    
+    /// What the cell tally scores:
+    ///   kOff      no cell tally
+    ///   kFlux     track-length flux only
+    ///   kCapture  flux and the neutron capture rate (flux x Sigma_c)
+    ///   kDose     flux and the dose (selected coefficients, as the meshes)
+    enum Response { kOff, kFlux, kCapture, kDose };
+    Response GetResponse() const { return fResponse; }
+    void     SetResponse(Response r) { fResponse = r; }
+    G4bool   IsEnabled() const { return fResponse != kOff; }
+    
+    static const char* ResponseName(Response r) {
+        static const char* names[] = {"off", "flux", "capture", "dose"};
+        return names[r];
+    }
+    
+    /// Importances {neutron, photon} of the listed cells; cells not
+    /// listed have importance 1, importance 0 kills on entry (IMP:N=0)
+    using Importances = std::map<G4int, std::array<G4double, 2>>;
+    const Importances& GetImportances() const { return fImportances; }
+    
+    void SetImportance(G4int cell, G4double neutron, G4double photon) {
+        G4AutoLock lock(&fMutex);
+        fImportances[cell] = {neutron, photon};
+    }
+    
+    void ClearImportances() {
+        G4AutoLock lock(&fMutex);
+        fImportances.clear();
+    }
+    
+private:
+    NESSACellConfig() = default;
+    
+    Response fResponse = kOff;
+    Importances fImportances;
+    G4Mutex fMutex = G4MUTEX_INITIALIZER;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef NESSACellImportance_h
+#define NESSACellImportance_h 1
+
+#include "G4VAccumulable.hh"
+#include "G4Types.hh"
+#include "G4TrackVector.hh"
+#include "NESSACellConfig.hh"
+#include <vector>
+#include <algorithm>
+
+class G4Step;
+class G4StepPoint;
+class G4Track;
+class G4ParticleDefinition;
+
+/// Geometric splitting and Russian roulette at cell boundaries (MCNP
+/// IMP:N / IMP:P), applied from the stepping action.
+///
+/// When a neutron or photon crosses from a cell of importance I into one
+/// of importance I', r = I'/I:
+///   r > 1  the track becomes n = floor(r) or floor(r) + 1 tracks (mean
+///          r) of weight w/r; the extra ones are pushed onto the step's
+///          secondaries at the boundary
+///   r < 1  roulette: it survives with probability r, at weight w/r
+///   I' = 0 the track is killed
+/// For a particle that has mesh weight windows (NESSAWeightWindow) the
+/// windows replace the importances, as in MCNP: only I' = 0 still kills,
+/// so a track is never split or rouletted twice in one step.
+/// Importances are looked up by copy number (MCNP cell number) in a
+/// table of the placed cells, rebuilt from NESSACellConfig at the start of
+/// every run. A placement without an entry (the scoring spheres, or a cell
+/// missing from the list) takes the importance of the deepest listed cell
+/// around its origin, so a detector does not roulette the tracks entering
+/// it; the world defaults to 1.
+///
+/// Counts of splits and roulette games are kept per thread and merged as
+/// an accumulable for the end-of-run report.
+class NESSACellImportance : public G4VAccumulable
+{
+public:
+    explicit NESSACellImportance(const G4String& name = "cellImportance");
+    ~NESSACellImportance() override = default;
+    
+    /// Take the importances for the next run and clear the counts; the
+    /// particles with weight windows are taken from NESSAWeightWindowConfig
+    void SetUp(const NESSACellConfig::Importances& importances);
+    /// True if the weight windows replace the importances of particle
+    /// (0 = neutron, 1 = gamma)
+    G4bool IsWindowed(G4int particle) const { return fWindowed[particle]; }
+    G4bool IsEmpty() const { return fImportance.empty(); }
+    /// Listed cells that are not in the geometry (ignored)
+    G4int GetNUnknownCells() const { return fNUnknown; }
+    /// Geometry cells without an entry, scoring spheres excluded
+    const std::vector<G4int>& GetUnlistedCells() const { return fUnlisted; }
+    
+    /// Split or roulette a neutron or photon that has just crossed into
+    /// another cell (hot path); clones are added to secondaries
+    void ApplyAtBoundary(const G4Step* step, G4TrackVector* secondaries);
+    
+    void Merge(const G4VAccumulable& other) override;
+    void Reset() override;
+    
+    /// Split and roulette counts per source particle
+    void Print(G4double nEvents) const;
+    
+    /// Push n copies of track (its state after this step, at the post-step
+    /// point) with the given weight onto secondaries
+    static void AddClones(const G4Track* track, const G4StepPoint* post, G4double weight,
+                          G4int n, G4TrackVector* secondaries);
+    
+private:
+    enum Count { kSplits, kClones, kGames, kRouletted, kZeroKills, kNCounts };
+    
+    G4double Importance(G4int copyNo, G4int particle) const {
+        auto it = std::lower_bound(fCells.begin(), fCells.end(), copyNo);
+        if (it == fCells.end() || *it != copyNo) return 1.;
+        return fImportance[2 * (it - fCells.begin()) + particle];
+    }
+    
+    const G4ParticleDefinition* fNeutron;
+    const G4ParticleDefinition* fGamma;
+    std::vector<G4int>    fCells;       // copy numbers of the geometry, sorted
+    std::vector<G4double> fImportance;  // 2*index in fCells + particle
+    std::vector<G4int>    fUnlisted;
+    G4int fNUnknown = 0;
+    G4bool fWindowed[2] = {false, false};  // per particle
+    G4double fCounts[2][kNCounts] = {};  // per particle
+};
+
+#endif
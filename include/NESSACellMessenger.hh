@@ -0,0 +1,33 @@
+#ifndef NESSACellMessenger_h
+#define NESSACellMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIdirectory.hh"
+
+/// Macro commands for the per-cell settings (cells = MCNP cell numbers,
+/// the copy numbers of the placements):
+///   /nessa/cell/tally off|flux|capture|dose
+///   /nessa/cell/importance cell impN [impG]
+///   /nessa/cell/importanceFile file
+///   /nessa/cell/clearImportances
+///   /nessa/cell/list
+/// Changes apply from the next run.
+class NESSACellMessenger : public G4UImessenger
+{
+public:
+    NESSACellMessenger();
+    ~NESSACellMessenger() override;
+    void SetNewValue(G4UIcommand*, G4String) override;
+    
+private:
+    G4UIdirectory*      fCellDir;
+    G4UIcmdWithAString* fTallyCmd;
+    G4UIcmdWithAString* fImportanceCmd;
+    G4UIcmdWithAString* fImportanceFileCmd;
+    G4UIcmdWithoutParameter* fClearImportancesCmd;
+    G4UIcmdWithoutParameter* fListCmd;
+};
+
+#endif
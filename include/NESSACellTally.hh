@@ -0,0 +1,83 @@
+#ifndef NESSACellTally_h
+#define NESSACellTally_h 1
+
+#include "G4VAccumulable.hh"
+#include "G4Types.hh"
+#include "NESSACellConfig.hh"
+#include <vector>
+
+class G4Step;
+class G4ParticleDefinition;
+class G4Material;
+class G4VPhysicalVolume;
+
+/// Track-length flux (and optionally a reaction rate) in every geometry
+/// cell, for a full-model census against MCNP's cell-by-cell output.
+///
+/// Every placement carries its MCNP cell number as the copy number, so a
+/// step is scored at copy number -> slot -> bin: two array reads, no
+/// names or maps. The slot table is built once per run from the volume
+/// store (world = cell 0, scoring spheres 90000+). Bins per cell:
+///   4*slot + 2*response + particle   (response 0 = flux, 1 = reaction)
+/// Flux is weight x track length / cell volume [1/cm2 per source
+/// particle]; the capture rate is flux x Sigma_c [1/cm3], the dose flux x
+/// the selected coefficient. Scores are per history (sums of x and x^2),
+/// so every cell gets a relative error.
+///
+/// One instance per thread, owned by the stepping action and registered
+/// as the run's accumulable, like NESSAMeshTally.
+class NESSACellTally : public G4VAccumulable
+{
+public:
+    explicit NESSACellTally(const G4String& name = "cellTallies");
+    ~NESSACellTally() override = default;
+    
+    /// Index the cells of the current geometry and clear all sums
+    /// (no cells when the response is kOff)
+    void SetUp(NESSACellConfig::Response response);
+    G4bool IsEmpty() const { return fCells.empty(); }
+    G4int GetNCells() const { return (G4int)fCells.size(); }
+    
+    /// Score one step of a neutron or photon (hot path)
+    void ScoreStep(const G4Step* step);
+    
+    /// Fold the current history into the sums (call once per event)
+    void EndOfHistory();
+    
+    void Merge(const G4VAccumulable& other) override;
+    void Reset() override;
+    
+    /// Write the cell table to <output base>_cells.dat
+    void Write(const G4String& outputFile, G4double nEvents) const;
+    
+private:
+    struct Cell {
+        G4int copyNo;
+        const G4VPhysicalVolume* volume;
+    };
+    
+    /// Macroscopic capture cross section [1/cm], cached for a track that
+    /// crosses cells without a collision (same energy)
+    G4double CaptureXS(const G4Material* material, G4double energy);
+    
+    /// Volume of a cell [cm3]: its solid minus its daughters
+    static G4double CellVolume(const G4VPhysicalVolume* pv);
+    
+    void Add(G4int bin, G4double x) {
+        if (fHistory[bin] == 0.) fTouched.push_back(bin);
+        fHistory[bin] += x;
+    }
+    
+    const G4ParticleDefinition* fNeutron;
+    const G4ParticleDefinition* fGamma;
+    NESSACellConfig::Response fResponse = NESSACellConfig::kOff;
+    std::vector<Cell>     fCells;     // by slot
+    std::vector<G4int>    fSlot;      // by copy number, -1 = not a cell
+    std::vector<G4double> fSum, fSum2;  // sums over histories, by bin
+    std::vector<G4double> fHistory;     // current history, by bin
+    std::vector<G4int>    fTouched;     // bins scored in the current history
+    const G4Material*     fXSMaterial = nullptr;  // CaptureXS cache
+    G4double              fXSEnergy = -1., fXS = 0.;
+};
+
+#endif
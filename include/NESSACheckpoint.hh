@@ -0,0 +1,40 @@
+#ifndef NESSACheckpoint_h
+#define NESSACheckpoint_h 1
+
+#include "NESSARunSummary.hh"
+#include "G4String.hh"
+
+/// Checkpoint files for long runs.
+///   <file>       keyword text: event counts, the run ID keying the
+///                per-event seeds, the precision target of an
+///                untilPrecision run, the run summary (tally moments,
+///                activation tables) and every non-empty H1 and H2 bin
+///   <file>.rndm  full random engine state (HepRandomEngine::saveStatus)
+/// All doubles are written with max_digits10, so a restored run continues
+/// from exactly the same partial sums. Both files are written to *.tmp
+/// first and renamed, so a preemption mid-write keeps the previous one.
+class NESSACheckpoint
+{
+public:
+    /// Target of /nessa/run/untilPrecision; relErr = 0 = none
+    struct Precision {
+        G4String detector;
+        G4double relErr = 0.;
+        G4double maxTime = 0.;  // [s], 0 = no limit
+    };
+    
+    /// Save state after `state.nEvents` of `eventsTotal` events of run runID
+    static G4bool Write(const G4String& file, G4int eventsTotal, G4int runID,
+                        const Precision& precision, const NESSARunSummary& state);
+    
+    /// Read event counts, run ID (-1 in older files), precision target and
+    /// run summary (no side effects)
+    static G4bool Read(const G4String& file, G4int& eventsTotal, G4int& runID,
+                       Precision& precision, NESSARunSummary& state);
+    
+    /// Load H1 and H2 bin contents into the analysis manager and restore the
+    /// random engine. Call after the histograms are booked and reset.
+    static G4bool RestoreHistogramsAndEngine(const G4String& file);
+};
+
+#endif
@@ -25,6 +25,7 @@ public:
 private:
     void DefineMaterials();
     void ConstructBunkerGeometry(G4LogicalVolume* worldLV);
+    void ConstructScoringVolumes();
     void ApplyVisAttributes();
     void ApplyGeometryLabels();
     
@@ -11,7 +11,12 @@
 ///   /nessa/detector/remove name
 ///   /nessa/detector/enable name
 ///   /nessa/detector/disable name
+///   /nessa/detector/nextEvent name|all [true|false]
+///   /nessa/detector/binning name|all n|g spec (NESSAEnergyBinning)
+///   /nessa/detector/timeBins name|all nTime tMin tMax [nEnergy]
+///   /nessa/detector/timeCutoff [true|false]
 ///   /nessa/detector/list
+/// Changes after initialization rebuild the geometry before the next run.
 class NESSADetectorMessenger : public G4UImessenger
 {
 public:
@@ -26,6 +31,10 @@ private:
     G4UIcmdWithAString*     fRemoveCmd;
     G4UIcmdWithAString*     fEnableCmd;
     G4UIcmdWithAString*     fDisableCmd;
+    G4UIcmdWithAString*     fNextEventCmd;
+    G4UIcmdWithAString*     fBinningCmd;
+    G4UIcmdWithAString*     fTimeBinsCmd;
+    G4UIcmdWithAString*     fTimeCutoffCmd;
     G4UIcmdWithoutParameter* fListCmd;
 };
 
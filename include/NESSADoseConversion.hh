@@ -0,0 +1,58 @@
+#ifndef NESSADoseConversion_h
+#define NESSADoseConversion_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include <map>
+#include <utility>
+#include <vector>
+
+/// Fluence-to-dose conversion coefficients [pSv cm2], applied at scoring
+/// time: dose per source particle = fluence [1/cm2] * h(E).
+///
+/// Tables are read from data/dose_coefficients.dat (TABLE <quantity>
+/// <n|g> blocks) and resampled once onto a fine uniform log(E) grid, so a
+/// lookup is one log, one index computation and a linear interpolation.
+/// Outside the tabulated range the end value is used.
+///
+/// Shared by all threads: loaded on first use, the quantity is selected
+/// only from the master between runs, workers only read.
+class NESSADoseConversion {
+public:
+    static NESSADoseConversion& Instance();
+    
+    /// Select the quantity for the next runs (name as in the data file);
+    /// false, and no change, if it is not defined
+    G4bool Select(const G4String& quantity);
+    const G4String& GetQuantity() const { return fQuantity; }
+    
+    /// Quantities defined in the data file
+    std::vector<G4String> GetQuantities() const;
+    
+    /// Coefficient of the selected quantity [pSv cm2] for particle
+    /// (0 = neutron, 1 = gamma) at energy [MeV]; 0 without a table
+    G4double Coefficient(G4int particle, G4double energyMeV) const {
+        const Table* t = fActive[particle];
+        return t ? t->Lookup(energyMeV) : 0.;
+    }
+    
+private:
+    NESSADoseConversion();
+    void Load(const G4String& filename);
+    
+    struct Table {
+        G4double logEmin = 0.;
+        G4double invStep = 0.;            // grid points per unit log(E)
+        std::vector<G4double> values;     // h on the log grid
+    
+        /// Resample (energy, h) pairs, log-log interpolated
+        void Build(const std::vector<std::pair<G4double, G4double>>& points);
+        G4double Lookup(G4double energyMeV) const;
+    };
+    
+    std::map<std::pair<G4String, G4int>, Table> fTables;  // (quantity, particle)
+    const Table* fActive[2] = {nullptr, nullptr};
+    G4String fQuantity;
+};
+
+#endif
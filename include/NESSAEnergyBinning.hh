@@ -0,0 +1,133 @@
+#ifndef NESSAEnergyBinning_h
+#define NESSAEnergyBinning_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include "tools/histo/h1d"
+#include "tools/histo/h2d"
+#include <cmath>
+#include <vector>
+
+/// Energy group structure of a spectrum and its constant-time bin lookup.
+///
+/// A binning is given as a spec string (energies in MeV):
+///   lin n Emin Emax     n equal-width bins
+///   log n Emin Emax     n equal-lethargy bins
+///   sand2               SAND-II 620 groups, 1e-10 to 18 MeV: 45 per
+///                       decade up to 1 MeV, then 0.1 MeV wide
+///   sand2-640           the same extended to 20 MeV (640 groups)
+///   file path           edges from a text file, one per line (any
+///                       order; '#' comments), e.g. VITAMIN-J 175
+///
+/// Histograms are booked with the edges; the scoring SD then looks bins
+/// up here rather than through h1d::fill, whose search over variable
+/// edges is linear in the number of bins. Equal-width and equal-lethargy
+/// edges are a formula; other structures use a table over log(E) with
+/// cells no wider than the narrowest group, so at most a step or two
+/// past the table entry is needed. Time bins [s] use the same lookup.
+class NESSAEnergyBinning
+{
+public:
+    static const char* const kDefaultNeutron;  // log 300 1e-11 20
+    static const char* const kDefaultPhoton;   // lin 200 0 10
+    
+    /// Edges [MeV] of a spec, increasing; false with a message if invalid
+    static G4bool MakeEdges(const G4String& spec, std::vector<G4double>& edges,
+                            G4String& error);
+    /// Whether a (valid) spec has equal-width bins (booked as fixed binning)
+    static G4bool IsLinear(const G4String& spec);
+    
+    /// Set up the lookup for a histogram's x axis
+    void SetUp(const tools::histo::h1d& h);
+    void SetUp(const std::vector<G4double>& edges);
+    
+    G4int NBins() const { return fNBins; }
+    
+    /// Bin of energy e [MeV]: -1 below the first edge, NBins() at or above
+    /// the last (as the h1d under/overflow)
+    G4int Bin(G4double e) const {
+        if (!(e >= fLo)) return -1;
+        if (e >= fHi) return fNBins;
+        G4int g;
+        if (fScheme == kLinear) {
+            g = (G4int)((e - fLo) * fInvStep);
+        } else {
+            G4int c = (G4int)(std::log(e / fLo) * fInvStep);
+            g = (fScheme == kLog) ? c : fFirstBin[c < fNCells ? c : fNCells - 1];
+        }
+        // Rounding near an edge, and the table walk
+        if (g >= fNBins) g = fNBins - 1;
+        while (g > 0 && e < fEdges[g]) g--;
+        while (e >= fEdges[g + 1]) g++;
+        return g;
+    }
+    
+private:
+    enum Scheme { kLinear, kLog, kTable };
+    
+    Scheme fScheme = kLinear;
+    G4int fNBins = 0;
+    G4double fLo = 0., fHi = 0.;
+    G4double fInvStep = 0.;         // 1/bin width, in E or in log(E)
+    std::vector<G4double> fEdges;
+    std::vector<G4int> fFirstBin;   // kTable: bin of each cell's lower end
+    G4int fNCells = 0;
+};
+
+/// An h1d filled by bin index (from NESSAEnergyBinning) instead of by
+/// value. Fills collect the same per-bin sums as h1d::fill and are added
+/// to the histogram by Flush().
+class NESSABinnedH1
+{
+public:
+    void Attach(tools::histo::h1d* h);
+    
+    /// bin as from NESSAEnergyBinning::Bin; x is the filled value
+    void Fill(G4int bin, G4double x, G4double w) {
+        Sums& s = fSums[bin + 1];
+        s.entries++;
+        s.sw += w; s.sw2 += w * w;
+        s.sxw += x * w; s.sx2w += x * x * w;
+    }
+    
+    /// Add the collected sums to the histogram and clear them
+    void Flush();
+    
+private:
+    struct Sums {
+        unsigned int entries = 0;
+        G4double sw = 0., sw2 = 0., sxw = 0., sx2w = 0.;
+    };
+    
+    tools::histo::h1d* fH1 = nullptr;
+    std::vector<Sums> fSums;  // offset 0 = underflow, nbins+1 = overflow
+};
+
+/// The same for an h2d (energy x time arrays)
+class NESSABinnedH2
+{
+public:
+    void Attach(tools::histo::h2d* h);
+    
+    void Fill(G4int binX, G4int binY, G4double x, G4double y, G4double w) {
+        Sums& s = fSums[(binY + 1) * fStride + binX + 1];
+        s.entries++;
+        s.sw += w; s.sw2 += w * w;
+        s.sxw += x * w; s.sx2w += x * x * w;
+        s.syw += y * w; s.sy2w += y * y * w;
+    }
+    
+    void Flush();
+    
+private:
+    struct Sums {
+        unsigned int entries = 0;
+        G4double sw = 0., sw2 = 0., sxw = 0., sx2w = 0., syw = 0., sy2w = 0.;
+    };
+    
+    tools::histo::h2d* fH2 = nullptr;
+    unsigned int fStride = 0;  // x offsets per row, nbinsX+2
+    std::vector<Sums> fSums;
+};
+
+#endif
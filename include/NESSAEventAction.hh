@@ -0,0 +1,26 @@
+#ifndef NESSAEventAction_h
+#define NESSAEventAction_h 1
+
+#include "G4UserEventAction.hh"
+
+class NESSARunAction;
+class NESSASteppingAction;
+
+/// Event boundaries: sets the tally fluctuation-chart segment of each
+/// event, folds the per-history tallies at its end and lets the run
+/// action write periodic checkpoints.
+class NESSAEventAction : public G4UserEventAction
+{
+public:
+    NESSAEventAction(NESSARunAction* run, NESSASteppingAction* stepping);
+    ~NESSAEventAction() override = default;
+    
+    void BeginOfEventAction(const G4Event*) override;
+    void EndOfEventAction(const G4Event*) override;
+    
+private:
+    NESSARunAction* fRunAction;
+    NESSASteppingAction* fSteppingAction;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef NESSAMeshConfig_h
+#define NESSAMeshConfig_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include "G4AutoLock.hh"
+#include <vector>
+
+/// One Cartesian track-length mesh tally (global coordinates, cm)
+struct MeshSpec {
+    G4String name;
+    G4int    particle;          // 0 = neutron, 1 = gamma
+    G4double lo[3], hi[3];      // box corners [cm]
+    G4int    n[3];              // voxels along x, y, z
+    G4int    nEnergy = 1;       // log-spaced energy bins over [eMin, eMax]
+    G4double eMin = 1e-9;       // [MeV]; the end bins take under/overflow
+    G4double eMax = 20.;
+    G4bool   dose = false;      // score dose (selected coefficients), not fluence
+    
+    G4long NBins() const { return (G4long)n[0] * n[1] * n[2] * nEnergy; }
+};
+
+/// Mesh tallies for the next runs; a shared singleton like
+/// NESSAScoringConfig, changed from macros on the master between runs and
+/// read by every thread at the start of a run.
+class NESSAMeshConfig {
+public:
+    static NESSAMeshConfig& Instance() {
+        static NESSAMeshConfig instance;
+        return instance;
+    }
+    
+    const std::vector<MeshSpec>& GetMeshes() const { return fMeshes; }
+    
+    /// Add a mesh, replacing one of the same name
+    void AddMesh(const MeshSpec& spec) {
+        G4AutoLock lock(&fMutex);
+        for (auto& m : fMeshes) {
+            if (m.name == spec.name) { m = spec; return; }
+        }
+        fMeshes.push_back(spec);
+    }
+    
+    void RemoveMesh(const G4String& name) {
+        G4AutoLock lock(&fMutex);
+        for (auto it = fMeshes.begin(); it != fMeshes.end(); ++it) {
+            if (it->name == name) { fMeshes.erase(it); return; }
+        }
+    }
+    
+    /// Mesh by name, nullptr if not defined
+    MeshSpec* Find(const G4String& name) {
+        for (auto& m : fMeshes) if (m.name == name) return &m;
+        return nullptr;
+    }
+    
+private:
+    NESSAMeshConfig() = default;
+    
+    std::vector<MeshSpec> fMeshes;
+    G4Mutex fMutex = G4MUTEX_INITIALIZER;
+};
+
+#endif
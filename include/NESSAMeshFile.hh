@@ -0,0 +1,48 @@
+#ifndef NESSAMeshFile_h
+#define NESSAMeshFile_h 1
+
+#include <cstdint>
+
+/// Binary mesh tally file (<output>_mesh_<name>.bin), written by
+/// NESSAMeshTally. Laid out for memory mapping; all fields are
+/// little-endian and every section starts 8-byte aligned:
+///
+///   MeshFileHeader
+///   double  energyEdges[nEnergy + 1]            [MeV]
+///   int64_t tileIndex[nTiles]                   byte offset of a tile, -1 = empty
+///   tiles:  double s1[tileBins], s2[tileBins]   sums over histories of x, x^2
+///
+/// The grid is cut into tiles of 2^tileShift[k] voxels along each axis
+/// (tiles at the upper edges may extend past the grid). Tile (tx, ty, tz)
+/// has index tx + ntx*(ty + nty*tz), ntk = ceil(n[k] / 2^tileShift[k]).
+/// Inside a tile, bin = (lx + (ly << sx) + (lz << (sx+sy))) * nEnergy + ie
+/// with lk the voxel coordinate within the tile. Only tiles that were
+/// scored are stored, so a slice costs only the tiles it touches.
+///
+/// Mean per source particle = s1 / nEvents; relative error from s1, s2
+/// and nEvents as for the other tallies (NESSATallyStats::MeanAndError).
+/// Files of independent runs add: sums and nEvents.
+struct MeshFileHeader {
+    char    magic[8];       // "NESSAMSH"
+    int32_t version;        // kMeshFileVersion
+    int32_t particle;       // 0 = neutron, 1 = gamma
+    int32_t dose;           // 1 = dose [pSv], 0 = fluence [1/cm2]
+    int32_t nEnergy;
+    int32_t n[3];           // voxels along x, y, z
+    int32_t tileShift[3];
+    double  lo[3], hi[3];   // [cm]
+    double  nEvents;
+    int64_t nTiles;
+    int64_t nStored;        // tiles with data
+
+    int64_t NTiles(int k) const { return (n[k] + (1 << tileShift[k]) - 1) >> tileShift[k]; }
+    int64_t TileBins() const {
+        return ((int64_t)nEnergy << (tileShift[0] + tileShift[1] + tileShift[2]));
+    }
+};
+
+static_assert(sizeof(MeshFileHeader) == 120, "MeshFileHeader layout");
+
+const int32_t kMeshFileVersion = 1;
+
+#endif
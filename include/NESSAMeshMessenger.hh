@@ -0,0 +1,32 @@
+#ifndef NESSAMeshMessenger_h
+#define NESSAMeshMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIdirectory.hh"
+
+/// Macro commands for the track-length mesh tallies (NESSAMeshTally):
+///   /nessa/mesh/add name n|g x0 y0 z0 x1 y1 z1 nx ny nz
+///   /nessa/mesh/energyBins name nE [Emin Emax]
+///   /nessa/mesh/dose name [true|false]
+///   /nessa/mesh/remove name
+///   /nessa/mesh/list
+/// Changes apply from the next run; no geometry rebuild is needed.
+class NESSAMeshMessenger : public G4UImessenger
+{
+public:
+    NESSAMeshMessenger();
+    ~NESSAMeshMessenger() override;
+    void SetNewValue(G4UIcommand*, G4String) override;
+    
+private:
+    G4UIdirectory*           fMeshDir;
+    G4UIcmdWithAString*      fAddCmd;
+    G4UIcmdWithAString*      fEnergyBinsCmd;
+    G4UIcmdWithAString*      fDoseCmd;
+    G4UIcmdWithAString*      fRemoveCmd;
+    G4UIcmdWithoutParameter* fListCmd;
+};
+
+#endif
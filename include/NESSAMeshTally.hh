@@ -0,0 +1,110 @@
+#ifndef NESSAMeshTally_h
+#define NESSAMeshTally_h 1
+
+#include "G4VAccumulable.hh"
+#include "G4ThreeVector.hh"
+#include "G4Types.hh"
+#include "NESSAMeshConfig.hh"
+#include <vector>
+
+class G4Step;
+class G4ParticleDefinition;
+
+/// Track-length fluence (or dose) on Cartesian meshes, scored from the
+/// stepping action. Each neutral step is a straight segment, walked
+/// through the voxels it crosses with a 3D-DDA (Amanatides-Woo)
+/// traversal: one division per axis to set up, then a few integer
+/// operations per voxel crossed, no navigation or volume lookups.
+///
+/// Storage is sparse: the grid is cut into tiles of up to 8x8x8 voxels
+/// (all energy bins of a voxel contiguous), allocated on the first score.
+/// Tiles inside walls and soil that no track reaches cost one index entry.
+///
+/// Scores are per history (sums of x and x^2 over histories), so every
+/// voxel gets a relative error. One instance per thread, owned by the
+/// stepping action and registered as the run's accumulable; merged at
+/// end of run.
+class NESSAMeshTally : public G4VAccumulable
+{
+public:
+    explicit NESSAMeshTally(const G4String& name = "meshTallies");
+    ~NESSAMeshTally() override = default;
+    
+    /// Take the mesh layout for the next run and clear all sums
+    void SetUp(const std::vector<MeshSpec>& specs);
+    G4bool IsEmpty() const { return fMeshes.empty(); }
+    /// Bins of all meshes, allocated or not
+    G4long GetNBins() const;
+    /// Bytes of the allocated tiles (this thread)
+    G4double GetAllocatedBytes() const { return 3. * sizeof(G4double) * fSum.size(); }
+    
+    /// Score one step of a neutron or photon (hot path)
+    void ScoreStep(const G4Step* step);
+    
+    /// Fold the current history into the sums (call once per event)
+    void EndOfHistory();
+    
+    void Merge(const G4VAccumulable& other) override;
+    void Reset() override;
+    
+    /// Write every mesh to <output base>_mesh_<name>.bin (NESSAMeshFile.hh)
+    void Write(const G4String& outputFile, G4double nEvents) const;
+    
+private:
+    struct Mesh {
+        MeshSpec spec;
+        G4double lo[3];        // [mm]
+        G4double width[3];     // voxel size [mm]
+        G4double invWidth[3];
+        G4double invVolume;    // 1/cm3
+        G4double logEmin, invLogStep;  // energy bins per unit log(E/MeV)
+        G4int    tileShift[3]; // tile edge 2^shift voxels
+        G4int    tileMask[3];
+        G4long   nTiles[3];
+        G4long   tileBins;     // bins per tile
+        G4long   firstTile;    // in fTileStart
+    
+        G4int EnergyBin(G4double energyMeV) const;
+        G4long Tile(const G4int i[3]) const {
+            return firstTile + (i[0] >> tileShift[0])
+                 + nTiles[0] * ((i[1] >> tileShift[1]) + nTiles[1] * (i[2] >> tileShift[2]));
+        }
+        G4long LocalBin(const G4int i[3], G4int ie) const {
+            return ((G4long)(i[0] & tileMask[0]) + ((i[1] & tileMask[1]) << tileShift[0])
+                    + ((i[2] & tileMask[2]) << (tileShift[0] + tileShift[1])))
+                   * spec.nEnergy + ie;
+        }
+    };
+    
+    /// Walk the segment a -> a + d through the mesh, scoring
+    /// scorePerT * (fraction of the segment) in every voxel
+    void Traverse(const Mesh& m, const G4ThreeVector& a, const G4ThreeVector& d,
+                  G4int energyBin, G4double scorePerT);
+    
+    /// First bin of a tile in the pools, allocating it if needed
+    G4long TileStart(G4long tile, G4long tileBins) {
+        G4long start = fTileStart[tile];
+        if (start < 0) {
+            start = fTileStart[tile] = (G4long)fSum.size();
+            fSum.resize(start + tileBins, 0.);
+            fSum2.resize(start + tileBins, 0.);
+            fHistory.resize(start + tileBins, 0.);
+        }
+        return start;
+    }
+    
+    void Add(G4long bin, G4double x) {
+        if (fHistory[bin] == 0.) fTouched.push_back(bin);
+        fHistory[bin] += x;
+    }
+    
+    const G4ParticleDefinition* fNeutron;
+    const G4ParticleDefinition* fGamma;
+    std::vector<Mesh>     fMeshes;
+    std::vector<G4long>   fTileStart;   // per tile of all meshes, -1 = not allocated
+    std::vector<G4double> fSum, fSum2;  // tile pools: sums over histories
+    std::vector<G4double> fHistory;     // tile pool: current history
+    std::vector<G4long>   fTouched;     // pool bins scored in the current history
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef NESSANextEventEstimator_h
+#define NESSANextEventEstimator_h 1
+
+#include "G4ThreeVector.hh"
+#include "NESSATallyStats.hh"
+#include "NESSASplitMix.hh"
+#include <map>
+#include <utility>
+#include <vector>
+
+class G4Step;
+class G4Navigator;
+class G4Material;
+class G4ParticleDefinition;
+class NESSAPrimaryGeneratorAction;
+
+/// MCNP F5-style next-event (point detector) estimator.
+/// At every source emission and every neutron/photon collision, each
+/// detector with nextEvent enabled scores the expected flux at its centre
+/// from a particle emitted straight towards it:
+///     w * p(Omega) * exp(-tau(E')) / R^2
+/// p(Omega) is the emission density per steradian towards the point, E'
+/// the energy of that emission and tau the optical depth along the line
+/// of sight, ray-traced through the geometry with a private navigator.
+/// Within the exclusion radius R0 (the detector radius) 1/R^2 is replaced
+/// by its average over the sphere, 3/R0^2.
+///
+/// Emission models: the source from the FDIR direction density and the
+/// spectrum of the matching bin; neutron elastic scattering isotropic in
+/// the centre of mass of the struck nucleus; Compton scattering from
+/// Klein-Nishina; every neutron and photon emitted by other neutron
+/// reactions isotropic in the lab. Photoelectric absorption, pair
+/// production and Rayleigh scattering do not contribute.
+///
+/// No numbers are drawn from the engine, so histories are identical with
+/// the estimator on or off. One instance per thread (Instance()); results
+/// are flux per source particle [1/cm2] in bin 2*detector + (0=n, 1=gamma)
+/// and the dose it gives [pSv] (NESSADoseConversion, at the energy of each
+/// contribution) in bin 2*(nActive + detector) + (0=n, 1=gamma).
+class NESSANextEventEstimator
+{
+public:
+    static NESSANextEventEstimator& Instance();
+    
+    /// Pick up the detectors and the world volume for this run
+    void BeginOfRun();
+    G4bool IsEnabled() const { return !fPoints.empty(); }
+    
+    /// eventKey: NESSARunAction::EventKey of the event, which keys the
+    /// side stream of the source energies
+    void ScoreSource(const G4ThreeVector& pos, G4double weight, uint64_t eventKey,
+                     const NESSAPrimaryGeneratorAction& source);
+    void ScoreCollision(const G4Step* step);
+    void EndOfHistory() { fTallies.EndOfHistory(); }
+    
+    NESSATallyStats& GetTallies() { return fTallies; }
+
+private:
+    NESSANextEventEstimator();
+    
+    struct Point {
+        G4int         index;  // active detector index
+        G4ThreeVector pos;
+        G4double      r0;     // exclusion radius
+    };
+    
+    /// Score emission at x towards every point; density(dir, energy&)
+    /// returns the density per steradian along dir and sets the energy
+    template <class Density>
+    void Contribute(const G4ThreeVector& x, G4int particle, G4double weight,
+                    Density&& density);
+    void Isotropic(const G4ThreeVector& x, G4int particle, G4double weight,
+                   G4double energy);
+    
+    G4double OpticalDepth(const G4ThreeVector& from, const G4ThreeVector& dir,
+                          G4double distance, G4int particle, G4double energy);
+    G4double MacroscopicXS(const G4Material* mat, G4int particle, G4double energy);
+    G4double PhotonXS(const G4Material* mat, G4double energy);
+    
+    /// Lab-frame density per steradian for elastic scattering, isotropic in
+    /// the CM, off a nucleus of mass ratio A; sets the outgoing energy
+    static G4double ElasticDensity(G4double A, G4double muLab, G4double e0,
+                                   G4double& e1);
+    /// Klein-Nishina density per steradian; sets the scattered energy
+    static G4double ComptonDensity(G4double muLab, G4double e0, G4double& e1);
+    
+    const G4ParticleDefinition* fNeutron;
+    const G4ParticleDefinition* fGamma;
+    G4Navigator* fNavigator;
+    std::vector<Point> fPoints;
+    NESSATallyStats fTallies;
+    G4int fDoseOffset = 0;  // first dose bin
+    NESSASplitMix fRandom;  // source energies
+    
+    // Per ray: macroscopic cross section of each material met so far
+    std::vector<std::pair<const G4Material*, G4double>> fXSCache;
+    // Photon total cross section on a log energy grid, per material
+    std::map<const G4Material*, std::vector<G4double>> fPhotonTables;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef NESSAPrecisionMonitor_h
+#define NESSAPrecisionMonitor_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include "G4AutoLock.hh"
+#include "NESSATallyStats.hh"
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+class NESSARunSummary;
+
+/// Precision-targeted run termination (/nessa/run/untilPrecision).
+/// While armed, every thread publishes the growth of its watched tally
+/// moments into shared sums about once per second; whichever thread
+/// publishes evaluates the combined relative errors and raises the stop
+/// flag once every watched tally of the target detectors has scored and
+/// reached the target (or the time budget is spent). Each thread then
+/// soft-aborts its event loop, so the run ends within one event per thread.
+///
+/// Watched tallies: the detector's neutron and photon track-length
+/// estimates, and its next-event estimates if it uses them.
+class NESSAPrecisionMonitor {
+public:
+    static NESSAPrecisionMonitor& Instance();
+    
+    /// Arm for the next run (master, Idle state). detector = name or
+    /// "all" (every active detector); maxTime [s], 0 = no limit.
+    void Arm(const G4String& detector, G4double relErr, G4double maxTime);
+    G4bool IsArmed() const { return fArmed; }
+    const G4String& GetDetector() const { return fDetector; }
+    G4double GetRelErr() const { return fRelErr; }
+    G4double GetMaxTime() const { return fMaxTime; }
+    
+    /// Start of run on every thread; the master (first) resolves the
+    /// watched bins and clears the shared sums
+    void BeginOfRun(G4bool isMaster, const NESSATallyStats* scoring,
+                    const NESSATallyStats* nextEvent);
+    
+    /// Serial resume, after the tallies are restored: count the restored
+    /// histories and time, as the first publish adds the restored sums
+    void Resume(G4double histories, G4double seconds);
+    
+    /// After each event of this thread; true = stop the run
+    G4bool EndOfEvent();
+    
+    /// Master, end of run: achieved precision per watched tally, then disarm
+    void Report(const NESSARunSummary& summary);
+    void Disarm() { fArmed = false; }
+    
+private:
+    NESSAPrecisionMonitor() = default;
+    
+    struct Watch {
+        G4String name;      // detector
+        G4int    particle;  // summary code: 0/1 track length, 2/3 next-event
+        G4int    bin;       // in the scoring (0/1) or next-event (2/3) tallies
+    };
+    
+    /// Shared sums -> stop flag (under fMutex)
+    void Evaluate();
+    G4double Elapsed() const;
+    
+    G4bool   fArmed = false;
+    G4String fDetector;
+    G4double fRelErr = 0.;
+    G4double fMaxTime = 0.;
+    
+    std::vector<Watch>        fWatches;
+    std::vector<TallyMoments> fSums;       // published, all threads
+    G4double                  fHistories = 0.;
+    std::atomic<G4bool>       fStop{false};
+    G4String                  fStopReason;
+    std::chrono::steady_clock::time_point fStart;
+    G4Mutex fMutex = G4MUTEX_INITIALIZER;
+};
+
+#endif
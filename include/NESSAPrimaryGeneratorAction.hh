@@ -4,6 +4,7 @@
 #include "G4VUserPrimaryGeneratorAction.hh"
 #include "G4ParticleGun.hh"
 #include "G4ThreeVector.hh"
+#include <cstdint>
 #include <vector>
 
 class G4Event;
@@ -16,6 +17,13 @@ class G4Event;
 /// - Extension along axis: 0 to 0.00001 cm (essentially a point)
 /// - Angular-energy correlation from Adelphi DT kinematics
 ///   (200 direction cosine bins × 501 energy bins each)
+/// With /nessa/run/eventSeed set, the engine is reseeded at the start of
+/// every event from (seed, run ID, event ID), before any random number of
+/// the event is drawn.
+/// Direction biasing (NESSASourceConfig): the direction bin is drawn from
+/// biased probabilities and the azimuth optionally from a cone toward a
+/// target point; the primary carries the weight analog/biased density.
+/// The energy is still drawn from the chosen bin's own spectrum.
 class NESSAPrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
 {
 public:
@@ -23,11 +31,34 @@ public:
     ~NESSAPrimaryGeneratorAction() override;
 
     void GeneratePrimaries(G4Event*) override;
+    
+    /// Emission probability per steradian along dir (FDIR bin probability
+    /// spread uniformly over the bin's solid angle); sets the bin index
+    G4double EmissionDensity(const G4ThreeVector& dir, G4int& dirBin) const;
+    
+    /// Energy of direction bin dirBin from two uniforms in [0, 1)
+    G4double EnergyFromUniforms(G4int dirBin, G4double r1, G4double r2) const;
+    
+    /// Source description, for the adjoint solver
+    const G4ThreeVector& GetSourcePosition() const { return fSourcePos; }
+    G4int GetNDirectionBins() const { return fNDirBins; }
+    /// Analog probability of direction bin dirBin
+    G4double DirectionBinProbability(G4int dirBin) const;
+    /// Cosine range of a direction bin (bin 0 is the single cosine fDirBins[0])
+    void DirectionBinRange(G4int dirBin, G4double& muLo, G4double& muHi) const;
+    /// Share of the energy spectrum of direction bin dirBin in [eLo, eHi] [MeV]
+    G4double EnergyFraction(G4int dirBin, G4double eLo, G4double eHi) const;
 
 private:
     void LoadSourceData(const G4String& filename);
+    uint64_t EventKey(const G4Event* event) const;
+    void SeedEvent(uint64_t key);
     G4double SampleEnergy(G4int dirBin);
-    G4int SampleDirectionBin();
+    /// Direction bin and azimuth, multiplying weight by their bias weights
+    G4int SampleDirectionBin(G4double& weight);
+    G4double SampleAzimuth(G4double& weight);
+    /// Rebuild the biased tables if NESSASourceConfig changed
+    void UpdateBias();
     
     G4ParticleGun* fParticleGun = nullptr;
     
@@ -43,6 +74,14 @@ private:
     std::vector<G4double> fDirCDF;        // cumulative distribution for direction
     std::vector<G4double> fEnergyBins;    // energy bin edges (MeV)
     std::vector<std::vector<G4double>> fEnergyCDFs;  // CDF for each direction bin
+    
+    // Direction biasing, built from NESSASourceConfig
+    G4int fBiasVersion = 0;
+    std::vector<G4double> fBiasCDF;       // empty = analog bins
+    std::vector<G4double> fBiasWeight;    // analog / biased probability per bin
+    G4double fConePhi = 0.;               // target azimuth
+    G4double fConeHalfWidth = 0.;         // 0 = uniform azimuth
+    G4double fConeFraction = 0.;
 };
 
 #endif
@@ -0,0 +1,59 @@
+#ifndef NESSAProfiler_h
+#define NESSAProfiler_h 1
+
+#include "G4Types.hh"
+
+/// Optional timing of the per-step user hot paths, enabled at build time
+/// with -DNESSA_PROFILE_USER_ACTIONS=ON. Counters are thread-local and
+/// printed by each thread at end of run; the cost of the timer itself is
+/// measured and subtracted. Compiles to nothing when disabled.
+#ifdef NESSA_PROFILE_USER_ACTIONS
+
+#include <chrono>
+
+class NESSAProfiler
+{
+public:
+    enum Slot { kSteppingAction, kProcessHits, kScoringFlush, kNextEvent, kMeshTally, kSurfaceTally, kCellTally, kWeightWindow, kWindowGenerator, kNSlots };
+    
+    static void Add(Slot slot, G4double ns) {
+        fCalls[slot]++;
+        fNanoseconds[slot] += ns;
+    }
+    static void Reset();
+    static void Print();
+    
+private:
+    static G4ThreadLocal G4long   fCalls[kNSlots];
+    static G4ThreadLocal G4double fNanoseconds[kNSlots];
+};
+
+class NESSAScopedTimer
+{
+public:
+    explicit NESSAScopedTimer(NESSAProfiler::Slot slot)
+        : fSlot(slot), fStart(std::chrono::steady_clock::now()) {}
+    ~NESSAScopedTimer() {
+        std::chrono::duration<G4double, std::nano> dt =
+            std::chrono::steady_clock::now() - fStart;
+        NESSAProfiler::Add(fSlot, dt.count());
+    }
+    
+private:
+    NESSAProfiler::Slot fSlot;
+    std::chrono::steady_clock::time_point fStart;
+};
+
+#define NESSA_PROFILE(slot) NESSAScopedTimer nessaScopedTimer_(NESSAProfiler::slot)
+#define NESSA_PROFILE_RESET() NESSAProfiler::Reset()
+#define NESSA_PROFILE_PRINT() NESSAProfiler::Print()
+
+#else
+
+#define NESSA_PROFILE(slot)
+#define NESSA_PROFILE_RESET()
+#define NESSA_PROFILE_PRINT()
+
+#endif
+
+#endif
@@ -3,6 +3,16 @@
 
 #include "G4UserRunAction.hh"
 #include "G4Timer.hh"
+#include "NESSAActivationAccumulable.hh"
+#include "NESSATallyStats.hh"
+#include "NESSAMeshTally.hh"
+#include "NESSACellTally.hh"
+#include "NESSACellImportance.hh"
+#include "NESSAWeightWindow.hh"
+#include "NESSAWeightWindowGenerator.hh"
+#include <chrono>
+#include <cstdint>
+#include <map>
 
 class NESSASteppingAction;
 
@@ -14,12 +24,68 @@ public:
 
     void BeginOfRunAction(const G4Run*) override;
     void EndOfRunAction(const G4Run*) override;
+    
+    /// Write a checkpoint if the configured event/time interval has passed
+    /// (serial runs; called by NESSAEventAction after each event)
+    void CheckpointIfDue(G4int eventID);
+    
+    /// Number of an event within the run, resumed parts included
+    /// (orders the tally fluctuation charts)
+    G4long HistoryIndex(G4int eventID) const;
+    
+    /// Key of the per-event random streams: a function of (eventSeed,
+    /// run ID, eventOffset + history index), where a resumed run keeps
+    /// the run ID and history numbering of the interrupted one
+    uint64_t EventKey(G4int eventID) const;
+    
+    /// Ranked activation tables, saturation activities at sourceRate
+    /// [n/s]; also used by nessa_merge on merged data
+    static void PrintActivationReport(
+        const NESSAActivationAccumulable::IsotopeMap& globalProd,
+        const NESSAActivationAccumulable::VolumeIsotopeMap& volumeProd,
+        G4double nEvents, G4double sourceRate);
 
 private:
-    void PrintActivationReport(G4int nEvents);
+    /// Book/activate the detector histograms of the current layout and
+    /// the scoring ntuple according to its output mode
+    void BookDetectorHistograms();
+    void WriteCheckpoint(G4int eventsDone);
+    void RestoreCheckpoint(const G4String& file);
+    /// Master: turn this run's generator estimates into the windows of
+    /// the next pass, write them and report the pass
+    void UpdateWindowGenerator(G4int nEvents, G4double seconds, const G4String& outputFile);
+    /// Wall-clock seconds of this run, including those before a resume
+    G4double RunTime() const;
     
     G4Timer fTimer;
     NESSASteppingAction* fSteppingAction;
+    NESSAActivationAccumulable fActivation;  // merged into the master copy
+    NESSATallyStats            fTallies;     // detector tally moments
+    NESSATallyStats            fNextEvent;   // point-estimator moments
+    NESSATallyStats            fActivationTallies;  // Ar-41 / all radioactive
+    NESSATallyStats            fSurfaceTallies;     // surface current / fluence
+    // Mesh tallies: the master merges into its own; workers register the
+    // stepping action's directly (a copy would double their memory)
+    NESSAMeshTally             fOwnMeshTallies;
+    NESSAMeshTally*            fMeshTallies;
+    NESSACellTally             fOwnCellTallies;  // the same for the cell tally
+    NESSACellTally*            fCellTallies;
+    NESSACellImportance        fOwnCellImportance;  // and for the split counts
+    NESSACellImportance*       fCellImportance;
+    NESSAWeightWindow          fOwnWeightWindow;  // and for the window counts
+    NESSAWeightWindow*         fWeightWindow;
+    NESSAWeightWindowGenerator fOwnWindowGenerator;  // and for the generator sums
+    NESSAWeightWindowGenerator* fWindowGenerator;
+    std::map<G4String, G4String> fSpectrumBinning;  // H1 name -> binning spec booked
+    
+    // Checkpointing (serial only)
+    G4int fRestoredEvents = 0;  // events done before a resume
+    G4int fSeedRunID = 0;       // run ID in the event keys (kept on resume)
+    G4double fRestoredTime = 0; // run time before a resume [s]
+    std::chrono::steady_clock::time_point fRunStart;
+    G4int fEventsTotal = 0;     // events of the full (uninterrupted) run
+    G4int fLastCheckpointEvents = 0;
+    std::chrono::steady_clock::time_point fLastCheckpointTime;
 };
 
 #endif
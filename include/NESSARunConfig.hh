@@ -0,0 +1,74 @@
+#ifndef NESSARunConfig_h
+#define NESSARunConfig_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+
+/// Singleton run control settings (set from /nessa/run/ commands).
+/// Modified only from the master between runs; read by the actions.
+class NESSARunConfig {
+public:
+    static NESSARunConfig& Instance() {
+        static NESSARunConfig instance;
+        return instance;
+    }
+    
+    /// Checkpoint every N events (0 = off)
+    G4int GetCheckpointEvery() const { return fCheckpointEvery; }
+    void  SetCheckpointEvery(G4int n) { fCheckpointEvery = n; }
+    
+    /// Checkpoint every T minutes of wall-clock time (0 = off)
+    G4double GetCheckpointMinutes() const { return fCheckpointMinutes; }
+    void     SetCheckpointMinutes(G4double t) { fCheckpointMinutes = t; }
+    
+    const G4String& GetCheckpointFile() const { return fCheckpointFile; }
+    void SetCheckpointFile(const G4String& f) { fCheckpointFile = f; }
+    
+    /// Checkpoint to restore at the start of the next run ("" = none)
+    const G4String& GetResumeFile() const { return fResumeFile; }
+    void SetResumeFile(const G4String& f) { fResumeFile = f; }
+    
+    /// Per-event seeding: each event's engine is reseeded from
+    /// (seed, run ID, eventOffset + event ID); 0 = off (global stream)
+    G4long GetEventSeed() const { return fEventSeed; }
+    void   SetEventSeed(G4long s) { fEventSeed = s; }
+    
+    /// Added to the event ID so process i of a farm continues the
+    /// event numbering of a single serial run
+    G4long GetEventOffset() const { return fEventOffset; }
+    void   SetEventOffset(G4long n) { fEventOffset = n; }
+    
+    /// Scoring ntuple granularity (histograms and tallies are unaffected):
+    /// no rows, a random fraction of the step rows (rowWeight = 1/fraction),
+    /// one row per track and detector visit, or one row per step
+    enum ScoringNtupleMode { kNtupleOff, kNtupleSampled, kNtuplePerTrack, kNtupleFull };
+    ScoringNtupleMode GetScoringNtupleMode() const { return fScoringNtupleMode; }
+    void SetScoringNtupleMode(ScoringNtupleMode m) { fScoringNtupleMode = m; }
+    
+    /// Fraction of step rows kept in sampled mode
+    G4double GetScoringSampleFraction() const { return fScoringSampleFraction; }
+    void     SetScoringSampleFraction(G4double f) { fScoringSampleFraction = f; }
+    
+    /// Source strength [n/s] for dose rates and saturation activities
+    G4double GetSourceRate() const { return fSourceRate; }
+    void     SetSourceRate(G4double s) { fSourceRate = s; }
+    
+    G4bool CheckpointingEnabled() const {
+        return fCheckpointEvery > 0 || fCheckpointMinutes > 0;
+    }
+    
+private:
+    NESSARunConfig() = default;
+    
+    G4int    fCheckpointEvery   = 0;
+    G4double fCheckpointMinutes = 0;
+    G4String fCheckpointFile    = "nessa_checkpoint.dat";
+    G4String fResumeFile;
+    G4long   fEventSeed   = 0;
+    G4long   fEventOffset = 0;
+    ScoringNtupleMode fScoringNtupleMode = kNtupleFull;
+    G4double fScoringSampleFraction = 0.01;
+    G4double fSourceRate = 1.0e8;  // typical Adelphi DT-110 output
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef NESSARunMessenger_h
+#define NESSARunMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIdirectory.hh"
+
+/// Macro commands for run control:
+///   /nessa/run/checkpointEvery N
+///   /nessa/run/checkpointMinutes T
+///   /nessa/run/checkpointFile file
+///   /nessa/run/resume [file]
+///   /nessa/run/untilPrecision detector|all relErr [maxTime]
+///   /nessa/run/eventSeed seed
+///   /nessa/run/eventOffset N
+///   /nessa/output/scoringNtuple off|sampled [fraction]|perTrack|full
+///   /nessa/dose/quantity name
+///   /nessa/dose/sourceRate S
+class NESSARunMessenger : public G4UImessenger
+{
+public:
+    NESSARunMessenger();
+    ~NESSARunMessenger() override;
+    void SetNewValue(G4UIcommand*, G4String) override;
+    
+private:
+    G4UIdirectory*        fRunDir;
+    G4UIcmdWithAnInteger* fCheckpointEveryCmd;
+    G4UIcmdWithADouble*   fCheckpointMinutesCmd;
+    G4UIcmdWithAString*   fCheckpointFileCmd;
+    G4UIcmdWithAString*   fResumeCmd;
+    G4UIcmdWithAString*   fUntilPrecisionCmd;
+    G4UIcmdWithAnInteger* fEventSeedCmd;
+    G4UIcmdWithAnInteger* fEventOffsetCmd;
+    G4UIdirectory*        fOutputDir;
+    G4UIcmdWithAString*   fScoringNtupleCmd;
+    G4UIdirectory*        fDoseDir;
+    G4UIcmdWithAString*   fDoseQuantityCmd;
+    G4UIcmdWithADouble*   fSourceRateCmd;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef NESSARunSummary_h
+#define NESSARunSummary_h 1
+
+#include "NESSASteppingAction.hh"
+#include "NESSATallyStats.hh"
+#include "G4String.hh"
+#include <iosfwd>
+#include <vector>
+
+/// Per-history moments of one tally
+struct TallyEntry {
+    G4String name;      // detector, surface, or isotope for activation
+    G4int    particle;  // 0/1 = n/photon track length [cm],
+                        // 2/3 = n/photon next-event flux [1/cm2],
+                        // 4/5 = n/photon dose from track length [pSv],
+                        // 6/7 = n/photon dose from next-event flux [pSv],
+                        // 8   = activation products [atoms],
+                        // 10/11 = n/photon surface current [particles],
+                        // 12/13 = n/photon surface fluence [1/cm2]
+    TallyMoments moments;        // sums over histories of x .. x^4
+    TallyChart   chart;          // fluctuation chart
+    std::vector<G4double> tail;  // largest history scores, decreasing
+};
+
+/// End-of-run results that are not in the ROOT histograms: event count,
+/// per-history tally moments and the activation tables. Written next to
+/// the analysis output as <output>_summary.dat (keyword text, full double
+/// precision) so independent processes can be merged exactly.
+class NESSARunSummary
+{
+public:
+    using IsotopeMap       = NESSASteppingAction::IsotopeMap;
+    using VolumeIsotopeMap = NESSASteppingAction::VolumeIsotopeMap;
+    
+    G4double                nEvents = 0;
+    G4double                sourceRate = 0;  // n/s, for dose rates (0 = unknown)
+    G4String                doseQuantity;    // conversion used for the dose tallies
+    G4double                runTime = 0;     // wall-clock seconds, for the FOM
+    std::vector<TallyEntry> tallies;
+    IsotopeMap              globalProd;
+    VolumeIsotopeMap        volumeProd;
+    
+    G4bool Write(const G4String& filename) const;
+    G4bool Read(const G4String& filename);
+    
+    /// Stream versions; Read() skips keywords it does not know, so the
+    /// summary can be embedded in other keyword files (checkpoints)
+    void Write(std::ostream& out) const;
+    void Read(std::istream& in);
+    
+    /// Add another summary: events, run time, tally sums (matched by name
+    /// and particle) and isotope counts are summed.
+    void Add(const NESSARunSummary& other);
+    
+    /// Print mean track length, point flux or dose per source particle
+    /// (dose as a rate [uSv/h] when sourceRate is known) with relative
+    /// error, variance of the variance, figure of merit and the ten
+    /// statistical checks (NESSATallyStats)
+    void PrintTallies() const;
+    
+    /// Statistics of one tally of this summary
+    TallyStatistics Statistics(const TallyEntry& t) const;
+    
+    /// "dir/nessa_output.root" -> "dir/nessa_output_summary.dat"
+    static G4String FileNameFor(const G4String& outputFile);
+};
+
+#endif
@@ -3,8 +3,13 @@
 
 #include "G4ThreeVector.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4AutoLock.hh"
+#include "NESSAEnergyBinning.hh"
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 
 /// A single scoring point detector
 struct ScoringPoint {
@@ -13,9 +18,15 @@ struct ScoringPoint {
     G4double radius;      // cm
     G4int    mcnpCell;    // corresponding MCNP cell, -1 if new
     G4bool   active;      // can be toggled from macro
+    G4bool   nextEvent = false;  // also scored by the point estimator
+    G4String binning[2];  // spectrum binning spec (n, gamma); empty = default
+    G4String timeBinning;  // time bins [s], a log spec; empty = no time tally
+    G4int    timeEnergyBins = 20;  // energy bins of the energy x time array
 };
 
-/// Singleton configuration for scoring
+/// Singleton configuration for scoring.
+/// Shared by all threads: modified only from the master (UI commands,
+/// between runs) under fMutex; workers only read it during a run.
 class NESSAScoringConfig {
 public:
     static NESSAScoringConfig& Instance() {
@@ -24,16 +35,24 @@ public:
     }
     
     const std::vector<ScoringPoint>& GetPoints() const { return fPoints; }
-    std::vector<ScoringPoint>& GetPointsMutable() { return fPoints; }
+    
+    /// Every detector name configured in this process, in first-seen
+    /// order, including removed ones. Histograms are booked for all of
+    /// them so every thread assigns the same IDs whatever the layout.
+    const std::vector<G4String>& GetAllNames() const { return fAllNames; }
     
     /// Add a detector from macro command
     void AddDetector(const G4String& name, G4double x, G4double y, G4double z,
                      G4double r) {
+        G4AutoLock lock(&fMutex);
         fPoints.push_back({name, x, y, z, r, -1, true});
+        if (std::find(fAllNames.begin(), fAllNames.end(), name) == fAllNames.end())
+            fAllNames.push_back(name);
     }
     
     /// Remove detector by name
     void RemoveDetector(const G4String& name) {
+        G4AutoLock lock(&fMutex);
         for (auto it = fPoints.begin(); it != fPoints.end(); ++it) {
             if (it->name == name) { fPoints.erase(it); return; }
         }
@@ -41,11 +60,79 @@ public:
     
     /// Enable/disable
     void SetActive(const G4String& name, G4bool active) {
+        G4AutoLock lock(&fMutex);
         for (auto& p : fPoints) {
             if (p.name == name) { p.active = active; return; }
         }
     }
     
+    /// Point (next-event) estimator on/off for one detector or "all"
+    void SetNextEvent(const G4String& name, G4bool on) {
+        G4AutoLock lock(&fMutex);
+        for (auto& p : fPoints) {
+            if (name == "all" || p.name == name) p.nextEvent = on;
+        }
+    }
+    
+    /// Spectrum binning (NESSAEnergyBinning spec) of one detector or
+    /// "all" for particle 0 = n, 1 = gamma; "" restores the default
+    void SetBinning(const G4String& name, G4int particle, const G4String& spec) {
+        G4AutoLock lock(&fMutex);
+        for (auto& p : fPoints) {
+            if (name == "all" || p.name == name) p.binning[particle] = spec;
+        }
+    }
+    
+    /// Binning spec in use for a detector and particle
+    static G4String GetBinning(const ScoringPoint& p, G4int particle) {
+        if (!p.binning[particle].empty()) return p.binning[particle];
+        return particle == 0 ? NESSAEnergyBinning::kDefaultNeutron
+                             : NESSAEnergyBinning::kDefaultPhoton;
+    }
+    
+    /// Time tallies of one detector or "all": nTime log bins from tMin to
+    /// tMax [s] and nEnergy log energy bins for the energy x time array;
+    /// nTime = 0 turns them off
+    void SetTimeBinning(const G4String& name, G4int nTime, G4double tMin,
+                        G4double tMax, G4int nEnergy) {
+        G4AutoLock lock(&fMutex);
+        G4String spec;
+        if (nTime > 0) {
+            spec = "log " + std::to_string(nTime) + " " + ToString(tMin) + " "
+                 + ToString(tMax);
+        }
+        for (auto& p : fPoints) {
+            if (name != "all" && p.name != name) continue;
+            p.timeBinning = spec;
+            p.timeEnergyBins = nEnergy;
+        }
+    }
+    
+    /// Energy axis of the energy x time array of a detector (log bins over
+    /// the default spectrum range of the particle)
+    static G4String GetTimeEnergyBinning(const ScoringPoint& p, G4int particle) {
+        return "log " + std::to_string(p.timeEnergyBins)
+             + (particle == 0 ? " 1e-11 20" : " 1e-3 20");
+    }
+    
+    /// Kill every track once its time passes the last time bin of the
+    /// active detectors (nothing later can be scored in them)
+    void SetTimeCutoff(G4bool on) { fTimeCutoff = on; }
+    
+    /// Cutoff time [s] for the current layout, 0 = none
+    G4double GetTimeCutoff() const {
+        if (!fTimeCutoff) return 0.;
+        G4double cutoff = 0.;
+        for (const auto& p : fPoints) {
+            if (!p.active || p.timeBinning.empty()) continue;
+            std::vector<G4double> edges;
+            G4String error;
+            if (NESSAEnergyBinning::MakeEdges(p.timeBinning, edges, error))
+                cutoff = std::max(cutoff, edges.back());
+        }
+        return cutoff;
+    }
+    
     G4int GetNActive() const {
         G4int n = 0;
         for (const auto& p : fPoints) if (p.active) n++;
@@ -78,9 +165,20 @@ private:
         fPoints.push_back({"Lab_entrance",   195, 720, 150, 5.0, -1, true});
         fPoints.push_back({"Lab_middle",     195, 780, 150, 5.0, -1, true});
         fPoints.push_back({"Lab_exit",       195, 860, 150, 5.0, -1, true});
+        for (const auto& p : fPoints) fAllNames.push_back(p.name);
+    }
+    
+    /// Enough digits for a round trip in a spec, unlike std::to_string
+    static G4String ToString(G4double x) {
+        std::ostringstream oss;
+        oss << std::setprecision(15) << x;
+        return oss.str();
     }
     
     std::vector<ScoringPoint> fPoints;
+    std::vector<G4String>     fAllNames;
+    G4bool fTimeCutoff = false;
+    G4Mutex fMutex;
 };
 
 #endif
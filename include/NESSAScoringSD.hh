@@ -2,11 +2,29 @@
 #define NESSAScoringSD_h 1
 
 #include "G4VSensitiveDetector.hh"
+#include "NESSATallyStats.hh"
+#include "NESSASplitMix.hh"
+#include "NESSAEnergyBinning.hh"
+#include <vector>
 
 class G4Step;
+class G4ParticleDefinition;
+class G4LogicalVolume;
 
 /// Records neutron/photon energy spectra and dose in scoring volumes.
 /// Uses G4AnalysisManager histograms and ntuples for ROOT output.
+/// Dose is the track-length fluence (weighted length / volume) times the
+/// fluence-to-dose coefficient of the selected quantity at the step's
+/// energy (NESSADoseConversion), so it needs no pass over the ntuple.
+/// One instance per thread (created in ConstructSDandField), so the
+/// volume -> detector table is private to the thread that fills it.
+///
+/// ProcessHits only appends a compact hit to a per-event buffer; the
+/// histograms, ntuple and per-history tallies are filled from the buffer
+/// in EndOfEvent. The buffer keeps its capacity, so after the first few
+/// events scoring does no allocation. Spectrum bins are looked up once
+/// per hit (NESSAEnergyBinning, constant time for any group structure)
+/// and the histograms are updated from per-bin sums by FlushHistograms.
 class NESSAScoringSD : public G4VSensitiveDetector
 {
 public:
@@ -16,6 +34,66 @@ public:
     void Initialize(G4HCofThisEvent*) override;
     G4bool ProcessHits(G4Step*, G4TouchableHistory*) override;
     void EndOfEvent(G4HCofThisEvent*) override;
+    
+    /// Drop all attached volumes and resize the tallies for the current
+    /// detector layout (the SD is reused when the geometry is rebuilt)
+    void Reconfigure();
+    
+    /// Make lv score as detector index (rank among active detectors); its
+    /// solid's volume normalises the fluence. Called from
+    /// ConstructSDandField alongside SetSensitiveDetector.
+    void AttachVolume(const G4LogicalVolume* lv, G4int index);
+    
+    /// H1 IDs, four per active detector: n_spec, n_dose, g_spec, g_dose
+    /// (set by NESSARunAction when it books the histograms for a run);
+    /// the spectrum binning of each detector is taken from its n_spec
+    /// and g_spec histograms
+    void SetHistogramIDs(const std::vector<G4int>& ids);
+    
+    /// Time tallies (/nessa/detector/timeBins), two per active detector
+    /// (n, g): the time spectrum H1 and energy x time H2 IDs, -1 for a
+    /// detector without them. The axes are taken from the histograms.
+    void SetTimeHistogramIDs(const std::vector<G4int>& h1Ids,
+                             const std::vector<G4int>& h2Ids);
+    
+    /// Add the spectra scored so far to the histograms (before they are
+    /// written or checkpointed)
+    void FlushHistograms();
+    
+    /// Per-history tallies: track length [cm] in bin 2*detector + (0=n,
+    /// 1=gamma), dose [pSv] in bin 2*(nActive + detector) + (0=n, 1=gamma)
+    NESSATallyStats& GetTallies() { return fTallies; }
+
+private:
+    /// One scoring step (energies in MeV, length in cm, unweighted)
+    struct Hit {
+        G4int    det;       // active detector index
+        G4int    particle;  // 0 = neutron, 1 = gamma
+        G4int    trackID;
+        G4double energy;    // pre-step kinetic energy
+        G4double time;      // pre-step global time [s]
+        G4double edep;
+        G4double length;
+        G4double weight;
+    };
+    
+    void FlushHits();
+    
+    const G4ParticleDefinition* fNeutron;  // resolved once, compared by pointer
+    const G4ParticleDefinition* fGamma;
+    std::vector<G4int> fIndexByLV;       // LV instance ID -> detector index, -1 = none
+    std::vector<G4double> fInvVolume;    // per detector index, 1/cm3
+    std::vector<NESSABinnedH1> fSpectra;     // 4*index + {n_spec, n_dose, g_spec, g_dose}
+    std::vector<NESSAEnergyBinning> fBinning; // 2*index + {n, g}
+    std::vector<NESSABinnedH1> fTimeSpectra;  // 2*index + {n, g}, time tallies
+    std::vector<NESSABinnedH2> fTimeEnergy;   // 2*index + {n, g}
+    std::vector<NESSAEnergyBinning> fTimeBinning;        // 2*index + {n, g}
+    std::vector<NESSAEnergyBinning> fTimeEnergyBinning;  // 2*index + {n, g}
+    std::vector<char> fTimed;                // per index: has time tallies
+    std::vector<Hit> fHits;              // this event's hits
+    NESSASplitMix fSampler;              // ntuple row sampling, not the engine
+    G4int fNActive = 0;
+    NESSATallyStats fTallies;
 };
 
 #endif
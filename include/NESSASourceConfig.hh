@@ -0,0 +1,82 @@
+#ifndef NESSASourceConfig_h
+#define NESSASourceConfig_h 1
+
+#include "G4Types.hh"
+#include "G4ThreeVector.hh"
+#include "G4AutoLock.hh"
+#include <vector>
+
+/// Direction biasing of the Adelphi source (set from /nessa/source/
+/// commands, on the master between runs). The generators compare the
+/// version with the one they were built for and rebuild their sampling
+/// tables when it changed.
+class NESSASourceConfig {
+public:
+    /// Cosine range whose bins are sampled more (factor > 1) or less often
+    struct CosineFactor {
+        G4double muLo, muHi;
+        G4double factor;
+    };
+    
+    static NESSASourceConfig& Instance() {
+        static NESSASourceConfig instance;
+        return instance;
+    }
+    
+    /// Incremented by every change
+    G4int GetVersion() const { return fVersion; }
+    
+    /// Biased probability per direction bin (need not be normalised);
+    /// empty = the analog probabilities
+    const std::vector<G4double>& GetBinProbabilities() const { return fBinProbabilities; }
+    void SetBinProbabilities(const std::vector<G4double>& p) {
+        G4AutoLock lock(&fMutex);
+        fBinProbabilities = p;
+        fVersion++;
+    }
+    
+    /// Factors on the probabilities of the bins whose centre lies in a
+    /// cosine range, applied in order on top of the above
+    const std::vector<CosineFactor>& GetCosineFactors() const { return fCosineFactors; }
+    void AddCosineFactor(G4double muLo, G4double muHi, G4double factor) {
+        G4AutoLock lock(&fMutex);
+        fCosineFactors.push_back({muLo, muHi, factor});
+        fVersion++;
+    }
+    
+    /// Azimuthal cone toward a target point [cm]: a fraction of the
+    /// emissions get an azimuth within halfWidth [deg] of the target's
+    G4bool HasCone() const { return fConeHalfWidth > 0.; }
+    const G4ThreeVector& GetConeTarget() const { return fConeTarget; }
+    G4double GetConeHalfWidth() const { return fConeHalfWidth; }
+    G4double GetConeFraction() const { return fConeFraction; }
+    void SetCone(const G4ThreeVector& target, G4double halfWidth, G4double fraction) {
+        G4AutoLock lock(&fMutex);
+        fConeTarget = target;
+        fConeHalfWidth = halfWidth;
+        fConeFraction = fraction;
+        fVersion++;
+    }
+    
+    /// Back to the analog source
+    void Clear() {
+        G4AutoLock lock(&fMutex);
+        fBinProbabilities.clear();
+        fCosineFactors.clear();
+        fConeHalfWidth = 0.;
+        fVersion++;
+    }
+    
+private:
+    NESSASourceConfig() = default;
+    
+    G4int fVersion = 0;
+    std::vector<G4double> fBinProbabilities;
+    std::vector<CosineFactor> fCosineFactors;
+    G4ThreeVector fConeTarget;
+    G4double fConeHalfWidth = 0.;   // [deg], 0 = no cone
+    G4double fConeFraction = 0.5;
+    mutable G4Mutex fMutex = G4MUTEX_INITIALIZER;
+};
+
+#endif
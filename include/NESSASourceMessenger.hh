@@ -0,0 +1,31 @@
+#ifndef NESSASourceMessenger_h
+#define NESSASourceMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIdirectory.hh"
+
+/// Macro commands for the direction biasing of the Adelphi source
+/// (NESSASourceConfig):
+///   /nessa/source/biasFile file
+///   /nessa/source/biasCosine muLo muHi factor
+///   /nessa/source/cone x y z halfWidth [fraction]
+///   /nessa/source/analog
+/// Changes apply from the next run.
+class NESSASourceMessenger : public G4UImessenger
+{
+public:
+    NESSASourceMessenger();
+    ~NESSASourceMessenger() override;
+    void SetNewValue(G4UIcommand*, G4String) override;
+    
+private:
+    G4UIdirectory*           fSourceDir;
+    G4UIcmdWithAString*      fBiasFileCmd;
+    G4UIcmdWithAString*      fBiasCosineCmd;
+    G4UIcmdWithAString*      fConeCmd;
+    G4UIcmdWithoutParameter* fAnalogCmd;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef NESSASplitMix_h
+#define NESSASplitMix_h 1
+
+#include "G4Types.hh"
+#include <cstdint>
+
+/// splitmix64 finalizer: counter -> well-mixed 64-bit value
+inline uint64_t NESSAMixBits(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/// Small counter-based stream for side decisions (ntuple sampling,
+/// estimator energies) that must not draw from the Geant4 engine, so
+/// that switching them on or off leaves the histories unchanged.
+class NESSASplitMix
+{
+public:
+    void Seed(uint64_t seed) { fState = NESSAMixBits(seed); }
+    
+    /// Uniform in [0, 1), 53 random bits
+    G4double Uniform() {
+        uint64_t x = NESSAMixBits(fState);
+        fState += 0x9E3779B97F4A7C15ULL;
+        return (x >> 11) * 0x1.0p-53;
+    }
+    
+private:
+    uint64_t fState = 0;
+};
+
+#endif
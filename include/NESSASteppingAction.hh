@@ -4,10 +4,19 @@
 #include "G4UserSteppingAction.hh"
 #include "G4String.hh"
 #include "G4Types.hh"
+#include "NESSATallyStats.hh"
+#include "NESSAMeshTally.hh"
+#include "NESSASurfaceTally.hh"
+#include "NESSACellTally.hh"
+#include "NESSACellImportance.hh"
+#include "NESSAWeightWindow.hh"
+#include "NESSAWeightWindowGenerator.hh"
 #include <map>
 #include <string>
 
 class G4Step;
+class G4ParticleDefinition;
+class NESSANextEventEstimator;
 
 /// Isotope identifier: (Z, A, isomer)
 struct IsotopeID {
@@ -51,6 +60,38 @@ public:
     using VolumeIsotopeMap = std::map<std::string, IsotopeMap>;
     const VolumeIsotopeMap& GetVolumeProduction() const { return fVolumeProd; }
     
+    /// Per-history production tallies (weighted atoms), for the run
+    /// statistics; folded by NESSAEventAction at the end of each event
+    enum { kAr41Tally, kRadioactiveTally, kNActivationTallies };
+    NESSATallyStats& GetActivationTallies() { return fActivationTallies; }
+    
+    /// Track-length mesh tallies of this thread (/nessa/mesh/)
+    NESSAMeshTally& GetMeshTallies() { return fMeshTallies; }
+    
+    /// Surface current/fluence tallies of this thread (/nessa/surface/)
+    NESSASurfaceTally& GetSurfaceTallies() { return fSurfaceTallies; }
+    
+    /// All-cell flux tally of this thread (/nessa/cell/tally)
+    NESSACellTally& GetCellTallies() { return fCellTallies; }
+    
+    /// Splitting/roulette on cell importances of this thread (/nessa/cell/)
+    NESSACellImportance& GetCellImportance() { return fCellImportance; }
+    
+    /// Mesh weight windows of this thread (/nessa/ww/)
+    NESSAWeightWindow& GetWeightWindow() { return fWeightWindow; }
+    
+    /// Weight-window generator of this thread (/nessa/ww/gen/)
+    NESSAWeightWindowGenerator& GetWindowGenerator() { return fWindowGenerator; }
+    
+    /// Kill tracks whose global time passes cutoff (0 = no cutoff)
+    void SetTimeCutoff(G4double cutoff) { fTimeCutoff = cutoff; }
+    
+    /// Replace the production tables (checkpoint restore)
+    void SetProduction(const IsotopeMap& global, const VolumeIsotopeMap& volumes) {
+        fGlobalProd = global;
+        fVolumeProd = volumes;
+    }
+    
     /// Human-readable isotope name (e.g. "Ar-41", "Fe-59m")
     static std::string IsotopeName(const IsotopeID& id);
     
@@ -58,8 +99,21 @@ public:
     static const char* ElementSymbol(G4int Z);
     
 private:
+    /// Isotopes made by this neutron step's secondaries
+    void RecordActivation(const G4Step* step);
+    
+    const G4ParticleDefinition* fNeutron;  // resolved once, compared by pointer
+    NESSANextEventEstimator*    fNextEvent;  // this thread's point estimator
     IsotopeMap       fGlobalProd;
     VolumeIsotopeMap fVolumeProd;
+    NESSATallyStats  fActivationTallies;
+    NESSAMeshTally   fMeshTallies;
+    NESSASurfaceTally fSurfaceTallies;
+    NESSACellTally   fCellTallies;
+    NESSACellImportance fCellImportance;
+    NESSAWeightWindow fWeightWindow;
+    NESSAWeightWindowGenerator fWindowGenerator;
+    G4double         fTimeCutoff = 0.;  // internal units, 0 = none
 };
 
 #endif
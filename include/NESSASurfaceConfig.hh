@@ -0,0 +1,62 @@
+#ifndef NESSASurfaceConfig_h
+#define NESSASurfaceConfig_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include "G4AutoLock.hh"
+#include <algorithm>
+#include <vector>
+
+/// One tally surface: a plane through point with the given normal, or
+/// the disc of that radius around point on it (global coordinates, cm)
+struct SurfaceSpec {
+    G4String name;
+    G4double point[3];
+    G4double normal[3];     // normalised; the current counts crossings along it
+    G4double radius = 0.;   // 0 = infinite plane (current only, no fluence)
+};
+
+/// Surface tallies for the next runs (NESSASurfaceTally); a shared
+/// singleton like NESSAScoringConfig, changed from macros on the master
+/// between runs.
+class NESSASurfaceConfig {
+public:
+    static NESSASurfaceConfig& Instance() {
+        static NESSASurfaceConfig instance;
+        return instance;
+    }
+    
+    const std::vector<SurfaceSpec>& GetSurfaces() const { return fSurfaces; }
+    
+    /// Every surface name defined in this process, in first-seen order;
+    /// histograms are booked for all of them (see GetAllNames of
+    /// NESSAScoringConfig)
+    const std::vector<G4String>& GetAllNames() const { return fAllNames; }
+    
+    /// Add a surface, replacing one of the same name
+    void AddSurface(const SurfaceSpec& spec) {
+        G4AutoLock lock(&fMutex);
+        if (std::find(fAllNames.begin(), fAllNames.end(), spec.name) == fAllNames.end())
+            fAllNames.push_back(spec.name);
+        for (auto& s : fSurfaces) {
+            if (s.name == spec.name) { s = spec; return; }
+        }
+        fSurfaces.push_back(spec);
+    }
+    
+    void RemoveSurface(const G4String& name) {
+        G4AutoLock lock(&fMutex);
+        for (auto it = fSurfaces.begin(); it != fSurfaces.end(); ++it) {
+            if (it->name == name) { fSurfaces.erase(it); return; }
+        }
+    }
+    
+private:
+    NESSASurfaceConfig() = default;
+    
+    std::vector<SurfaceSpec> fSurfaces;
+    std::vector<G4String>    fAllNames;
+    G4Mutex fMutex = G4MUTEX_INITIALIZER;
+};
+
+#endif
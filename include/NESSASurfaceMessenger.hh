@@ -0,0 +1,28 @@
+#ifndef NESSASurfaceMessenger_h
+#define NESSASurfaceMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIdirectory.hh"
+
+/// Macro commands for the surface tallies (NESSASurfaceTally):
+///   /nessa/surface/add name x y z nx ny nz [radius]
+///   /nessa/surface/remove name
+///   /nessa/surface/list
+/// Changes apply from the next run; no geometry rebuild is needed.
+class NESSASurfaceMessenger : public G4UImessenger
+{
+public:
+    NESSASurfaceMessenger();
+    ~NESSASurfaceMessenger() override;
+    void SetNewValue(G4UIcommand*, G4String) override;
+    
+private:
+    G4UIdirectory*           fSurfaceDir;
+    G4UIcmdWithAString*      fAddCmd;
+    G4UIcmdWithAString*      fRemoveCmd;
+    G4UIcmdWithoutParameter* fListCmd;
+};
+
+#endif
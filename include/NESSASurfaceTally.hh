@@ -0,0 +1,57 @@
+#ifndef NESSASurfaceTally_h
+#define NESSASurfaceTally_h 1
+
+#include "G4ThreeVector.hh"
+#include "G4Types.hh"
+#include "NESSATallyStats.hh"
+#include "NESSASurfaceConfig.hh"
+#include "tools/histo/h2d"
+#include <vector>
+
+class G4Step;
+class G4ParticleDefinition;
+
+/// MCNP F1/F2-style surface tallies on planes and discs, scored from the
+/// stepping action. A neutral step crosses a surface when its end points
+/// lie on opposite sides: two dot products per surface and step, so
+/// dozens of surfaces cost little.
+///
+/// Per surface and particle (per-history moments, in the run summary):
+///   current  F1: weight crossing along the normal
+///   fluence  F2: weight / (|cos| area) over both directions, discs only;
+///                |cos| < 0.1 counts as 0.05 (MCNP grazing rule)
+/// and an energy x cosine histogram of all crossings, n_surf_<name> and
+/// g_surf_<name> (cosine to the normal, negative = against it).
+class NESSASurfaceTally
+{
+public:
+    NESSASurfaceTally();
+    
+    /// Bins: current at 2*index + particle, fluence offset by 2*nSurfaces
+    void SetUp(const std::vector<SurfaceSpec>& specs);
+    G4bool IsEmpty() const { return fSurfaces.empty(); }
+    
+    /// Histograms, 2 per surface (n, g) in SetUp order
+    void SetHistogramIDs(const std::vector<G4int>& ids);
+    
+    /// Score one step of a neutron or photon (hot path)
+    void ScoreStep(const G4Step* step);
+    
+    NESSATallyStats& GetTallies() { return fTallies; }
+    
+private:
+    struct Surface {
+        G4ThreeVector point, normal;  // [mm]
+        G4double radius2;             // 0 = plane
+        G4double invArea;             // 1/cm2, 0 = plane
+    };
+    
+    const G4ParticleDefinition* fNeutron;
+    const G4ParticleDefinition* fGamma;
+    std::vector<Surface> fSurfaces;
+    G4int fFluenceOffset = 0;
+    std::vector<tools::histo::h2d*> fH2;  // 2*index + particle
+    NESSATallyStats fTallies;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef NESSATallyStats_h
+#define NESSATallyStats_h 1
+
+#include "G4VAccumulable.hh"
+#include "G4Types.hh"
+#include <vector>
+
+/// Sums over histories of x, x^2, x^3 and x^4 for one tally bin
+struct TallyMoments {
+    G4double s1 = 0., s2 = 0., s3 = 0., s4 = 0.;
+    
+    void Add(G4double x) {
+        G4double x2 = x * x;
+        s1 += x; s2 += x2; s3 += x2 * x; s4 += x2 * x2;
+    }
+    TallyMoments& operator+=(const TallyMoments& o) {
+        s1 += o.s1; s2 += o.s2; s3 += o.s3; s4 += o.s4;
+        return *this;
+    }
+};
+
+/// Tally fluctuation chart: moments per segment of width histories in
+/// history-number order (kChartPoints segments, the last ones possibly
+/// still empty). When a history falls beyond the last segment the width
+/// doubles and neighbouring segments are combined, so the chart always
+/// spans the run without knowing its length in advance.
+struct TallyChart {
+    G4double width = 1.;
+    std::vector<G4double> n;      // histories per segment
+    std::vector<TallyMoments> m;  // moments per segment
+    
+    /// Double the width until it is at least w
+    void CoarsenTo(G4double w);
+    /// Add another chart of the same histories' numbering, coarsening
+    /// this one first if the other is coarser
+    void Add(const TallyChart& other);
+};
+
+/// MCNP statistics of one tally: mean, relative error R, variance of the
+/// variance, figure of merit 1/(R^2 T), slope of the history-score tail
+/// and the ten statistical checks (true = passed):
+///   1 mean: no monotonic trend over the last half of the run
+///   2 R < 0.10 (0.05 for point detectors)
+///   3 R: monotonically decreasing over the last half
+///   4 R: decreasing as 1/sqrt(N) (fitted exponent within 50%)
+///   5 VOV < 0.10
+///   6 VOV: monotonically decreasing over the last half
+///   7 VOV: decreasing as 1/N (fitted exponent within 50%)
+///   8 FOM: constant (last half within 10% of the final value)
+///   9 FOM: no monotonic trend over the last half
+///  10 slope of the score PDF tail >= 3 (10 = no tail)
+struct TallyStatistics {
+    G4double mean = 0., relErr = 0., vov = 0., fom = 0., slope = 0.;
+    G4bool   checks[10] = {};
+    
+    G4int NPassed() const {
+        G4int n = 0;
+        for (G4bool c : checks) n += c;
+        return n;
+    }
+};
+
+/// Per-history tally moments (MCNP-style statistics).
+/// Scores are summed over one history and folded into the moments at
+/// EndOfHistory(), so the errors reflect history-to-history fluctuations.
+/// For the convergence checks each bin also keeps its fluctuation chart
+/// (TallyChart, history number set per event with SetChartHistory) and
+/// its kTailSize largest history scores. Everything is additive (the tails keep the
+/// largest of both), so threads, processes and runs combine exactly by
+/// Merge().
+class NESSATallyStats : public G4VAccumulable
+{
+public:
+    static const G4int kChartPoints = 20;
+    static const G4int kTailSize    = 200;
+    
+    explicit NESSATallyStats(const G4String& name = "tallies")
+        : G4VAccumulable(name) {}
+    ~NESSATallyStats() override = default;
+    
+    /// Resize to n bins and clear all sums
+    void SetNBins(G4int n);
+    G4int GetNBins() const { return (G4int)fMoments.size(); }
+    
+    /// Add x to bin for the current history
+    void Score(G4int bin, G4double x) {
+        if (!fIsTouched[bin]) { fIsTouched[bin] = 1; fTouched.push_back(bin); }
+        fHistory[bin] += x;
+    }
+    
+    /// Fold the current history into the sums (call once per event)
+    void EndOfHistory();
+    
+    /// Number of this thread's current history within the run (from 0)
+    static void SetChartHistory(G4long index);
+    
+    void Merge(const G4VAccumulable& other) override;
+    void Reset() override;
+    
+    const TallyMoments& GetMoments(G4int bin) const { return fMoments[bin]; }
+    
+    /// Fluctuation chart of bin
+    TallyChart GetChart(G4int bin) const;
+    /// Largest history scores of bin, in decreasing order
+    std::vector<G4double> GetTail(G4int bin) const;
+    
+    /// Restore a bin (checkpoint); the chart width and histories per
+    /// segment are shared by all bins and set with it
+    void SetState(G4int bin, const TallyMoments& moments, const TallyChart& chart,
+                  const std::vector<G4double>& tail);
+    
+    /// Mean per history and relative error of the mean from the sums
+    /// over nHistories histories: R = sqrt(s2/s1^2 - 1/N)
+    static void MeanAndError(G4double s1, G4double s2, G4double nHistories,
+                             G4double& mean, G4double& relErr);
+    
+    /// Full statistics after nHistories histories in time [s]
+    static TallyStatistics Evaluate(const TallyMoments& moments,
+                                    G4double nHistories, G4double time,
+                                    const TallyChart& chart,
+                                    const std::vector<G4double>& tail,
+                                    G4bool pointDetector);
+    
+    /// Keep the kTailSize largest of tail and more (decreasing order)
+    static void MergeTails(std::vector<G4double>& tail,
+                           const std::vector<G4double>& more);
+    
+private:
+    std::vector<TallyMoments> fMoments;  // per bin
+    void CoarsenChart();  // double fChartWidth
+    
+    std::vector<TallyMoments> fChart;    // per bin, kChartPoints segments each
+    std::vector<G4double>     fChartN;   // histories per segment
+    G4double                  fChartWidth = 1.;  // histories per segment
+    std::vector<std::vector<G4double>> fTails;  // min-heaps of largest scores
+    std::vector<G4double> fHistory;  // current-history score per bin
+    std::vector<char>     fIsTouched;
+    std::vector<G4int>    fTouched;  // bins scored in the current history
+};
+
+#endif
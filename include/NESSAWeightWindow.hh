@@ -0,0 +1,59 @@
+#ifndef NESSAWeightWindow_h
+#define NESSAWeightWindow_h 1
+
+#include "G4VAccumulable.hh"
+#include "G4Types.hh"
+#include "G4TrackVector.hh"
+#include "NESSAWeightWindowMesh.hh"
+#include <memory>
+
+class G4Step;
+class G4ParticleDefinition;
+
+/// Space- and energy-dependent weight windows (MCNP WWN/WWP), applied
+/// from the stepping action at the end of every neutron and photon step
+/// (collisions and boundary crossings) inside the window mesh.
+///
+/// With wl the lower bound of the voxel and energy group (x scale):
+///   w > wu = WUPN wl   split into r = min(w/ws, MXSPLN) tracks (integer
+///                      part plus one with the fraction) of weight w/r
+///   w < wl             roulette: survives with probability w/ws at
+///                      ws = WSURVN wl, otherwise killed
+/// and nothing in between, outside the mesh or where wl = 0.
+///
+/// Every check is counted by outcome per particle; the counts are merged
+/// as an accumulable and printed at end of run.
+class NESSAWeightWindow : public G4VAccumulable
+{
+public:
+    explicit NESSAWeightWindow(const G4String& name = "weightWindows");
+    ~NESSAWeightWindow() override = default;
+    
+    /// Take the windows and parameters of NESSAWeightWindowConfig for the
+    /// next run and clear the counts
+    void SetUp();
+    G4bool IsEmpty() const { return !fMesh; }
+    
+    /// Check the track at the end of a step (hot path); clones are added
+    /// to secondaries
+    void Apply(const G4Step* step, G4TrackVector* secondaries);
+    
+    void Merge(const G4VAccumulable& other) override;
+    void Reset() override;
+    
+    /// Hit statistics per source particle
+    void Print(G4double nEvents) const;
+    
+private:
+    enum Count { kChecks, kNoWindow, kInWindow, kBelow, kRouletted, kAbove,
+                 kClones, kCapped, kNCounts };
+    
+    const G4ParticleDefinition* fNeutron;
+    const G4ParticleDefinition* fGamma;
+    std::shared_ptr<const NESSAWeightWindowMesh> fMesh;
+    G4double fScale = 1., fUpperRatio = 5., fSurvivalRatio = 3.;
+    G4int    fMaxSplit = 5;
+    G4double fCounts[2][kNCounts] = {};  // per particle
+};
+
+#endif
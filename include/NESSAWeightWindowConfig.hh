@@ -0,0 +1,125 @@
+#ifndef NESSAWeightWindowConfig_h
+#define NESSAWeightWindowConfig_h 1
+
+#include "G4Types.hh"
+#include "G4AutoLock.hh"
+#include "NESSAWeightWindowMesh.hh"
+#include <memory>
+#include <vector>
+
+/// Importance estimates of the window generator, summed over its passes
+/// (master only): per particle and LowerIndex bin, the target score
+/// credited to tracks entering the bin, the weight entering it and the
+/// number of entries that led to a score
+struct WeightWindowEstimates {
+    std::vector<G4double> score[2], weight[2], hits[2];
+    G4double sourceScore = 0., sourceWeight = 0.;  // primaries, anywhere
+};
+
+/// Outcome of one generator pass
+struct WeightWindowPass {
+    G4int    events;
+    G4double population;  // tracks scoring in the targets per source particle
+    G4double mean;        // target flux per source particle [1/cm2]
+    G4double relError;
+    G4double seconds;
+    G4long   nSet[2];     // window bounds set, n and gamma
+};
+
+/// Weight windows for the next runs (NESSAWeightWindow): the mesh of
+/// lower bounds, read on the master and shared read-only by all threads,
+/// and the MCNP WWP parameters. A singleton like NESSAMeshConfig.
+class NESSAWeightWindowConfig {
+public:
+    static NESSAWeightWindowConfig& Instance() {
+        static NESSAWeightWindowConfig instance;
+        return instance;
+    }
+    
+    /// Lower bounds, nullptr = no weight windows
+    std::shared_ptr<const NESSAWeightWindowMesh> GetMesh() const {
+        G4AutoLock lock(&fMutex);
+        return fMesh;
+    }
+    void SetMesh(std::shared_ptr<const NESSAWeightWindowMesh> mesh) {
+        G4AutoLock lock(&fMutex);
+        fMesh = mesh;
+    }
+    
+    /// Upper bound / lower bound (WUPN, default 5)
+    G4double GetUpperRatio() const { return fUpperRatio; }
+    /// Survival weight of roulette winners / lower bound (WSURVN, default 3)
+    G4double GetSurvivalRatio() const { return fSurvivalRatio; }
+    /// Most tracks one track is split into at once (MXSPLN, default 5)
+    G4int GetMaxSplit() const { return fMaxSplit; }
+    void SetBounds(G4double upper, G4double survival, G4int maxSplit) {
+        fUpperRatio = upper;
+        fSurvivalRatio = survival;
+        fMaxSplit = maxSplit;
+    }
+    
+    /// Factor applied to all lower bounds (normalises a window file to
+    /// the unit source weight of this program)
+    G4double GetScale() const { return fScale; }
+    void SetScale(G4double s) { fScale = s; }
+    
+    /// Generator mesh: edges and group bounds, no lower bounds; nullptr =
+    /// no generation. A new mesh drops the estimates of earlier passes.
+    std::shared_ptr<const NESSAWeightWindowMesh> GetGeneratorMesh() const {
+        G4AutoLock lock(&fMutex);
+        return fGeneratorMesh;
+    }
+    void SetGeneratorMesh(std::shared_ptr<const NESSAWeightWindowMesh> mesh) {
+        G4AutoLock lock(&fMutex);
+        fGeneratorMesh = mesh;
+        fEstimates = WeightWindowEstimates();
+        fPasses.clear();
+    }
+    
+    /// Detectors (NESSAScoringConfig names) whose flux the windows optimise
+    const std::vector<G4String>& GetTargets() const { return fTargets; }
+    void SetTargets(const std::vector<G4String>& names) {
+        G4AutoLock lock(&fMutex);
+        fTargets = names;
+    }
+    
+    /// Particle whose target flux is scored: 0 = n, 1 = gamma, 2 = both
+    G4int GetTargetParticle() const { return fTargetParticle; }
+    void SetTargetParticle(G4int p) { fTargetParticle = p; }
+    
+    /// Scoring entries a bin needs before it gets a window (default 10)
+    G4int GetMinHits() const { return fMinHits; }
+    void SetMinHits(G4int n) { fMinHits = n; }
+    
+    /// Window file written after every pass; "" = <output>_ww.bin
+    const G4String& GetGeneratorFile() const { return fGeneratorFile; }
+    void SetGeneratorFile(const G4String& file) { fGeneratorFile = file; }
+    
+    /// Estimates and pass history (master, between runs)
+    WeightWindowEstimates& GetEstimates() { return fEstimates; }
+    std::vector<WeightWindowPass>& GetPasses() { return fPasses; }
+    void ResetEstimates() {
+        G4AutoLock lock(&fMutex);
+        fEstimates = WeightWindowEstimates();
+        fPasses.clear();
+    }
+    
+private:
+    NESSAWeightWindowConfig() = default;
+    
+    std::shared_ptr<const NESSAWeightWindowMesh> fMesh;
+    G4double fUpperRatio = 5.;
+    G4double fSurvivalRatio = 3.;
+    G4int    fMaxSplit = 5;
+    G4double fScale = 1.;
+    std::shared_ptr<const NESSAWeightWindowMesh> fGeneratorMesh;
+    std::vector<G4String> fTargets;
+    G4int    fTargetParticle = 2;
+    G4int    fMinHits = 10;
+    G4String fGeneratorFile;
+    WeightWindowEstimates fEstimates;
+    std::vector<WeightWindowPass> fPasses;
+    mutable G4Mutex fMutex = G4MUTEX_INITIALIZER;
+};
+
+#endif
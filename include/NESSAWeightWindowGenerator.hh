@@ -0,0 +1,113 @@
+#ifndef NESSAWeightWindowGenerator_h
+#define NESSAWeightWindowGenerator_h 1
+
+#include "G4VAccumulable.hh"
+#include "G4Types.hh"
+#include "NESSAWeightWindowMesh.hh"
+#include <memory>
+#include <vector>
+
+class G4Step;
+class G4ParticleDefinition;
+struct WeightWindowEstimates;
+struct WeightWindowPass;
+
+/// Forward-run weight-window generator (as the MCNP WWG): estimates the
+/// importance of every mesh voxel and energy group for the flux in the
+/// target detectors, and turns it into weight windows for the next pass.
+///
+/// Each time a neutron or photon enters a bin (crosses into a voxel,
+/// changes group in a collision or is born there), its weight w is
+/// recorded with the time of entry. At the end of the history every entry
+/// is credited with the target score made after it by the track and by
+/// all of its progeny, and
+///   importance I = credited score / entering weight
+/// is summed per bin. The estimate does not depend on the windows of the
+/// pass, so passes made with earlier windows are summed. The windows are
+///   wl = 2/(1 + WUPN) * Isrc / I
+/// with Isrc the score per unit source weight, which puts the unit source
+/// weight in the middle of the window at the source; bins with fewer
+/// than the minimum number of scoring entries get no window (wl = 0).
+///
+/// Per thread; merged as an accumulable, turned into windows on the
+/// master at the end of each run (Update).
+class NESSAWeightWindowGenerator : public G4VAccumulable
+{
+public:
+    explicit NESSAWeightWindowGenerator(const G4String& name = "weightWindowGenerator");
+    ~NESSAWeightWindowGenerator() override = default;
+    
+    /// Take the generator mesh and targets of NESSAWeightWindowConfig for
+    /// the next run and clear the sums; false (and no generation) when
+    /// the mesh or targets are missing
+    G4bool SetUp();
+    G4bool IsEmpty() const { return !fMesh; }
+    G4int GetNTargets() const { return fNTargets; }
+    
+    /// Record entries and target scores of a step (before the step's
+    /// splitting and roulette)
+    void RecordStep(const G4Step* step);
+    /// Credit this history's entries
+    void EndOfHistory();
+    
+    void Merge(const G4VAccumulable& other) override;
+    void Reset() override;
+    
+    /// Add this run's sums (merged) to the estimates, make the windows,
+    /// write them to file and load them for the next run; returns the
+    /// pass record (master)
+    WeightWindowPass Update(WeightWindowEstimates& estimates, G4double upperRatio,
+                            G4int minHits, G4int nEvents, G4double seconds,
+                            const G4String& file) const;
+    
+    /// Windows from summed estimates on the layout of mesh
+    static std::shared_ptr<NESSAWeightWindowMesh> MakeWindows(
+        const NESSAWeightWindowMesh& mesh, const WeightWindowEstimates& estimates,
+        G4double upperRatio, G4int minHits);
+    
+private:
+    /// Entry of a track into a bin
+    struct Entry {
+        G4double time;
+        G4double weight;
+        G4long   bin;       // LowerIndex in the mesh
+        G4int    particle;
+    };
+    /// A score (own, or the total of a daughter's subtree at its birth)
+    struct Score {
+        G4double time;
+        G4double value;
+        bool operator<(const Score& o) const { return time < o.time; }
+    };
+    /// Per-track record of the current history, indexed by track ID
+    struct TrackRecord {
+        G4int    parent = 0;
+        G4double birth = 0.;
+        G4long   lastBin = -1;
+        G4bool   used = false;
+        G4bool   scored = false;
+        std::vector<Entry> entries;
+        std::vector<Score> scores;
+    };
+    
+    /// Bin of a point [mm] and energy [MeV], -1 outside the mesh
+    G4long Bin(const G4ThreeVector& x, G4int particle, G4double e) const;
+    
+    const G4ParticleDefinition* fNeutron;
+    const G4ParticleDefinition* fGamma;
+    std::shared_ptr<const NESSAWeightWindowMesh> fMesh;
+    std::vector<G4double> fTargetByLV;  // LV instance ID -> 1/volume [1/cm3], 0 = not a target
+    G4int fNTargets = 0;
+    G4int fTargetParticle = 2;
+    std::vector<TrackRecord> fTracks;   // this history
+    G4int fMaxTrackID = 0;
+    G4double fHistoryScore = 0.;
+    
+    // Sums over the run
+    std::vector<G4double> fScore[2], fWeight[2], fHits[2];
+    G4double fSourceScore = 0., fSourceWeight = 0.;
+    G4double fPopulation = 0.;           // tracks that scored in a target
+    G4double fSum1 = 0., fSum2 = 0.;     // target score per history
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef NESSAWeightWindowMesh_h
+#define NESSAWeightWindowMesh_h 1
+
+#include "G4String.hh"
+#include "G4Types.hh"
+#include "G4ThreeVector.hh"
+#include <cstdint>
+#include <vector>
+
+/// Weight-window lower bounds on a Cartesian (x, y, z) or cylindrical
+/// (r, z, theta) mesh, per particle (0 = neutron, 1 = photon) and energy
+/// group. Read once on the master and shared read-only by the threads.
+///
+/// Two file formats:
+///   MCNP wwinp   (text, as written by the MCNP weight-window generator;
+///                 time-independent, rectangular or cylindrical)
+///   NESSA binary (below), written by the generators of this program
+/// Read() tells them apart by the magic; Write() picks the format from
+/// the extension (.bin = binary, anything else = wwinp).
+///
+/// Binary layout, little-endian:
+///   WeightWindowFileHeader
+///   double edges[n[k] + 1] for k = 0, 1, 2       [cm]; theta in revolutions
+///   per particle with nEnergy > 0:
+///     double energies[nEnergy]                   group upper bounds [MeV]
+///     double lower[nEnergy][n[2]][n[1]][n[0]]    lower bounds, 0 = no window
+class NESSAWeightWindowMesh
+{
+public:
+    enum Geometry { kCartesian = 1, kCylindrical = 2 };
+    
+    Geometry geometry = kCartesian;
+    G4double origin[3] = {0., 0., 0.};  // [cm]; cylinder: bottom centre
+    G4double axis[3] = {0., 0., 1.};    // cylinder axis (unit)
+    G4double vec[3] = {1., 0., 0.};     // theta = 0 direction (unit, normal to axis)
+    std::vector<G4double> edges[3];     // [cm], x y z or r z theta (revolutions)
+    std::vector<G4double> energies[2];  // group upper bounds [MeV]; empty = none
+    std::vector<G4double> lower[2];     // lower bounds, LowerIndex order
+    
+    G4int NBins(G4int k) const { return (G4int)edges[k].size() - 1; }
+    G4long NVoxels() const { return (G4long)NBins(0) * NBins(1) * NBins(2); }
+    G4bool HasWindows(G4int particle) const { return !energies[particle].empty(); }
+    
+    /// Voxel of a point [mm], -1 outside the mesh
+    G4long Voxel(const G4ThreeVector& x) const;
+    /// Group of energy e [MeV]: the first upper bound >= e (the last
+    /// group above the last bound)
+    G4int EnergyGroup(G4int particle, G4double e) const;
+    G4long LowerIndex(G4long voxel, G4int group) const { return group * NVoxels() + voxel; }
+    G4double Lower(G4int particle, G4long voxel, G4int group) const {
+        return lower[particle][LowerIndex(voxel, group)];
+    }
+    
+    /// Centre of a voxel, global Cartesian coordinates [cm]
+    G4ThreeVector VoxelCentre(G4long voxel) const;
+    
+    /// Check sizes and normalise the directions; false with a message
+    G4bool Validate(G4String& error);
+    
+    G4bool Read(const G4String& file, G4String& error);
+    G4bool Write(const G4String& file, G4String& error) const;
+    
+private:
+    G4bool ReadWWINP(std::istream& in, G4String& error);
+    G4bool ReadBinary(std::istream& in, G4String& error);
+    G4bool WriteWWINP(std::ostream& out) const;
+    G4bool WriteBinary(std::ostream& out) const;
+};
+
+struct WeightWindowFileHeader {
+    char    magic[8];       // "NESSAWWB"
+    int32_t version;        // kWeightWindowFileVersion
+    int32_t geometry;       // 1 = Cartesian, 2 = cylindrical
+    int32_t n[3];           // bins per axis
+    int32_t nEnergy[2];     // energy groups of n and gamma, 0 = no windows
+    int32_t pad;
+    double  origin[3], axis[3], vec[3];  // [cm]
+};
+
+static_assert(sizeof(WeightWindowFileHeader) == 112, "WeightWindowFileHeader layout");
+
+const int32_t kWeightWindowFileVersion = 1;
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef NESSAWeightWindowMessenger_h
+#define NESSAWeightWindowMessenger_h 1
+
+#include "G4UImessenger.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIdirectory.hh"
+
+/// Macro commands for the mesh weight windows (NESSAWeightWindow):
+///   /nessa/ww/read file          MCNP wwinp or NESSA binary
+///   /nessa/ww/write file         .bin = binary, otherwise wwinp
+///   /nessa/ww/bounds wupn wsurvn mxspln
+///   /nessa/ww/scale factor
+///   /nessa/ww/off
+///   /nessa/ww/info
+/// and for the window generator (NESSAWeightWindowGenerator):
+///   /nessa/ww/gen/mesh x0 y0 z0 x1 y1 z1 nx ny nz
+///   /nessa/ww/gen/energies n|g e1 e2 ...
+///   /nessa/ww/gen/target name [name ...]
+///   /nessa/ww/gen/particle n|g|both
+///   /nessa/ww/gen/minHits n
+///   /nessa/ww/gen/file name
+///   /nessa/ww/gen/iterate passes events [tolerance]
+///   /nessa/ww/gen/reset
+///   /nessa/ww/gen/off
+/// Changes apply from the next run.
+class NESSAWeightWindowMessenger : public G4UImessenger
+{
+public:
+    NESSAWeightWindowMessenger();
+    ~NESSAWeightWindowMessenger() override;
+    void SetNewValue(G4UIcommand*, G4String) override;
+    
+private:
+    G4UIdirectory*           fWWDir;
+    G4UIcmdWithAString*      fReadCmd;
+    G4UIcmdWithAString*      fWriteCmd;
+    G4UIcmdWithAString*      fBoundsCmd;
+    G4UIcmdWithADouble*      fScaleCmd;
+    G4UIcmdWithoutParameter* fOffCmd;
+    G4UIcmdWithoutParameter* fInfoCmd;
+    
+    G4UIdirectory*           fGenDir;
+    G4UIcmdWithAString*      fGenMeshCmd;
+    G4UIcmdWithAString*      fGenEnergiesCmd;
+    G4UIcmdWithAString*      fGenTargetCmd;
+    G4UIcmdWithAString*      fGenParticleCmd;
+    G4UIcmdWithAnInteger*    fGenMinHitsCmd;
+    G4UIcmdWithAString*      fGenFileCmd;
+    G4UIcmdWithAString*      fGenIterateCmd;
+    G4UIcmdWithoutParameter* fGenResetCmd;
+    G4UIcmdWithoutParameter* fGenOffCmd;
+};
+
+#endif
@@ -2,6 +2,8 @@
 // NESSA Bunker Geant4 Simulation - Main Program
 // Converted from MCNP5: FREIA/NESSA facility, Uppsala University
 // Adelphi DT-110 neutron generator (14 MeV)
+//
+// Usage: nessa_sim [macro] [-t nThreads] [-m serial|mt|tasking]
 // ============================================================
 
 #include "G4RunManagerFactory.hh"
@@ -15,16 +17,65 @@
 #include "NESSADetectorConstruction.hh"
 #include "NESSAActionInitialization.hh"
 
+#include <cerrno>
+#include <cstdlib>
+
 int main(int argc, char** argv)
 {
+    // Parse command line: first non-option argument is the macro
+    G4String macro;
+    G4String mode;
+    G4int nThreads = 1;
+    const char* usage = "Usage: nessa_sim [macro] [-t nThreads] [-m serial|mt|tasking]";
+    for (G4int i = 1; i < argc; i++) {
+        G4String arg = argv[i];
+        if (arg == "-t" || arg == "-m") {
+            if (i + 1 >= argc) {
+                G4cerr << arg << " needs a value\n" << usage << G4endl;
+                return 1;
+            }
+            const char* value = argv[++i];
+            if (arg == "-m") {
+                mode = value;
+                continue;
+            }
+            char* end = nullptr;
+            errno = 0;
+            const long n = std::strtol(value, &end, 10);
+            if (end == value || *end != '\0' || errno == ERANGE || n < 1 || n > 4096) {
+                G4cerr << "Invalid thread count '" << value << "'\n" << usage << G4endl;
+                return 1;
+            }
+            nThreads = (G4int)n;
+        } else {
+            macro = arg;
+        }
+    }
+    
     G4UIExecutive* ui = nullptr;
-    if (argc == 1) {
+    if (macro.empty()) {
         ui = new G4UIExecutive(argc, argv);
     }
 
-    // Serial mode for stability with complex boolean geometry
-    auto* runManager = G4RunManagerFactory::CreateRunManager(
-        G4RunManagerType::Serial);
+    // Serial by default; -t N (N > 1) switches to tasking unless -m says
+    // otherwise. Geometry is shared read-only between worker threads,
+    // scoring and activation tallies are per-thread and merged by the master.
+    if (mode.empty()) mode = (nThreads > 1) ? "tasking" : "serial";
+    
+    auto type = G4RunManagerType::Serial;
+    if (mode == "mt")           type = G4RunManagerType::MT;
+    else if (mode == "tasking") type = G4RunManagerType::Tasking;
+    else if (mode != "serial") {
+        G4cerr << "Unknown run mode '" << mode
+               << "' (expected serial, mt or tasking), using serial" << G4endl;
+    }
+    
+    auto* runManager = G4RunManagerFactory::CreateRunManager(type);
+    if (type != G4RunManagerType::Serial) {
+        runManager->SetNumberOfThreads(nThreads);
+        G4cout << "Run mode: " << mode << " with " << nThreads
+               << " threads" << G4endl;
+    }
 
     // Detector
     runManager->SetUserInitialization(new NESSADetectorConstruction());
@@ -50,8 +101,7 @@ int main(int argc, char** argv)
 
     if (!ui) {
         G4String command = "/control/execute ";
-        G4String fileName = argv[1];
-        UImanager->ApplyCommand(command + fileName);
+        UImanager->ApplyCommand(command + macro);
     } else {
         UImanager->ApplyCommand("/control/execute macros/init_vis.mac");
         ui->SessionStart();
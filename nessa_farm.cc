@@ -0,0 +1,163 @@
+// ============================================================
+// nessa_farm - run one NESSA job as N independent local processes
+// Usage: nessa_farm -n N -e events [-s seed] [-d dir] [-t threads]
+//                   [-x nessa_sim] [--no-merge] [setup.mac]
+//
+// Process i gets a contiguous slice of the event numbers, its own output
+// file <dir>/nessa_output_p<i>.root and per-event seeding from the common
+// seed (/nessa/run/eventSeed + eventOffset), so the merged result has the
+// same per-event histories as one serial run with that seed. setup.mac
+// (default macros/detectors.mac) must configure but not run beamOn.
+// When all processes finish, nessa_merge combines the outputs into
+// <dir>/nessa_output.root.
+// ============================================================
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string SiblingPath(const char* argv0, const std::string& exe)
+{
+    std::string self = argv0;
+    auto slash = self.rfind('/');
+    if (slash == std::string::npos) return "./" + exe;
+    return self.substr(0, slash + 1) + exe;
+}
+
+/// fork/exec with stdout+stderr redirected to logFile (empty = inherit)
+pid_t Launch(const std::vector<std::string>& args, const std::string& logFile)
+{
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    if (!logFile.empty()) {
+        int fd = open(logFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+    }
+    std::vector<char*> cargs;
+    for (const auto& a : args) cargs.push_back(const_cast<char*>(a.c_str()));
+    cargs.push_back(nullptr);
+    execv(cargs[0], cargs.data());
+    std::perror(cargs[0]);
+    _exit(127);
+}
+
+void Usage()
+{
+    std::cerr
+        << "Usage: nessa_farm -n N -e events [options] [setup.mac]\n"
+        << "  -n N        number of processes\n"
+        << "  -e events   total number of events (split across processes)\n"
+        << "  -s seed     event seed, 1..2147483647 (default 12345)\n"
+        << "  -d dir      output directory (default farm)\n"
+        << "  -t threads  threads per process (default 1)\n"
+        << "  -x path     nessa_sim executable (default: next to nessa_farm)\n"
+        << "  --no-merge  do not run nessa_merge at the end\n"
+        << "  setup.mac   configuration macro without beamOn"
+        << " (default macros/detectors.mac)\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    int nProc = 0;
+    long long nEvents = 0;
+    long seed = 12345;
+    int nThreads = 1;
+    bool merge = true;
+    std::string outDir = "farm";
+    std::string setup = "macros/detectors.mac";
+    std::string sim = SiblingPath(argv[0], "nessa_sim");
+    std::string merger = SiblingPath(argv[0], "nessa_merge");
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc)      nProc = std::atoi(argv[++i]);
+        else if (arg == "-e" && i + 1 < argc) nEvents = std::atoll(argv[++i]);
+        else if (arg == "-s" && i + 1 < argc) seed = std::atol(argv[++i]);
+        else if (arg == "-d" && i + 1 < argc) outDir = argv[++i];
+        else if (arg == "-t" && i + 1 < argc) nThreads = std::atoi(argv[++i]);
+        else if (arg == "-x" && i + 1 < argc) sim = argv[++i];
+        else if (arg == "--no-merge")         merge = false;
+        else if (arg == "-h" || arg == "--help") { Usage(); return 0; }
+        else setup = arg;
+    }
+    if (nProc < 1 || nEvents < nProc || seed < 1 || seed > 0x7FFFFFFF) {
+        Usage();
+        return 1;
+    }
+
+    mkdir(outDir.c_str(), 0755);
+
+    // ---- Write one macro per process and launch ----
+    std::vector<pid_t> pids(nProc);
+    std::vector<std::string> outputs(nProc);
+    long long first = 0;
+    for (int i = 0; i < nProc; i++) {
+        long long n = nEvents / nProc + (i < nEvents % nProc ? 1 : 0);
+        std::string tag = "p" + std::to_string(i);
+        std::string mac = outDir + "/" + tag + ".mac";
+        outputs[i] = outDir + "/nessa_output_" + tag + ".root";
+
+        std::ofstream m(mac);
+        m << "# nessa_farm process " << i << " of " << nProc << "\n"
+          << "/control/verbose 0\n"
+          << "/run/verbose 1\n"
+          << "/event/verbose 0\n"
+          << "/tracking/verbose 0\n"
+          << "/nessa/run/eventSeed " << seed << "\n"
+          << "/nessa/run/eventOffset " << first << "\n"
+          << "/analysis/setFileName " << outputs[i] << "\n"
+          << "/control/execute " << setup << "\n"
+          << "/run/beamOn " << n << "\n";
+        m.close();
+        first += n;
+
+        std::vector<std::string> args = {sim, mac};
+        if (nThreads > 1) {
+            args.push_back("-t");
+            args.push_back(std::to_string(nThreads));
+        }
+        pids[i] = Launch(args, outDir + "/" + tag + ".log");
+        std::cout << "Started " << tag << " (pid " << pids[i] << ", "
+                  << n << " events)" << std::endl;
+    }
+
+    // ---- Wait for all ----
+    int nFailed = 0;
+    for (int i = 0; i < nProc; i++) {
+        int status = 0;
+        waitpid(pids[i], &status, 0);
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!ok) nFailed++;
+        std::cout << "p" << i << (ok ? " done" : " FAILED (see log)") << std::endl;
+    }
+    if (nFailed > 0) {
+        std::cerr << nFailed << " of " << nProc
+                  << " processes failed, not merging" << std::endl;
+        return 1;
+    }
+    if (!merge) return 0;
+
+    // ---- Merge ----
+    std::vector<std::string> args = {merger, "-o", outDir + "/nessa_output.root"};
+    args.insert(args.end(), outputs.begin(), outputs.end());
+    int status = 0;
+    waitpid(Launch(args, ""), &status, 0);
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
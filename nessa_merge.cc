@@ -0,0 +1,253 @@
+// ============================================================
+// nessa_merge - combine independent NESSA runs
+// Usage: nessa_merge [-n] -o merged.root run1.root run2.root ...
+//
+// - Sums all n_spec_*/n_dose_*/g_spec_*/g_dose_* histograms and the
+//   n_surf_*/g_surf_* surface crossing histograms
+// - Sums per-history tally moments (exact combined uncertainties)
+// - Sums activation tables and re-prints the activation report
+// - With -n, also concatenates the scoring/activation ntuples
+// Each input needs its <name>_summary.dat written by nessa_sim.
+// ============================================================
+
+#include "NESSARunSummary.hh"
+#include "NESSARunAction.hh"
+#include "NESSARunConfig.hh"
+
+#include "G4AnalysisManager.hh"
+#include "G4RootAnalysisReader.hh"
+#include "G4ios.hh"
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+namespace {
+
+/// Column layout of an ntuple copied from the inputs to the output
+struct NtupleSchema {
+    G4String name;
+    G4String title;
+    std::vector<std::pair<G4String, char>> columns;  // name, 'I'/'D'/'S'
+};
+
+const std::vector<NtupleSchema>& Schemas()
+{
+    // Must match the booking in NESSARunAction
+    static const std::vector<NtupleSchema> schemas = {
+        {"scoring", "Point detector data",
+         {{"detID", 'I'}, {"energy_MeV", 'D'}, {"edep_MeV", 'D'},
+          {"trackLen_cm", 'D'}, {"particle", 'I'}, {"rowWeight", 'D'}}},
+        {"activation", "Radioactive isotope production",
+         {{"Z", 'I'}, {"A", 'I'}, {"isomer", 'I'}, {"x_cm", 'D'}, {"y_cm", 'D'},
+          {"z_cm", 'D'}, {"neutronE_MeV", 'D'}, {"weight", 'D'},
+          {"volume", 'S'}, {"process", 'S'}, {"halfLife_s", 'D'}}}
+    };
+    return schemas;
+}
+
+/// Copy all rows of one ntuple from an input file into output ntuple outId
+G4long CopyNtuple(G4RootAnalysisReader* reader, const G4String& file,
+                  const NtupleSchema& schema, G4int outId)
+{
+    G4int inId = reader->GetNtuple(schema.name, file);
+    if (inId < 0) return 0;
+
+    const auto nCol = schema.columns.size();
+    std::vector<G4int>    ivals(nCol);
+    std::vector<G4double> dvals(nCol);
+    std::vector<G4String> svals(nCol);
+    for (size_t c = 0; c < nCol; c++) {
+        const auto& [name, type] = schema.columns[c];
+        if (type == 'I')      reader->SetNtupleIColumn(inId, name, ivals[c]);
+        else if (type == 'D') reader->SetNtupleDColumn(inId, name, dvals[c]);
+        else                  reader->SetNtupleSColumn(inId, name, svals[c]);
+    }
+
+    auto am = G4AnalysisManager::Instance();
+    G4long nRows = 0;
+    while (reader->GetNtupleRow(inId)) {
+        for (size_t c = 0; c < nCol; c++) {
+            char type = schema.columns[c].second;
+            if (type == 'I')      am->FillNtupleIColumn(outId, c, ivals[c]);
+            else if (type == 'D') am->FillNtupleDColumn(outId, c, dvals[c]);
+            else                  am->FillNtupleSColumn(outId, c, svals[c]);
+        }
+        am->AddNtupleRow(outId);
+        nRows++;
+    }
+    return nRows;
+}
+
+void Usage()
+{
+    G4cerr << "Usage: nessa_merge [-n] -o merged.root run1.root run2.root ...\n"
+           << "  -o file   merged output (default nessa_merged.root)\n"
+           << "  -n        also copy the scoring and activation ntuples"
+           << G4endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    G4String outFile = "nessa_merged.root";
+    G4bool copyNtuples = false;
+    std::vector<G4String> inputs;
+
+    for (G4int i = 1; i < argc; i++) {
+        G4String arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) outFile = argv[++i];
+        else if (arg == "-n") copyNtuples = true;
+        else if (arg == "-h" || arg == "--help") { Usage(); return 0; }
+        else inputs.push_back(arg);
+    }
+    if (inputs.empty()) { Usage(); return 1; }
+
+    // ---- Summaries: events, tally moments, activation tables ----
+    NESSARunSummary merged;
+    for (const auto& in : inputs) {
+        NESSARunSummary s;
+        if (!s.Read(NESSARunSummary::FileNameFor(in))) return 1;
+        merged.Add(s);
+        G4cout << "Read " << in << ": " << (G4long)s.nEvents << " events" << G4endl;
+    }
+
+    // ---- Histograms: book from the first file, add all inputs ----
+    auto reader = G4RootAnalysisReader::Instance();
+    auto am = G4AnalysisManager::Instance();
+    am->SetVerboseLevel(0);
+    am->SetFileName(outFile);
+
+    std::vector<G4String> hNames;
+    std::set<G4String> seen;
+    for (G4int part = 0; part < 2; part++) {
+        for (const auto& t : merged.tallies) {
+            if (t.particle != part || !seen.insert(t.name + char('0' + part)).second)
+                continue;
+            G4String pre = (part == 0) ? "n_" : "g_";
+            hNames.push_back(pre + "spec_" + t.name);
+            hNames.push_back(pre + "dose_" + t.name);
+        }
+    }
+
+    // Surface crossing histograms (energy x cosine), from the currents
+    std::vector<G4String> h2Names;
+    for (const auto& t : merged.tallies) {
+        if (t.particle != 10 && t.particle != 11) continue;
+        h2Names.push_back((t.particle == 10 ? "n_surf_" : "g_surf_") + t.name);
+    }
+
+    std::map<G4String, G4int> outIds;
+    std::map<G4String, std::vector<tools::histo::h1d*>> parts;
+    for (const auto& in : inputs) {
+        for (const auto& name : hNames) {
+            G4int id = reader->ReadH1(name, in);
+            if (id < 0) continue;
+            auto* h = reader->GetH1(id);
+            if (!h) continue;
+            parts[name].push_back(h);
+            if (outIds.count(name)) continue;
+
+            const auto& axis = h->axis();
+            if (axis.is_fixed_binning()) {
+                outIds[name] = am->CreateH1(name, h->title(), axis.bins(),
+                    axis.lower_edge(), axis.upper_edge());
+            } else {
+                outIds[name] = am->CreateH1(name, h->title(), axis.edges());
+            }
+        }
+    }
+
+    std::map<G4String, G4int> outIds2;
+    std::map<G4String, std::vector<tools::histo::h2d*>> parts2;
+    auto edges = [](const tools::histo::axis<G4double, unsigned int>& axis) {
+        if (!axis.is_fixed_binning()) return axis.edges();
+        std::vector<G4double> e;
+        for (unsigned int b = 0; b <= axis.bins(); b++)
+            e.push_back(b < axis.bins() ? axis.bin_lower_edge(b) : axis.upper_edge());
+        return e;
+    };
+    for (const auto& in : inputs) {
+        for (const auto& name : h2Names) {
+            G4int id = reader->ReadH2(name, in);
+            if (id < 0) continue;
+            auto* h = reader->GetH2(id);
+            if (!h) continue;
+            parts2[name].push_back(h);
+            if (outIds2.count(name)) continue;
+            outIds2[name] = am->CreateH2(name, h->title(), edges(h->axis_x()),
+                                         edges(h->axis_y()));
+        }
+    }
+
+    // ---- Ntuples (optional, can be large) ----
+    std::vector<G4int> ntOut;
+    if (copyNtuples) {
+        for (const auto& schema : Schemas()) {
+            G4int id = am->CreateNtuple(schema.name, schema.title);
+            for (const auto& [name, type] : schema.columns) {
+                if (type == 'I')      am->CreateNtupleIColumn(name);
+                else if (type == 'D') am->CreateNtupleDColumn(name);
+                else                  am->CreateNtupleSColumn(name);
+            }
+            am->FinishNtuple();
+            ntOut.push_back(id);
+        }
+    }
+
+    am->OpenFile();
+    for (const auto& [name, hs] : parts) {
+        auto* out = am->GetH1(outIds[name]);
+        for (const auto* h : hs) {
+            if (!out->add(*h)) {
+                G4cerr << "WARNING: binning mismatch, skipped part of " << name
+                       << G4endl;
+            }
+        }
+    }
+    for (const auto& [name, hs] : parts2) {
+        auto* out = am->GetH2(outIds2[name]);
+        for (const auto* h : hs) {
+            if (!out->add(*h)) {
+                G4cerr << "WARNING: binning mismatch, skipped part of " << name
+                       << G4endl;
+            }
+        }
+    }
+    if (copyNtuples) {
+        for (size_t k = 0; k < Schemas().size(); k++) {
+            G4long nRows = 0;
+            for (const auto& in : inputs)
+                nRows += CopyNtuple(reader, in, Schemas()[k], ntOut[k]);
+            G4cout << "Ntuple " << Schemas()[k].name << ": " << nRows
+                   << " rows" << G4endl;
+        }
+    }
+    am->Write();
+    am->CloseFile();
+
+    G4String summaryFile = NESSARunSummary::FileNameFor(outFile);
+    merged.Write(summaryFile);
+
+    // ---- Report for the combined run ----
+    G4cout << "\n" << G4String(72, '=') << G4endl;
+    G4cout << "  NESSA Merged Summary (" << inputs.size() << " runs)" << G4endl;
+    G4cout << G4String(72, '=') << G4endl;
+    G4cout << "  Events processed:  " << (G4long)merged.nEvents << G4endl;
+    G4cout << "  Histograms merged: " << outIds.size() + outIds2.size() << G4endl;
+    G4cout << "  Output file:       " << outFile << G4endl;
+    G4cout << "  Run summary:       " << summaryFile << G4endl;
+
+    merged.PrintTallies();
+    if (merged.nEvents > 0) {
+        NESSARunAction::PrintActivationReport(merged.globalProd,
+            merged.volumeProd, merged.nEvents,
+            merged.sourceRate > 0 ? merged.sourceRate
+                                  : NESSARunConfig::Instance().GetSourceRate());
+    }
+    G4cout << G4String(72, '=') << G4endl;
+
+    return 0;
+}
@@ -0,0 +1,243 @@
+// ============================================================
+// nessa_mesh - read binary mesh tally files (<output>_mesh_<name>.bin)
+// Usage: nessa_mesh info  file.bin
+//        nessa_mesh slice file.bin x|y|z index [ie]
+//        nessa_mesh sum   out.bin in1.bin in2.bin ...
+//
+// Files are memory-mapped: a slice reads only the tiles it crosses, so
+// slices of multi-GB meshes are immediate. "slice" prints one line per
+// voxel of the plane with a score: the two in-plane voxel indices and
+// centres [cm], the mean per source particle and its relative error.
+// "sum" adds independent runs (farm processes): sums and event counts.
+// Layout: include/NESSAMeshFile.hh. POSIX only, no Geant4 dependency.
+// ============================================================
+
+#include "NESSAMeshFile.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Read-only memory map of one mesh file
+class MappedMesh {
+public:
+    MappedMesh() = default;
+    MappedMesh(const MappedMesh&) = delete;
+    ~MappedMesh() { if (fData) munmap(fData, fSize); }
+
+    bool Open(const std::string& file)
+    {
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) { std::perror(file.c_str()); return false; }
+        struct stat st;
+        if (fstat(fd, &st) == 0) fSize = st.st_size;
+        if (fSize >= sizeof(MeshFileHeader))
+            fData = mmap(nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (!fData || fData == MAP_FAILED) {
+            fData = nullptr;
+            std::cerr << file << ": cannot map" << std::endl;
+            return false;
+        }
+
+        const auto& h = Header();
+        if (std::memcmp(h.magic, "NESSAMSH", 8) != 0 || h.version != kMeshFileVersion ||
+            Offset() > fSize) {
+            std::cerr << file << ": not a NESSA mesh file (version "
+                      << kMeshFileVersion << ")" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    const MeshFileHeader& Header() const { return *static_cast<const MeshFileHeader*>(fData); }
+    const double* Edges() const {
+        return reinterpret_cast<const double*>(static_cast<const char*>(fData)
+                                               + sizeof(MeshFileHeader));
+    }
+    const int64_t* Index() const {
+        return reinterpret_cast<const int64_t*>(Edges() + Header().nEnergy + 1);
+    }
+    /// Sums of a stored tile (s1 then s2), nullptr if the tile is empty
+    const double* Tile(int64_t tile) const {
+        int64_t offset = Index()[tile];
+        if (offset < 0) return nullptr;
+        return reinterpret_cast<const double*>(static_cast<const char*>(fData) + offset);
+    }
+
+    /// Tile and bin within the tile of voxel (ix, iy, iz), energy bin ie
+    void Locate(int ix, int iy, int iz, int ie, int64_t& tile, int64_t& bin) const
+    {
+        const auto& h = Header();
+        const int* s = h.tileShift;
+        tile = (ix >> s[0]) + h.NTiles(0) * ((iy >> s[1]) + h.NTiles(1) * (iz >> s[2]));
+        bin = ((int64_t)(ix & ((1 << s[0]) - 1)) + ((iy & ((1 << s[1]) - 1)) << s[0])
+               + ((iz & ((1 << s[2]) - 1)) << (s[0] + s[1]))) * h.nEnergy + ie;
+    }
+
+private:
+    size_t Offset() const {
+        const auto& h = Header();
+        return sizeof(MeshFileHeader) + (h.nEnergy + 1) * sizeof(double)
+             + h.nTiles * sizeof(int64_t);
+    }
+
+    void*  fData = nullptr;
+    size_t fSize = 0;
+};
+
+void Usage()
+{
+    std::cerr << "Usage: nessa_mesh info  file.bin\n"
+              << "       nessa_mesh slice file.bin x|y|z index [ie]\n"
+              << "       nessa_mesh sum   out.bin in1.bin in2.bin ..." << std::endl;
+}
+
+int Info(const MappedMesh& mesh)
+{
+    const auto& h = mesh.Header();
+    const char* axes = "xyz";
+    std::cout << (h.particle == 0 ? "neutron " : "photon ")
+              << (h.dose ? "dose [pSv]" : "fluence [1/cm2]")
+              << " per source particle, " << h.nEvents << " events\n";
+    for (int k = 0; k < 3; k++) {
+        std::cout << "  " << axes[k] << ": " << h.lo[k] << " .. " << h.hi[k]
+                  << " cm, " << h.n[k] << " voxels\n";
+    }
+    std::cout << "  energy: " << h.nEnergy << " bins, " << mesh.Edges()[0]
+              << " .. " << mesh.Edges()[h.nEnergy] << " MeV\n"
+              << "  tiles: " << h.nStored << "/" << h.nTiles << " stored ("
+              << (1 << h.tileShift[0]) << "x" << (1 << h.tileShift[1]) << "x"
+              << (1 << h.tileShift[2]) << " voxels)" << std::endl;
+    return 0;
+}
+
+int Slice(const MappedMesh& mesh, char axis, int index, int ie)
+{
+    const auto& h = mesh.Header();
+    int k = axis - 'x';
+    if (k < 0 || k > 2 || index < 0 || index >= h.n[k] || ie < 0 || ie >= h.nEnergy) {
+        std::cerr << "Slice out of range" << std::endl;
+        return 1;
+    }
+    int u = (k == 0) ? 1 : 0, v = (k == 2) ? 1 : 2;  // in-plane axes
+    double width[3];
+    for (int a = 0; a < 3; a++) width[a] = (h.hi[a] - h.lo[a]) / h.n[a];
+
+    std::printf("# %c = %g cm, energy bin %d (%g - %g MeV)\n", axis,
+                h.lo[k] + (index + 0.5) * width[k], ie, mesh.Edges()[ie], mesh.Edges()[ie + 1]);
+    std::printf("# i%c i%c %c_cm %c_cm mean relErr\n", 'x' + u, 'x' + v, 'x' + u, 'x' + v);
+    int i[3];
+    i[k] = index;
+    for (i[v] = 0; i[v] < h.n[v]; i[v]++) {
+        for (i[u] = 0; i[u] < h.n[u]; i[u]++) {
+            int64_t tile, bin;
+            mesh.Locate(i[0], i[1], i[2], ie, tile, bin);
+            const double* t = mesh.Tile(tile);
+            if (!t || t[bin] == 0.) continue;
+            double s1 = t[bin];
+            double s2 = t[h.TileBins() + bin];
+            // As NESSATallyStats::MeanAndError: R = sqrt(s2/s1^2 - 1/N)
+            double r2 = s2 / (s1 * s1) - 1. / h.nEvents;
+            std::printf("%d %d %.4g %.4g %.6e %.4f\n", i[u], i[v],
+                        h.lo[u] + (i[u] + 0.5) * width[u], h.lo[v] + (i[v] + 0.5) * width[v],
+                        s1 / h.nEvents, r2 > 0. ? std::sqrt(r2) : 0.);
+        }
+    }
+    return 0;
+}
+
+int Sum(const std::string& outFile, const std::vector<std::string>& inputs)
+{
+    std::vector<MappedMesh> meshes(inputs.size());
+    for (size_t f = 0; f < inputs.size(); f++) {
+        if (!meshes[f].Open(inputs[f])) return 1;
+    }
+    MeshFileHeader header = meshes[0].Header();
+    for (size_t f = 1; f < inputs.size(); f++) {
+        const auto& h = meshes[f].Header();
+        bool same = h.particle == header.particle && h.dose == header.dose &&
+                    h.nEnergy == header.nEnergy;
+        for (int k = 0; k < 3; k++) {
+            same = same && h.n[k] == header.n[k] && h.lo[k] == header.lo[k] &&
+                   h.hi[k] == header.hi[k] && h.tileShift[k] == header.tileShift[k];
+        }
+        if (!same) {
+            std::cerr << inputs[f] << ": different mesh than " << inputs[0] << std::endl;
+            return 1;
+        }
+        header.nEvents += h.nEvents;
+    }
+
+    // A tile is stored if any input has it
+    const int64_t tileBins = header.TileBins();
+    std::vector<int64_t> index(header.nTiles, -1);
+    int64_t offset = sizeof(MeshFileHeader) + (header.nEnergy + 1) * sizeof(double)
+                   + header.nTiles * sizeof(int64_t);
+    header.nStored = 0;
+    for (int64_t t = 0; t < header.nTiles; t++) {
+        for (const auto& m : meshes) {
+            if (!m.Tile(t)) continue;
+            index[t] = offset;
+            offset += 2 * tileBins * sizeof(double);
+            header.nStored++;
+            break;
+        }
+    }
+
+    std::ofstream out(outFile, std::ios::binary);
+    if (!out.is_open()) { std::perror(outFile.c_str()); return 1; }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(meshes[0].Edges()),
+              (header.nEnergy + 1) * sizeof(double));
+    out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(int64_t));
+    std::vector<double> sums(2 * tileBins);
+    for (int64_t t = 0; t < header.nTiles; t++) {
+        if (index[t] < 0) continue;
+        std::fill(sums.begin(), sums.end(), 0.);
+        for (const auto& m : meshes) {
+            const double* tile = m.Tile(t);
+            if (!tile) continue;
+            for (int64_t b = 0; b < 2 * tileBins; b++) sums[b] += tile[b];
+        }
+        out.write(reinterpret_cast<const char*>(sums.data()), sums.size() * sizeof(double));
+    }
+    std::cout << "Summed " << inputs.size() << " files (" << header.nEvents
+              << " events) -> " << outFile << std::endl;
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) { Usage(); return 1; }
+    std::string mode = argv[1];
+
+    if (mode == "sum" && argc >= 4) {
+        return Sum(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+    }
+
+    MappedMesh mesh;
+    if (mode == "info") {
+        return mesh.Open(argv[2]) ? Info(mesh) : 1;
+    }
+    if (mode == "slice" && argc >= 5) {
+        if (!mesh.Open(argv[2])) return 1;
+        return Slice(mesh, argv[3][0], std::atoi(argv[4]), argc > 5 ? std::atoi(argv[5]) : 0);
+    }
+    Usage();
+    return 1;
+}
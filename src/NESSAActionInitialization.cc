@@ -2,6 +2,34 @@
 #include "NESSAPrimaryGeneratorAction.hh"
 #include "NESSARunAction.hh"
 #include "NESSASteppingAction.hh"
+#include "NESSAEventAction.hh"
+#include "NESSARunMessenger.hh"
+#include "NESSAMeshMessenger.hh"
+#include "NESSASurfaceMessenger.hh"
+#include "NESSACellMessenger.hh"
+#include "NESSAWeightWindowMessenger.hh"
+#include "NESSAAdjointMessenger.hh"
+#include "NESSASourceMessenger.hh"
+
+NESSAActionInitialization::NESSAActionInitialization()
+    : fRunMessenger(new NESSARunMessenger()),
+      fMeshMessenger(new NESSAMeshMessenger()),
+      fSurfaceMessenger(new NESSASurfaceMessenger()),
+      fCellMessenger(new NESSACellMessenger()),
+      fWeightWindowMessenger(new NESSAWeightWindowMessenger()),
+      fAdjointMessenger(new NESSAAdjointMessenger()),
+      fSourceMessenger(new NESSASourceMessenger()) {}
+
+NESSAActionInitialization::~NESSAActionInitialization()
+{
+    delete fRunMessenger;
+    delete fMeshMessenger;
+    delete fSurfaceMessenger;
+    delete fCellMessenger;
+    delete fWeightWindowMessenger;
+    delete fAdjointMessenger;
+    delete fSourceMessenger;
+}
 
 void NESSAActionInitialization::BuildForMaster() const
 {
@@ -13,5 +41,7 @@ void NESSAActionInitialization::Build() const
     SetUserAction(new NESSAPrimaryGeneratorAction());
     auto* stepping = new NESSASteppingAction();
     SetUserAction(stepping);
-    SetUserAction(new NESSARunAction(stepping));
+    auto* run = new NESSARunAction(stepping);
+    SetUserAction(run);
+    SetUserAction(new NESSAEventAction(run, stepping));
 }
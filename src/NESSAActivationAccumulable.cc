@@ -0,0 +1,31 @@
+#include "NESSAActivationAccumulable.hh"
+
+void NESSAActivationAccumulable::Merge(const G4VAccumulable& other)
+{
+    const auto& o = static_cast<const NESSAActivationAccumulable&>(other);
+    Add(o.fGlobalProd, o.fVolumeProd);
+}
+
+void NESSAActivationAccumulable::Reset()
+{
+    fGlobalProd.clear();
+    fVolumeProd.clear();
+}
+
+void NESSAActivationAccumulable::Add(const IsotopeMap& global,
+                                     const VolumeIsotopeMap& volumes)
+{
+    AddRecords(fGlobalProd, global);
+    for (const auto& [vol, isomap] : volumes) {
+        AddRecords(fVolumeProd[vol], isomap);
+    }
+}
+
+void NESSAActivationAccumulable::AddRecords(IsotopeMap& into, const IsotopeMap& from)
+{
+    for (const auto& [id, rec] : from) {
+        auto& r = into[id];
+        r.count += rec.count;
+        if (rec.halfLife_s > 0) r.halfLife_s = rec.halfLife_s;
+    }
+}
@@ -0,0 +1,149 @@
+#include "NESSAAdjointMessenger.hh"
+#include "NESSAAdjointConfig.hh"
+#include "NESSAAdjointSolver.hh"
+
+#include "G4UImanager.hh"
+#include "globals.hh"
+#include <algorithm>
+#include <functional>
+#include <sstream>
+
+NESSAAdjointMessenger::NESSAAdjointMessenger()
+{
+    // /nessa/ itself is created by NESSADetectorMessenger
+    fAdjointDir = new G4UIdirectory("/nessa/adjoint/", false);
+    fAdjointDir->SetGuidance("Coarse multigroup diffusion adjoint: CADIS weight windows");
+    fAdjointDir->SetGuidance("and source direction bias for the target detectors");
+    
+    fMeshCmd = new G4UIcmdWithAString("/nessa/adjoint/mesh", this);
+    fMeshCmd->SetGuidance("Solver mesh: x0 y0 z0 x1 y1 z1 nx ny nz");
+    fMeshCmd->SetGuidance("Box corners in global coordinates [cm], voxels per axis");
+    fMeshCmd->SetGuidance("(default the bunker and detectors, 10 cm voxels).");
+    fMeshCmd->SetGuidance("Must contain the source and the targets.");
+    fMeshCmd->SetParameterName("params", false);
+    
+    fGroupsCmd = new G4UIcmdWithAString("/nessa/adjoint/groups", this);
+    fGroupsCmd->SetGuidance("Neutron group upper bounds [MeV], rising; the lowest group");
+    fGroupsCmd->SetGuidance("starts at 1e-11 MeV (default 1e-7 1e-5 1e-3 0.1 1 3 10 20)");
+    fGroupsCmd->SetParameterName("bounds", false);
+    
+    fTargetCmd = new G4UIcmdWithAString("/nessa/adjoint/target", this);
+    fTargetCmd->SetGuidance("Detectors carrying the adjoint source, by name");
+    fTargetCmd->SetGuidance("(e.g. OutsideFront AboveRoof)");
+    fTargetCmd->SetParameterName("names", false);
+    
+    fResponseCmd = new G4UIcmdWithAString("/nessa/adjoint/response", this);
+    fResponseCmd->SetGuidance("Target response: flux, or dose with the /nessa/dose/");
+    fResponseCmd->SetGuidance("neutron coefficients (default flux)");
+    fResponseCmd->SetParameterName("response", false);
+    
+    fSamplingCmd = new G4UIcmdWithAnInteger("/nessa/adjoint/sampling", this);
+    fSamplingCmd->SetGuidance("Material sampling points per voxel and axis (default 2)");
+    fSamplingCmd->SetParameterName("n", false);
+    fSamplingCmd->SetRange("n>=1");
+    
+    fThreadsCmd = new G4UIcmdWithAnInteger("/nessa/adjoint/threads", this);
+    fThreadsCmd->SetGuidance("Solver threads, 0 = all cores (default)");
+    fThreadsCmd->SetParameterName("n", false);
+    fThreadsCmd->SetRange("n>=0");
+    
+    fLookAheadCmd = new G4UIcmdWithADouble("/nessa/adjoint/lookAhead", this);
+    fLookAheadCmd->SetGuidance("Distance from the source [cm] at which the importance of");
+    fLookAheadCmd->SetGuidance("an emission direction is read (default 30)");
+    fLookAheadCmd->SetParameterName("d", false);
+    fLookAheadCmd->SetRange("d>0");
+    
+    fOutputCmd = new G4UIcmdWithAString("/nessa/adjoint/output", this);
+    fOutputCmd->SetGuidance("Output base: <base>_ww.bin and <base>_bias.dat");
+    fOutputCmd->SetGuidance("(default nessa_adjoint)");
+    fOutputCmd->SetParameterName("base", false);
+    
+    fSolveCmd = new G4UIcmdWithoutParameter("/nessa/adjoint/solve", this);
+    fSolveCmd->SetGuidance("Solve the adjoint, write the outputs and load the weight");
+    fSolveCmd->SetGuidance("windows for the next runs (initialises the run if needed)");
+}
+
+NESSAAdjointMessenger::~NESSAAdjointMessenger()
+{
+    delete fMeshCmd; delete fGroupsCmd; delete fTargetCmd; delete fResponseCmd;
+    delete fSamplingCmd; delete fThreadsCmd; delete fLookAheadCmd; delete fOutputCmd;
+    delete fSolveCmd; delete fAdjointDir;
+}
+
+void NESSAAdjointMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
+{
+    auto& config = NESSAAdjointConfig::Instance();
+    
+    if (cmd == fMeshCmd) {
+        std::istringstream iss(val);
+        G4double lo[3], hi[3];
+        G4int n[3];
+        iss >> lo[0] >> lo[1] >> lo[2] >> hi[0] >> hi[1] >> hi[2] >> n[0] >> n[1] >> n[2];
+        G4bool ok = !iss.fail();
+        for (G4int k = 0; ok && k < 3; k++) {
+            if (lo[k] > hi[k]) std::swap(lo[k], hi[k]);
+            ok = n[k] > 0 && hi[k] > lo[k];
+        }
+        if (!ok) {
+            G4Exception("NESSAAdjointMessenger::SetNewValue", "Adjoint001", JustWarning,
+                ("Usage: mesh x0 y0 z0 x1 y1 z1 nx ny nz, got: " + val).c_str());
+            return;
+        }
+        config.SetMesh(lo, hi, n);
+    }
+    else if (cmd == fGroupsCmd) {
+        std::istringstream iss(val);
+        std::vector<G4double> bounds;
+        G4double e;
+        while (iss >> e) bounds.push_back(e);
+        if (bounds.empty() || !(bounds.front() > 1e-11) || !iss.eof()
+            || !std::is_sorted(bounds.begin(), bounds.end(), std::less_equal<G4double>())) {
+            G4Exception("NESSAAdjointMessenger::SetNewValue", "Adjoint001", JustWarning,
+                ("Usage: groups e1 e2 ... (rising, MeV, above 1e-11), got: " + val).c_str());
+            return;
+        }
+        config.SetGroups(bounds);
+    }
+    else if (cmd == fTargetCmd) {
+        std::istringstream iss(val);
+        std::vector<G4String> names;
+        G4String name;
+        while (iss >> name) names.push_back(name);
+        config.SetTargets(names);
+    }
+    else if (cmd == fResponseCmd) {
+        if (val == "flux") config.SetResponse(NESSAAdjointConfig::kFlux);
+        else if (val == "dose") config.SetResponse(NESSAAdjointConfig::kDose);
+        else {
+            G4Exception("NESSAAdjointMessenger::SetNewValue", "Adjoint001", JustWarning,
+                ("Usage: response flux|dose, got: " + val).c_str());
+        }
+    }
+    else if (cmd == fSamplingCmd) {
+        config.SetSampling(fSamplingCmd->GetNewIntValue(val));
+    }
+    else if (cmd == fThreadsCmd) {
+        config.SetThreads(fThreadsCmd->GetNewIntValue(val));
+    }
+    else if (cmd == fLookAheadCmd) {
+        config.SetLookAhead(fLookAheadCmd->GetNewDoubleValue(val));
+    }
+    else if (cmd == fOutputCmd) {
+        config.SetOutput(val);
+    }
+    else if (cmd == fSolveCmd) {
+        if (config.GetTargets().empty()) {
+            G4Exception("NESSAAdjointMessenger::SetNewValue", "Adjoint001", JustWarning,
+                "Set the targets first (/nessa/adjoint/target)");
+            return;
+        }
+        // An empty run builds the geometry and the cross-section tables
+        // without touching the tallies
+        if (G4UImanager::GetUIpointer()->ApplyCommand("/run/beamOn 0") != 0) return;
+        G4String error;
+        if (!NESSAAdjointSolver().Run(error)) {
+            G4Exception("NESSAAdjointMessenger::SetNewValue", "Adjoint004", JustWarning,
+                ("Adjoint solve failed: " + error).c_str());
+        }
+    }
+}
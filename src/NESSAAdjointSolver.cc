@@ -0,0 +1,569 @@
+#include "NESSAAdjointSolver.hh"
+#include "NESSAAdjointConfig.hh"
+#include "NESSAScoringConfig.hh"
+#include "NESSADoseConversion.hh"
+#include "NESSAWeightWindowConfig.hh"
+#include "NESSAPrimaryGeneratorAction.hh"
+#include "NESSASourceConfig.hh"
+
+#include "G4Material.hh"
+#include "G4Element.hh"
+#include "G4Neutron.hh"
+#include "G4HadronicProcessStore.hh"
+#include "G4Navigator.hh"
+#include "G4TransportationManager.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Threading.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include "globals.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <thread>
+
+namespace {
+    
+/// Run f(thread, begin, end) over [0, n) split between nThreads threads
+template <class F>
+void ParallelFor(G4int nThreads, G4long n, const F& f)
+{
+    if (nThreads <= 1 || n < 4096) {
+        f(0, 0, n);
+        return;
+    }
+    std::vector<std::thread> pool;
+    for (G4int t = 0; t < nThreads; t++) {
+        const G4long begin = n * t / nThreads, end = n * (t + 1) / nThreads;
+        pool.emplace_back([&f, t, begin, end]() { f(t, begin, end); });
+    }
+    for (auto& thread : pool) thread.join();
+}
+    
+const G4double kLowestEnergy = 1e-11;    // [MeV], bottom of the thermal group
+const G4double kMinTransport = 1e-4;     // [1/cm], caps D in air and void
+const G4int    kEnergyPoints = 8;        // cross-section points per group
+const G4double kTolerance = 1e-6;        // relative residual of each group
+const G4int    kMaxIterations = 20000;
+    
+}  // namespace
+
+G4int NESSAAdjointSolver::NThreads() const
+{
+    const G4int n = NESSAAdjointConfig::Instance().GetThreads();
+    return n > 0 ? n : std::max(1, G4Threading::G4GetNumberOfCores());
+}
+
+G4int NESSAAdjointSolver::Voxel(const G4ThreeVector& x) const
+{
+    G4int idx[3];
+    for (G4int k = 0; k < 3; k++) {
+        const G4double u = (x[k] - fLo[k]) / fH[k];
+        if (u < 0. || u >= fN[k]) return -1;
+        idx[k] = std::min((G4int)u, fN[k] - 1);
+    }
+    return idx[0] + fN[0] * (idx[1] + fN[1] * idx[2]);
+}
+
+G4ThreeVector NESSAAdjointSolver::VoxelCentre(G4long v) const
+{
+    const G4long idx[3] = {v % fN[0], (v / fN[0]) % fN[1], v / (fN[0] * fN[1])};
+    return G4ThreeVector(fLo[0] + fH[0] * (idx[0] + 0.5), fLo[1] + fH[1] * (idx[1] + 0.5),
+                         fLo[2] + fH[2] * (idx[2] + 0.5));
+}
+
+G4bool NESSAAdjointSolver::Run(G4String& error)
+{
+    const auto& config = NESSAAdjointConfig::Instance();
+    const auto start = std::chrono::steady_clock::now();
+    for (G4int k = 0; k < 3; k++) {
+        fLo[k] = config.GetLo()[k];
+        fN[k] = config.GetN()[k];
+        fH[k] = (config.GetHi()[k] - fLo[k]) / fN[k];
+    }
+    const auto& groups = config.GetGroups();
+    fNGroups = (G4int)groups.size();
+    fBounds.assign(groups.rbegin(), groups.rend());
+    fBounds.push_back(kLowestEnergy);
+    
+    G4cout << "\n=== NESSA adjoint solver ===" << G4endl;
+    G4cout << "  mesh " << fN[0] << "x" << fN[1] << "x" << fN[2] << " ("
+           << fH[0] << " x " << fH[1] << " x " << fH[2] << " cm), " << fNGroups
+           << " groups, " << NThreads() << " threads" << G4endl;
+    
+    Voxelise();
+    if (!BuildAdjointSource(error)) return false;
+    const auto voxelised = std::chrono::steady_clock::now();
+    G4cout << "  voxelised: " << fMixtures.size() << " material mixtures ("
+           << std::fixed << std::setprecision(1)
+           << std::chrono::duration<G4double>(voxelised - start).count() << " s)" << G4endl;
+    
+    // Downscatter only: the adjoint of a group needs the lower groups
+    fAdjoint.assign((std::size_t)fNGroups * NVoxels(), 0.);
+    for (G4int g = fNGroups - 1; g >= 0; g--) {
+        G4double residual = 0.;
+        const G4int iterations = SolveGroup(g, residual);
+        G4cout << "  group " << std::setw(2) << g << "  " << std::scientific
+               << std::setprecision(2) << fBounds[g + 1] << " - " << fBounds[g]
+               << " MeV: " << std::setw(5) << iterations << " iterations, residual "
+               << residual << G4endl;
+        if (iterations >= kMaxIterations) {
+            G4Exception("NESSAAdjointSolver::Run", "Adjoint003", JustWarning,
+                ("Group " + std::to_string(g) + " did not converge").c_str());
+        }
+    }
+    const auto solved = std::chrono::steady_clock::now();
+    G4cout << "  solved in " << std::fixed << std::setprecision(1)
+           << std::chrono::duration<G4double>(solved - voxelised).count() << " s" << G4endl;
+    
+    NESSAPrimaryGeneratorAction source;  // reads the Adelphi distributions
+    return WriteOutputs(source, error);
+}
+
+NESSAAdjointSolver::GroupConstants NESSAAdjointSolver::MaterialConstants(
+    const G4Material* material) const
+{
+    const G4int G = fNGroups;
+    GroupConstants c;
+    c.transport.assign(G, 0.);
+    c.removal.assign(G, 0.);
+    c.transfer.assign(G * G, 0.);
+    if (!material) return c;
+    
+    auto* store = G4HadronicProcessStore::Instance();
+    const auto* neutron = G4Neutron::Definition();
+    const auto* elements = material->GetElementVector();
+    const G4double* atoms = material->GetVecNbOfAtomsPerVolume();
+    const std::size_t nElements = material->GetNumberOfElements();
+    
+    // Group of energy e, G - 1 below the last bound
+    auto groupOf = [this](G4double e) {
+        G4int g = 0;
+        while (g < fNGroups - 1 && e < fBounds[g + 1]) g++;
+        return g;
+    };
+    
+    for (G4int g = 0; g < G; g++) {
+        const G4double lo = fBounds[g + 1], hi = fBounds[g];
+        G4double total = 0., transport = 0.;
+        for (G4int k = 0; k < kEnergyPoints; k++) {
+            const G4double e = lo * std::pow(hi / lo, (k + 0.5) / kEnergyPoints);
+            const G4double inelastic =
+                store->GetInelasticCrossSectionPerVolume(neutron, e * MeV, material) * cm;
+            const G4double capture =
+                store->GetCaptureCrossSectionPerVolume(neutron, e * MeV, material) * cm;
+            G4double elastic = 0., mu = 0.;
+            for (std::size_t i = 0; i < nElements; i++) {
+                const auto* element = (*elements)[i];
+                const G4double s = atoms[i] * cm3 * store->GetElasticCrossSectionPerAtom(
+                                       neutron, e * MeV, element, material) / cm2;
+                if (s <= 0.) continue;
+                elastic += s;
+                // Isotropic in the CM: E' uniform on [alpha E, E]
+                const G4double A = std::max(1., element->GetN());
+                mu += s * 2. / (3. * A);
+                const G4double alpha = std::pow((A - 1.) / (A + 1.), 2);
+                const G4double width = (1. - alpha) * e;
+                for (G4int gp = g; gp < G; gp++) {
+                    const G4double glo = (gp == G - 1) ? 0. : fBounds[gp + 1];
+                    const G4double overlap = std::min(e, fBounds[gp]) - std::max(alpha * e, glo);
+                    if (overlap > 0.)
+                        c.transfer[g * G + gp] += s * overlap / width / kEnergyPoints;
+                }
+            }
+            // One neutron out of every inelastic reaction, no multiplication
+            c.transfer[g * G + groupOf(std::min(0.5 * e, 2.))] += inelastic / kEnergyPoints;
+            total += (elastic + inelastic + capture) / kEnergyPoints;
+            transport += (elastic + inelastic + capture - mu) / kEnergyPoints;
+        }
+        c.transport[g] = transport;
+        c.removal[g] = std::max(0., total - c.transfer[g * G + g]);
+    }
+    return c;
+}
+
+void NESSAAdjointSolver::Voxelise()
+{
+    // One navigator on this (the master) thread: the per-thread volume
+    // data of an MT build is not set up on other threads
+    auto* world = G4TransportationManager::GetTransportationManager()
+                      ->GetNavigatorForTracking()->GetWorldVolume();
+    G4Navigator navigator;
+    navigator.SetWorldVolume(world);
+    
+    const G4int s = std::max(1, NESSAAdjointConfig::Instance().GetSampling());
+    std::vector<const G4Material*> materials;
+    std::map<std::vector<std::pair<G4int, G4int>>, G4int> mixtureIDs;
+    std::vector<std::vector<std::pair<G4int, G4int>>> mixtures;
+    fMixtureOfVoxel.assign(NVoxels(), 0);
+    
+    std::vector<std::pair<G4int, G4int>> counts;
+    for (G4int v = 0; v < NVoxels(); v++) {
+        const G4int idx[3] = {v % fN[0], (v / fN[0]) % fN[1], v / (fN[0] * fN[1])};
+        counts.clear();
+        for (G4int a = 0; a < s * s * s; a++) {
+            const G4int sub[3] = {a % s, (a / s) % s, a / (s * s)};
+            G4ThreeVector x;
+            for (G4int k = 0; k < 3; k++)
+                x[k] = (fLo[k] + fH[k] * (idx[k] + (sub[k] + 0.5) / s)) * cm;
+            const auto* pv = navigator.LocateGlobalPointAndSetup(x);
+            const G4Material* material = pv ? pv->GetLogicalVolume()->GetMaterial() : nullptr;
+            G4int m = (G4int)(std::find(materials.begin(), materials.end(), material)
+                              - materials.begin());
+            if (m == (G4int)materials.size()) materials.push_back(material);
+            auto it = std::find_if(counts.begin(), counts.end(),
+                                   [m](const std::pair<G4int, G4int>& c) { return c.first == m; });
+            if (it == counts.end()) counts.push_back({m, 1});
+            else it->second++;
+        }
+        std::sort(counts.begin(), counts.end());
+        auto found = mixtureIDs.find(counts);
+        if (found == mixtureIDs.end()) {
+            found = mixtureIDs.emplace(counts, (G4int)mixtures.size()).first;
+            mixtures.push_back(counts);
+        }
+        fMixtureOfVoxel[v] = found->second;
+    }
+    
+    // Constants per material (the cross-section calls are not thread-safe),
+    // then volume-weighted per mixture
+    std::vector<GroupConstants> constants;
+    for (const auto* material : materials) constants.push_back(MaterialConstants(material));
+    fMixtures.assign(mixtures.size(), GroupConstants());
+    for (std::size_t i = 0; i < mixtures.size(); i++) {
+        auto& mix = fMixtures[i];
+        mix.transport.assign(fNGroups, 0.);
+        mix.removal.assign(fNGroups, 0.);
+        mix.transfer.assign(fNGroups * fNGroups, 0.);
+        for (const auto& part : mixtures[i]) {
+            const G4double f = (G4double)part.second / (s * s * s);
+            const auto& c = constants[part.first];
+            for (G4int g = 0; g < fNGroups; g++) {
+                mix.transport[g] += f * c.transport[g];
+                mix.removal[g] += f * c.removal[g];
+            }
+            for (std::size_t j = 0; j < mix.transfer.size(); j++)
+                mix.transfer[j] += f * c.transfer[j];
+        }
+    }
+}
+
+G4bool NESSAAdjointSolver::BuildAdjointSource(G4String& error)
+{
+    const auto& config = NESSAAdjointConfig::Instance();
+    const auto& targets = config.GetTargets();
+    const auto& dose = NESSADoseConversion::Instance();
+    fSource.assign((std::size_t)fNGroups * NVoxels(), 0.);
+    
+    G4int nTargets = 0;
+    for (const auto& pt : NESSAScoringConfig::Instance().GetPoints()) {
+        if (!pt.active || std::find(targets.begin(), targets.end(), pt.name) == targets.end())
+            continue;
+        const G4int v = Voxel(G4ThreeVector(pt.x, pt.y, pt.z));
+        if (v < 0) {
+            G4Exception("NESSAAdjointSolver::BuildAdjointSource", "Adjoint002", JustWarning,
+                ("Target " + pt.name + " is outside the solver mesh").c_str());
+            continue;
+        }
+        for (G4int g = 0; g < fNGroups; g++) {
+            const G4double e = std::sqrt(fBounds[g] * fBounds[g + 1]);
+            const G4double response = (config.GetResponse() == NESSAAdjointConfig::kDose)
+                                    ? dose.Coefficient(0, e) : 1.;
+            fSource[(std::size_t)g * NVoxels() + v] += response / VoxelVolume();
+        }
+        nTargets++;
+    }
+    if (nTargets == 0) {
+        error = "no active target detector inside the solver mesh";
+        return false;
+    }
+    return true;
+}
+
+G4int NESSAAdjointSolver::SolveGroup(G4int g, G4double& residual)
+{
+    const G4int G = fNGroups;
+    const G4int nx = fN[0], ny = fN[1], nz = fN[2];
+    const G4long NV = NVoxels();
+    const G4long sx = 1, sy = nx, sz = (G4long)nx * ny;
+    const G4double V = VoxelVolume();
+    const G4double area[3] = {fH[1] * fH[2], fH[0] * fH[2], fH[0] * fH[1]};
+    const G4int nThreads = NThreads();
+    
+    // Diffusion coefficients, couplings to the +x/+y/+z neighbour and the
+    // diagonal (leakage, Marshak vacuum boundaries, removal)
+    std::vector<G4double> D(NV), diag(NV), c[3];
+    for (auto& ck : c) ck.assign(NV, 0.);
+    for (G4long v = 0; v < NV; v++) {
+        const auto& mix = fMixtures[fMixtureOfVoxel[v]];
+        D[v] = 1. / (3. * std::max(kMinTransport, mix.transport[g]));
+        diag[v] = mix.removal[g] * V;
+    }
+    std::vector<G4double> b(NV, 0.);
+    ParallelFor(nThreads, NV, [&](G4int, G4long begin, G4long end) {
+        for (G4long v = begin; v < end; v++) {
+            const G4int idx[3] = {(G4int)(v % nx), (G4int)((v / nx) % ny), (G4int)(v / sz)};
+            const G4long stride[3] = {sx, sy, sz};
+            for (G4int k = 0; k < 3; k++) {
+                const G4double h = fH[k];
+                if (idx[k] + 1 < fN[k]) {
+                    const G4long u = v + stride[k];
+                    c[k][v] = area[k] * 2. * D[v] * D[u] / (h * (D[v] + D[u]));
+                    diag[v] += c[k][v];
+                } else {
+                    diag[v] += area[k] * D[v] / (0.5 * h + 2. * D[v]);
+                }
+                if (idx[k] > 0) {
+                    const G4long u = v - stride[k];
+                    diag[v] += area[k] * 2. * D[v] * D[u] / (h * (D[v] + D[u]));
+                } else {
+                    diag[v] += area[k] * D[v] / (0.5 * h + 2. * D[v]);
+                }
+            }
+            // Adjoint: importance of the groups a neutron scatters into
+            const auto& mix = fMixtures[fMixtureOfVoxel[v]];
+            G4double rhs = fSource[(std::size_t)g * NV + v];
+            for (G4int gp = g + 1; gp < G; gp++)
+                rhs += mix.transfer[g * G + gp] * fAdjoint[(std::size_t)gp * NV + v];
+            b[v] = rhs * V;
+        }
+    });
+    
+    auto apply = [&](const std::vector<G4double>& p, G4long v) {
+        G4double q = diag[v] * p[v];
+        const G4int i = (G4int)(v % nx), j = (G4int)((v / nx) % ny), k = (G4int)(v / sz);
+        if (i + 1 < nx) q -= c[0][v] * p[v + sx];
+        if (i > 0) q -= c[0][v - sx] * p[v - sx];
+        if (j + 1 < ny) q -= c[1][v] * p[v + sy];
+        if (j > 0) q -= c[1][v - sy] * p[v - sy];
+        if (k + 1 < nz) q -= c[2][v] * p[v + sz];
+        if (k > 0) q -= c[2][v - sz] * p[v - sz];
+        return q;
+    };
+    
+    // Jacobi-preconditioned conjugate gradients
+    G4double* x = &fAdjoint[(std::size_t)g * NV];
+    std::vector<G4double> r(b), z(NV), p(NV), q(NV);
+    std::vector<G4double> partial(3 * nThreads);
+    auto sum = [&](G4int which) {
+        G4double s = 0.;
+        for (G4int t = 0; t < nThreads; t++) s += partial[3 * t + which];
+        return s;
+    };
+    
+    std::fill(partial.begin(), partial.end(), 0.);
+    ParallelFor(nThreads, NV, [&](G4int t, G4long begin, G4long end) {
+        G4double rz = 0., bb = 0.;
+        for (G4long v = begin; v < end; v++) {
+            z[v] = r[v] / diag[v];
+            p[v] = z[v];
+            rz += r[v] * z[v];
+            bb += b[v] * b[v];
+        }
+        partial[3 * t] = rz;
+        partial[3 * t + 1] = bb;
+    });
+    G4double rz = sum(0);
+    const G4double bNorm = std::sqrt(sum(1));
+    residual = 0.;
+    if (bNorm <= 0.) return 0;
+    
+    G4int it = 0;
+    for (; it < kMaxIterations; it++) {
+        std::fill(partial.begin(), partial.end(), 0.);
+        ParallelFor(nThreads, NV, [&](G4int t, G4long begin, G4long end) {
+            G4double pq = 0.;
+            for (G4long v = begin; v < end; v++) {
+                q[v] = apply(p, v);
+                pq += p[v] * q[v];
+            }
+            partial[3 * t] = pq;
+        });
+        const G4double alpha = rz / sum(0);
+        std::fill(partial.begin(), partial.end(), 0.);
+        ParallelFor(nThreads, NV, [&](G4int t, G4long begin, G4long end) {
+            G4double rzNew = 0., rr = 0.;
+            for (G4long v = begin; v < end; v++) {
+                x[v] += alpha * p[v];
+                r[v] -= alpha * q[v];
+                z[v] = r[v] / diag[v];
+                rzNew += r[v] * z[v];
+                rr += r[v] * r[v];
+            }
+            partial[3 * t] = rzNew;
+            partial[3 * t + 1] = rr;
+        });
+        const G4double rzNew = sum(0);
+        residual = std::sqrt(sum(1)) / bNorm;
+        if (residual < kTolerance) return it + 1;
+        const G4double beta = rzNew / rz;
+        rz = rzNew;
+        ParallelFor(nThreads, NV, [&](G4int, G4long begin, G4long end) {
+            for (G4long v = begin; v < end; v++) p[v] = z[v] + beta * p[v];
+        });
+    }
+    return it;
+}
+
+G4bool NESSAAdjointSolver::WriteOutputs(const NESSAPrimaryGeneratorAction& source,
+                                        G4String& error)
+{
+    const auto& config = NESSAAdjointConfig::Instance();
+    const G4long NV = NVoxels();
+    const G4ThreeVector sourcePos = source.GetSourcePosition() / cm;
+    const G4int sourceVoxel = Voxel(sourcePos);
+    if (sourceVoxel < 0) {
+        error = "the source is outside the solver mesh";
+        return false;
+    }
+    auto adjoint = [&](G4int g, G4long v) { return fAdjoint[(std::size_t)g * NV + v]; };
+    
+    // Source spectrum per group and direction bin
+    const G4int nDir = source.GetNDirectionBins();
+    std::vector<G4double> spectrum((std::size_t)nDir * fNGroups);
+    for (G4int i = 0; i < nDir; i++)
+        for (G4int g = 0; g < fNGroups; g++)
+            spectrum[(std::size_t)i * fNGroups + g] =
+                source.EnergyFraction(i, fBounds[g + 1], fBounds[g]);
+    
+    // Response per source neutron at the source voxel
+    G4double response = 0.;
+    for (G4int i = 0; i < nDir; i++) {
+        const G4double p = source.DirectionBinProbability(i);
+        for (G4int g = 0; g < fNGroups; g++)
+            response += p * spectrum[(std::size_t)i * fNGroups + g] * adjoint(g, sourceVoxel);
+    }
+    if (response <= 0.) {
+        error = "no adjoint flux at the source (targets unreachable on this mesh)";
+        return false;
+    }
+    
+    // Direction bins (cosines to the source axis, z): adjoint flux a
+    // look-ahead distance along the bin, or at the last voxel before the
+    // mesh ends, averaged over azimuth and folded with the bin's spectrum
+    const G4int nPhi = 16;
+    const G4double lookAhead = config.GetLookAhead();
+    const G4double stepBack = 0.5 * std::min({fH[0], fH[1], fH[2]});
+    std::vector<G4double> importance(nDir, 0.);
+    G4double mean = 0.;
+    for (G4int i = 0; i < nDir; i++) {
+        G4double muLo, muHi;
+        source.DirectionBinRange(i, muLo, muHi);
+        const G4double mu = 0.5 * (muLo + muHi);
+        const G4double sinTheta = std::sqrt(std::max(0., 1. - mu * mu));
+        for (G4int k = 0; k < nPhi; k++) {
+            const G4double phi = twopi * (k + 0.5) / nPhi;
+            const G4ThreeVector dir(sinTheta * std::cos(phi), sinTheta * std::sin(phi), mu);
+            G4int v = -1;
+            for (G4double d = lookAhead; v < 0 && d > 0.; d -= stepBack)
+                v = Voxel(sourcePos + dir * d);
+            if (v < 0) continue;
+            for (G4int g = 0; g < fNGroups; g++)
+                importance[i] += spectrum[(std::size_t)i * fNGroups + g] * adjoint(g, v) / nPhi;
+        }
+        mean += source.DirectionBinProbability(i) * importance[i];
+    }
+    if (mean <= 0.) {
+        error = "no adjoint flux around the source; increase the mesh or reduce lookAhead";
+        return false;
+    }
+    // A floor keeps every direction of the analog source possible. A bin
+    // is born with weight p_i / p_biased = total / I_i.
+    G4double total = 0., maxImportance = 0.;
+    for (G4int i = 0; i < nDir; i++) {
+        importance[i] = std::max(importance[i], 1e-3 * mean);
+        total += source.DirectionBinProbability(i) * importance[i];
+        maxImportance = std::max(maxImportance, importance[i]);
+    }
+    
+    // Weight windows centred on total / adjoint flux: the same
+    // normalisation as the birth weights, so a biased track carries the
+    // window centre once it reaches the flux its bin was biased on. (The
+    // CADIS R would differ from total by the look-ahead, and put every
+    // favoured birth below its windows.)
+    auto& wwConfig = NESSAWeightWindowConfig::Instance();
+    auto windows = std::make_shared<NESSAWeightWindowMesh>();
+    for (G4int k = 0; k < 3; k++) {
+        for (G4int i = 0; i <= fN[k]; i++) windows->edges[k].push_back(fLo[k] + fH[k] * i);
+    }
+    windows->energies[0] = config.GetGroups();
+    windows->lower[0].assign((std::size_t)fNGroups * NV, 0.);
+    const G4double upper = wwConfig.GetUpperRatio();
+    const G4double norm = 2. / (1. + upper) * total;
+    // Within lookAhead of the source a track has not reached that flux
+    // yet: no lower bound there is above the window centred on the
+    // lightest birth weight, so favoured births are not rouletted
+    const G4double sourceLower = 2. / (1. + upper) * total / maxImportance;
+    for (G4int g = 0; g < fNGroups; g++) {
+        const G4int meshGroup = fNGroups - 1 - g;  // the mesh groups rise in energy
+        for (G4long v = 0; v < NV; v++) {
+            if (adjoint(g, v) <= 0.) continue;
+            G4double lower = norm / adjoint(g, v);
+            if ((VoxelCentre(v) - sourcePos).mag() <= lookAhead)
+                lower = std::min(lower, sourceLower);
+            windows->lower[0][windows->LowerIndex(v, meshGroup)] = lower;
+        }
+    }
+    // Check: every birth weight within its group's window at the source
+    // (above it only splits; below it would be rouletted)
+    G4int nBelow = 0, nAbove = 0;
+    for (G4int i = 0; i < nDir; i++) {
+        const G4double w = total / importance[i];
+        for (G4int g = 0; g < fNGroups; g++) {
+            if (spectrum[(std::size_t)i * fNGroups + g] <= 0.) continue;
+            const G4double lower = windows->lower[0][windows->LowerIndex(sourceVoxel,
+                                                                         fNGroups - 1 - g)];
+            if (lower <= 0.) continue;
+            if (w < lower) nBelow++;
+            else if (w > upper * lower) nAbove++;
+        }
+    }
+    
+    const G4String wwFile = config.GetOutput() + "_ww.bin";
+    if (!windows->Write(wwFile, error)) return false;
+    wwConfig.SetMesh(windows);
+    
+    const G4String biasFile = config.GetOutput() + "_bias.dat";
+    std::ofstream out(biasFile);
+    if (!out.is_open()) {
+        error = "cannot write " + biasFile;
+        return false;
+    }
+    out << "# NESSA source direction bias (adjoint solver)\n"
+        << "# importance = adjoint flux " << lookAhead << " cm from the source along the bin,\n"
+        << "# folded with its energy spectrum; p_biased = p_analog importance / sum,\n"
+        << "# birth weight sum / importance (the window normalisation)\n"
+        << "# bin  mu_lo  mu_hi  p_analog  p_biased  importance\n";
+    out << std::scientific << std::setprecision(6);
+    std::vector<G4double> biased(nDir);
+    for (G4int i = 0; i < nDir; i++) {
+        G4double muLo, muHi;
+        source.DirectionBinRange(i, muLo, muHi);
+        const G4double p = source.DirectionBinProbability(i);
+        biased[i] = p * importance[i] / total;
+        out << i << "  " << muLo << "  " << muHi << "  " << p << "  "
+            << biased[i] << "  " << importance[i] << "\n";
+    }
+    NESSASourceConfig::Instance().SetBinProbabilities(biased);
+    
+    G4long nSet = std::count_if(windows->lower[0].begin(), windows->lower[0].end(),
+                                [](G4double w) { return w > 0.; });
+    G4cout << "  response at the source " << std::scientific << std::setprecision(3)
+           << response << (config.GetResponse() == NESSAAdjointConfig::kDose
+                           ? " pSv" : " /cm2") << " per source neutron" << G4endl;
+    G4cout << "  weight windows: " << nSet << "/" << windows->lower[0].size()
+           << " bounds set, written to " << wwFile << " and loaded" << G4endl;
+    G4cout << "  source direction bias: written to " << biasFile << " and loaded" << G4endl;
+    G4cout << "  birth weights vs. source windows: " << nBelow << " below, " << nAbove
+           << " above (bins x groups)" << G4endl;
+    if (nBelow > 0) {
+        G4Exception("NESSAAdjointSolver::WriteOutputs", "Adjoint005", JustWarning,
+            "Some biased births are below their first weight window");
+    }
+    return true;
+}
@@ -0,0 +1,223 @@
+#include "NESSACellImportance.hh"
+#include "NESSAWeightWindowConfig.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4DynamicParticle.hh"
+#include "G4Neutron.hh"
+#include "G4Gamma.hh"
+#include "G4TransportationManager.hh"
+#include "G4Navigator.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4AffineTransform.hh"
+#include "Randomize.hh"
+#include "G4ios.hh"
+
+#include <map>
+#include <array>
+#include <iomanip>
+#include <cmath>
+
+NESSACellImportance::NESSACellImportance(const G4String& name)
+    : G4VAccumulable(name),
+      fNeutron(G4Neutron::Definition()),
+      fGamma(G4Gamma::Definition()) {}
+
+namespace {
+
+using Pair = std::array<G4double, 2>;
+
+/// Importances of the deepest listed placement around point (global),
+/// skipping the placement exclude and its daughters; the world's entry, or
+/// 1, if none is listed
+Pair ContainerImportance(const G4VPhysicalVolume* world, const G4ThreeVector& point,
+                         const G4VPhysicalVolume* exclude,
+                         const std::map<G4int, Pair>& listed)
+{
+    Pair imp = {1., 1.};
+    auto entry = listed.find(world->GetCopyNo());
+    if (entry != listed.end()) imp = entry->second;
+    const G4LogicalVolume* lv = world->GetLogicalVolume();
+    G4ThreeVector p = point;
+    for (G4bool descend = true; descend; ) {
+        descend = false;
+        for (size_t i = 0; i < lv->GetNoDaughters(); i++) {
+            const auto* d = lv->GetDaughter(i);
+            if (d == exclude || d->IsReplicated()) continue;
+            const G4ThreeVector local = G4AffineTransform(d->GetRotation(),
+                d->GetTranslation()).InverseTransformPoint(p);
+            if (d->GetLogicalVolume()->GetSolid()->Inside(local) == kOutside) continue;
+            entry = listed.find(d->GetCopyNo());
+            if (entry != listed.end()) imp = entry->second;
+            lv = d->GetLogicalVolume();
+            p = local;
+            descend = true;
+            break;
+        }
+    }
+    return imp;
+}
+
+}
+
+void NESSACellImportance::SetUp(const NESSACellConfig::Importances& importances)
+{
+    fCells.clear();
+    fImportance.clear();
+    fUnlisted.clear();
+    fNUnknown = 0;
+    const auto mesh = NESSAWeightWindowConfig::Instance().GetMesh();
+    for (G4int p = 0; p < 2; p++) fWindowed[p] = mesh && mesh->HasWindows(p);
+    Reset();
+    if (importances.empty()) return;
+    const auto* world = G4TransportationManager::GetTransportationManager()
+                            ->GetNavigatorForTracking()->GetWorldVolume();
+    if (!world) return;
+    
+    // Placements of the geometry with the global position of their
+    // origin; replicas and parameterised volumes are not cells
+    struct Placement {
+        const G4VPhysicalVolume* pv;
+        G4AffineTransform toGlobal;
+    };
+    std::map<G4int, Placement> placed;  // first placement per copy number
+    std::vector<Placement> stack = {{world, G4AffineTransform()}};
+    while (!stack.empty()) {
+        const Placement pl = stack.back();
+        stack.pop_back();
+        if (pl.pv->GetCopyNo() >= 0) placed.insert({pl.pv->GetCopyNo(), pl});
+        const auto* lv = pl.pv->GetLogicalVolume();
+        for (size_t i = 0; i < lv->GetNoDaughters(); i++) {
+            const auto* d = lv->GetDaughter(i);
+            if (d->IsReplicated()) continue;
+            stack.push_back({d, G4AffineTransform(d->GetRotation(), d->GetTranslation())
+                                * pl.toGlobal});
+        }
+    }
+    
+    // Listed cells that are placed; the others are counted and dropped
+    std::map<G4int, Pair> listed;
+    for (const auto& entry : importances) {
+        if (!placed.count(entry.first)) { fNUnknown++; continue; }
+        listed[entry.first] = {entry.second[0], entry.second[1]};
+    }
+    
+    fCells.reserve(placed.size());
+    fImportance.reserve(2 * placed.size());
+    for (const auto& [copyNo, pl] : placed) {
+        auto entry = listed.find(copyNo);
+        Pair imp;
+        if (entry != listed.end()) {
+            imp = entry->second;
+        } else if (pl.pv == world) {
+            imp = {1., 1.};
+            fUnlisted.push_back(copyNo);
+        } else {
+            imp = ContainerImportance(world, pl.toGlobal.TransformPoint(G4ThreeVector()),
+                                      pl.pv, listed);
+            // Scoring spheres are numbered from 90000 (NESSADetectorConstruction)
+            if (copyNo < 90000) fUnlisted.push_back(copyNo);
+        }
+        fCells.push_back(copyNo);
+        fImportance.push_back(imp[0]);
+        fImportance.push_back(imp[1]);
+    }
+}
+
+void NESSACellImportance::ApplyAtBoundary(const G4Step* step, G4TrackVector* secondaries)
+{
+    const auto* post = step->GetPostStepPoint();
+    if (post->GetStepStatus() != fGeomBoundary || !post->GetPhysicalVolume()) return;
+    
+    G4Track* track = step->GetTrack();
+    if (track->GetTrackStatus() != fAlive) return;
+    const auto* def = track->GetDefinition();
+    const G4int particle = (def == fNeutron) ? 0 : (def == fGamma) ? 1 : -1;
+    if (particle < 0) return;
+    
+    const G4int from = step->GetPreStepPoint()->GetTouchable()->GetCopyNumber();
+    const G4int to = post->GetTouchable()->GetCopyNumber();
+    if (from == to) return;
+    const G4double impFrom = Importance(from, particle);
+    const G4double impTo = Importance(to, particle);
+    if (impTo == impFrom || impFrom <= 0.) return;
+    
+    G4double* counts = fCounts[particle];
+    if (impTo <= 0.) {
+        track->SetTrackStatus(fStopAndKill);
+        counts[kZeroKills]++;
+        return;
+    }
+    // Weight windows split and roulette this particle instead
+    if (fWindowed[particle]) return;
+    
+    const G4double r = impTo / impFrom;
+    const G4double w = track->GetWeight();
+    if (r < 1.) {
+        counts[kGames]++;
+        if (G4UniformRand() < r) {
+            track->SetWeight(w / r);
+        } else {
+            track->SetTrackStatus(fStopAndKill);
+            counts[kRouletted]++;
+        }
+        return;
+    }
+    
+    // n tracks of weight w/r with E[n] = r: this one and n - 1 clones
+    G4int n = (G4int)r;
+    if (G4UniformRand() < r - n) n++;
+    track->SetWeight(w / r);
+    counts[kSplits]++;
+    counts[kClones] += n - 1;
+    AddClones(track, post, w / r, n - 1, secondaries);
+}
+
+void NESSACellImportance::AddClones(const G4Track* track, const G4StepPoint* post,
+    G4double weight, G4int n, G4TrackVector* secondaries)
+{
+    for (G4int i = 0; i < n; i++) {
+        auto* clone = new G4Track(new G4DynamicParticle(*track->GetDynamicParticle()),
+                                  track->GetGlobalTime(), track->GetPosition());
+        clone->SetTouchableHandle(post->GetTouchableHandle());
+        clone->SetLocalTime(track->GetLocalTime());
+        clone->SetProperTime(track->GetProperTime());
+        clone->SetWeight(weight);
+        clone->SetParentID(track->GetTrackID());
+        clone->SetCreatorProcess(track->GetCreatorProcess());
+        secondaries->push_back(clone);
+    }
+}
+
+void NESSACellImportance::Merge(const G4VAccumulable& other)
+{
+    const auto& o = static_cast<const NESSACellImportance&>(other);
+    for (G4int p = 0; p < 2; p++)
+        for (G4int c = 0; c < kNCounts; c++) fCounts[p][c] += o.fCounts[p][c];
+}
+
+void NESSACellImportance::Reset()
+{
+    for (auto& counts : fCounts)
+        for (auto& c : counts) c = 0.;
+}
+
+void NESSACellImportance::Print(G4double nEvents) const
+{
+    if (IsEmpty() || nEvents <= 0) return;
+    G4cout << "  Cell importances (per source particle):" << G4endl;
+    G4cout << "    " << std::left << std::setw(10) << "particle" << std::right
+           << std::setw(12) << "splits" << std::setw(12) << "clones"
+           << std::setw(12) << "roulette" << std::setw(12) << "killed"
+           << std::setw(12) << "imp=0" << G4endl;
+    static const char* names[2] = {"neutron", "gamma"};
+    for (G4int p = 0; p < 2; p++) {
+        G4cout << "    " << std::left << std::setw(10) << names[p] << std::right
+               << std::scientific << std::setprecision(3);
+        for (G4int c = 0; c < kNCounts; c++)
+            G4cout << std::setw(12) << fCounts[p][c] / nEvents;
+        G4cout << G4endl;
+    }
+}
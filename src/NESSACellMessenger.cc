@@ -0,0 +1,117 @@
+#include "NESSACellMessenger.hh"
+#include "NESSACellConfig.hh"
+
+#include "globals.hh"
+#include <fstream>
+#include <sstream>
+
+NESSACellMessenger::NESSACellMessenger()
+{
+    // /nessa/ itself is created by NESSADetectorMessenger
+    fCellDir = new G4UIdirectory("/nessa/cell/", false);
+    fCellDir->SetGuidance("Tallies and settings per geometry cell (MCNP cell number)");
+    
+    fTallyCmd = new G4UIcmdWithAString("/nessa/cell/tally", this);
+    fTallyCmd->SetGuidance("Track-length flux in every cell, written to <output>_cells.dat:");
+    fTallyCmd->SetGuidance("  off      no cell tally (default)");
+    fTallyCmd->SetGuidance("  flux     neutron and photon flux");
+    fTallyCmd->SetGuidance("  capture  flux and the neutron capture rate per cm3");
+    fTallyCmd->SetGuidance("  dose     flux and the dose (/nessa/dose/quantity)");
+    fTallyCmd->SetParameterName("response", false);
+    
+    fImportanceCmd = new G4UIcmdWithAString("/nessa/cell/importance", this);
+    fImportanceCmd->SetGuidance("Importance of a cell: cell impN [impG] (impG = impN if");
+    fImportanceCmd->SetGuidance("omitted). Tracks are split or rouletted by the ratio of");
+    fImportanceCmd->SetGuidance("importances when they cross into another cell; 0 kills.");
+    fImportanceCmd->SetGuidance("Unlisted cells have importance 1.");
+    fImportanceCmd->SetParameterName("params", false);
+    
+    fImportanceFileCmd = new G4UIcmdWithAString("/nessa/cell/importanceFile", this);
+    fImportanceFileCmd->SetGuidance("Read importances from a table, one cell per line:");
+    fImportanceFileCmd->SetGuidance("  cell impN [impG]      ('#' starts a comment)");
+    fImportanceFileCmd->SetParameterName("file", false);
+    
+    fClearImportancesCmd = new G4UIcmdWithoutParameter("/nessa/cell/clearImportances", this);
+    fClearImportancesCmd->SetGuidance("Back to an analog run (all importances 1)");
+    
+    fListCmd = new G4UIcmdWithoutParameter("/nessa/cell/list", this);
+    fListCmd->SetGuidance("Show the cell tally setting and the listed importances");
+}
+
+NESSACellMessenger::~NESSACellMessenger()
+{
+    delete fTallyCmd; delete fImportanceCmd; delete fImportanceFileCmd;
+    delete fClearImportancesCmd; delete fListCmd; delete fCellDir;
+}
+
+void NESSACellMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
+{
+    auto& config = NESSACellConfig::Instance();
+    
+    if (cmd == fTallyCmd) {
+        if (val == "off")          config.SetResponse(NESSACellConfig::kOff);
+        else if (val == "flux")    config.SetResponse(NESSACellConfig::kFlux);
+        else if (val == "capture") config.SetResponse(NESSACellConfig::kCapture);
+        else if (val == "dose")    config.SetResponse(NESSACellConfig::kDose);
+        else {
+            G4Exception("NESSACellMessenger::SetNewValue", "Cell003", JustWarning,
+                ("Usage: tally off|flux|capture|dose, got: " + val).c_str());
+        }
+    }
+    else if (cmd == fImportanceCmd) {
+        std::istringstream iss(val);
+        G4int cell = -1;
+        G4double neutron = -1., photon = -1.;
+        iss >> cell >> neutron;
+        G4bool ok = !iss.fail();
+        if (!(iss >> photon)) photon = neutron;
+        if (!ok || cell < 0 || neutron < 0. || photon < 0.) {
+            G4Exception("NESSACellMessenger::SetNewValue", "Cell005", JustWarning,
+                ("Usage: importance cell impN [impG] (>= 0), got: " + val).c_str());
+            return;
+        }
+        config.SetImportance(cell, neutron, photon);
+    }
+    else if (cmd == fImportanceFileCmd) {
+        std::ifstream in(val);
+        if (!in.is_open()) {
+            G4Exception("NESSACellMessenger::SetNewValue", "Cell006", JustWarning,
+                ("Cannot open importance table " + val).c_str());
+            return;
+        }
+        G4int nRead = 0, lineNo = 0;
+        std::string line;
+        while (std::getline(in, line)) {
+            lineNo++;
+            auto hash = line.find('#');
+            if (hash != std::string::npos) line.erase(hash);
+            std::istringstream ls(line);
+            G4int cell;
+            G4double neutron, photon;
+            if (!(ls >> cell)) continue;  // blank or comment
+            if (!(ls >> neutron) || cell < 0 || neutron < 0.) {
+                G4Exception("NESSACellMessenger::SetNewValue", "Cell005", JustWarning,
+                    (val + ":" + std::to_string(lineNo) + ": expected cell impN [impG]").c_str());
+                continue;
+            }
+            if (!(ls >> photon) || photon < 0.) photon = neutron;
+            config.SetImportance(cell, neutron, photon);
+            nRead++;
+        }
+        G4cout << "Read " << nRead << " cell importances from " << val << G4endl;
+    }
+    else if (cmd == fClearImportancesCmd) {
+        config.ClearImportances();
+    }
+    else if (cmd == fListCmd) {
+        G4cout << "\n=== NESSA Cell Settings ===" << G4endl;
+        G4cout << "  Cell tally: " << NESSACellConfig::ResponseName(config.GetResponse())
+               << G4endl;
+        if (config.GetImportances().empty())
+            G4cout << "  Importances: none (analog)" << G4endl;
+        for (const auto& entry : config.GetImportances()) {
+            G4cout << "  cell " << entry.first << "  imp:n " << entry.second[0]
+                   << "  imp:p " << entry.second[1] << G4endl;
+        }
+    }
+}
@@ -0,0 +1,203 @@
+#include "NESSACellTally.hh"
+#include "NESSATallyStats.hh"
+#include "NESSADoseConversion.hh"
+#include "NESSAProfiler.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4Neutron.hh"
+#include "G4Gamma.hh"
+#include "G4Material.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4VSolid.hh"
+#include "G4HadronicProcessStore.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4ios.hh"
+#include "globals.hh"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+NESSACellTally::NESSACellTally(const G4String& name)
+    : G4VAccumulable(name),
+      fNeutron(G4Neutron::Definition()),
+      fGamma(G4Gamma::Definition()) {}
+
+void NESSACellTally::SetUp(NESSACellConfig::Response response)
+{
+    fResponse = response;
+    fCells.clear();
+    fSlot.clear();
+    if (response != NESSACellConfig::kOff) {
+        // Placements in copy-number order; replicas and parameterised
+        // volumes have no fixed copy number and are not cells
+        for (const auto* pv : *G4PhysicalVolumeStore::GetInstance()) {
+            if (pv->IsReplicated() || pv->GetCopyNo() < 0) continue;
+            fCells.push_back({pv->GetCopyNo(), pv});
+        }
+        std::sort(fCells.begin(), fCells.end(),
+                  [](const Cell& a, const Cell& b) { return a.copyNo < b.copyNo; });
+        if (!fCells.empty()) fSlot.assign(fCells.back().copyNo + 1, -1);
+        for (G4int i = 0; i < (G4int)fCells.size(); i++) {
+            G4int& slot = fSlot[fCells[i].copyNo];
+            if (slot >= 0) {
+                G4Exception("NESSACellTally::SetUp", "Cell001", JustWarning,
+                    ("Copy number " + std::to_string(fCells[i].copyNo) + " of "
+                     + fCells[i].volume->GetName() + " already used by "
+                     + fCells[slot].volume->GetName() + ": scored together").c_str());
+                continue;
+            }
+            slot = i;
+        }
+    }
+    fXSMaterial = nullptr;
+    fXSEnergy = -1.;
+    Reset();
+}
+
+G4double NESSACellTally::CaptureXS(const G4Material* material, G4double energy)
+{
+    if (material != fXSMaterial || energy != fXSEnergy) {
+        fXS = G4HadronicProcessStore::Instance()->GetCaptureCrossSectionPerVolume(
+                  fNeutron, energy, material) * cm;
+        fXSMaterial = material;
+        fXSEnergy = energy;
+    }
+    return fXS;
+}
+
+void NESSACellTally::ScoreStep(const G4Step* step)
+{
+    NESSA_PROFILE(kCellTally);
+    
+    const auto* def = step->GetTrack()->GetDefinition();
+    const G4int particle = (def == fNeutron) ? 0 : (def == fGamma) ? 1 : -1;
+    if (particle < 0) return;
+    const G4double length = step->GetStepLength();
+    if (length <= 0.) return;
+    
+    const auto* pre = step->GetPreStepPoint();
+    const G4int copyNo = pre->GetTouchable()->GetCopyNumber();
+    if (copyNo < 0 || copyNo >= (G4int)fSlot.size()) return;
+    const G4int slot = fSlot[copyNo];
+    if (slot < 0) return;
+    
+    // Track length [cm]; divided by the cell volume at output
+    const G4double x = pre->GetWeight() * length / cm;
+    const G4int bin = 4 * slot + particle;
+    Add(bin, x);
+    
+    if (fResponse == NESSACellConfig::kCapture) {
+        if (particle != 0) return;
+        G4double xs = CaptureXS(pre->GetMaterial(), pre->GetKineticEnergy());
+        if (xs > 0.) Add(bin + 2, x * xs);
+    }
+    else if (fResponse == NESSACellConfig::kDose) {
+        G4double c = NESSADoseConversion::Instance().Coefficient(
+                         particle, pre->GetKineticEnergy() / MeV);
+        if (c > 0.) Add(bin + 2, x * c);
+    }
+}
+
+void NESSACellTally::EndOfHistory()
+{
+    for (G4int bin : fTouched) {
+        G4double x = fHistory[bin];
+        fSum[bin] += x;
+        fSum2[bin] += x * x;
+        fHistory[bin] = 0.;
+    }
+    fTouched.clear();
+}
+
+void NESSACellTally::Merge(const G4VAccumulable& other)
+{
+    const auto& o = static_cast<const NESSACellTally&>(other);
+    if (o.fSum.size() != fSum.size()) return;
+    for (std::size_t bin = 0; bin < fSum.size(); bin++) {
+        fSum[bin] += o.fSum[bin];
+        fSum2[bin] += o.fSum2[bin];
+    }
+}
+
+void NESSACellTally::Reset()
+{
+    fSum.assign(4 * fCells.size(), 0.);
+    fSum2.assign(4 * fCells.size(), 0.);
+    fHistory.assign(4 * fCells.size(), 0.);
+    fTouched.clear();
+}
+
+G4double NESSACellTally::CellVolume(const G4VPhysicalVolume* pv)
+{
+    // Boolean solids estimate their volume by sampling on first use
+    // (cached by the solid), so this is done at output only
+    const auto* lv = pv->GetLogicalVolume();
+    G4double volume = lv->GetSolid()->GetCubicVolume();
+    for (std::size_t i = 0; i < lv->GetNoDaughters(); i++)
+        volume -= lv->GetDaughter(i)->GetLogicalVolume()->GetSolid()->GetCubicVolume();
+    return volume / cm3;
+}
+
+void NESSACellTally::Write(const G4String& outputFile, G4double nEvents) const
+{
+    if (fCells.empty() || nEvents <= 0) return;
+    
+    G4String base = outputFile;
+    auto dot = base.rfind('.');
+    auto slash = base.rfind('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        base = base.substr(0, dot);
+    G4String file = base + "_cells.dat";
+    std::ofstream out(file);
+    if (!out.is_open()) {
+        G4Exception("NESSACellTally::Write", "Cell002", JustWarning,
+            ("Cannot write " + file).c_str());
+        return;
+    }
+    
+    const G4bool reaction = (fResponse == NESSACellConfig::kCapture ||
+                             fResponse == NESSACellConfig::kDose);
+    const char* unit = (fResponse == NESSACellConfig::kCapture) ? "1/cm3" : "pSv";
+    out << "# NESSA cell tally: " << (G4long)nEvents << " histories, per source particle\n"
+        << "# flux [1/cm2] = weighted track length / cell volume";
+    if (reaction)
+        out << "; " << NESSACellConfig::ResponseName(fResponse) << " [" << unit << "]";
+    out << "\n# R = relative error (1 = not scored)\n"
+        << "# cell  volume_cm3  material  n_flux  R  g_flux  R";
+    if (reaction) out << "  n_" << NESSACellConfig::ResponseName(fResponse) << "  R  g_"
+                      << NESSACellConfig::ResponseName(fResponse) << "  R";
+    out << "  name\n";
+    
+    G4int nScored = 0;
+    for (G4int slot = 0; slot < (G4int)fCells.size(); slot++) {
+        const auto& cell = fCells[slot];
+        if (fSlot[cell.copyNo] != slot) continue;  // duplicate copy number
+        const G4double volume = CellVolume(cell.volume);
+        const auto* material = cell.volume->GetLogicalVolume()->GetMaterial();
+        out << std::setw(6) << cell.copyNo << "  " << std::scientific
+            << std::setprecision(4) << volume << "  " << std::setw(18) << std::left
+            << (material ? material->GetName() : G4String("-")) << std::right;
+        G4bool scored = false;
+        for (G4int r = 0; r < (reaction ? 2 : 1); r++) {
+            for (G4int p = 0; p < 2; p++) {
+                const G4int bin = 4 * slot + 2 * r + p;
+                G4double mean, relErr;
+                NESSATallyStats::MeanAndError(fSum[bin], fSum2[bin], nEvents, mean, relErr);
+                if (volume > 0.) mean /= volume;
+                if (fSum[bin] <= 0.) relErr = 1.;
+                scored = scored || fSum[bin] > 0.;
+                out << "  " << std::setprecision(4) << mean << "  "
+                    << std::fixed << std::setprecision(4) << relErr << std::scientific;
+            }
+        }
+        out << "  " << cell.volume->GetName() << "\n";
+        nScored += scored;
+    }
+    
+    G4cout << "  Cell tally:        " << file << " (" << nScored << "/"
+           << fCells.size() << " cells scored)" << G4endl;
+}
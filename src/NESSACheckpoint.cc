@@ -0,0 +1,148 @@
+#include "NESSACheckpoint.hh"
+
+#include "G4AnalysisManager.hh"
+#include "G4ios.hh"
+#include "Randomize.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+
+G4bool NESSACheckpoint::Write(const G4String& file, G4int eventsTotal, G4int runID,
+                              const Precision& precision, const NESSARunSummary& state)
+{
+    G4String tmp = file + ".tmp";
+    std::ofstream out(tmp);
+    if (!out.is_open()) {
+        G4cerr << "ERROR: Cannot write checkpoint: " << tmp << G4endl;
+        return false;
+    }
+    
+    out << "# NESSA checkpoint\n";
+    out << "EVENTS_TOTAL " << eventsTotal << "\n";
+    out << "RUN_ID " << runID << "\n";
+    if (precision.relErr > 0.) {
+        out << "PRECISION " << precision.detector << " " << precision.relErr << " "
+            << precision.maxTime << "\n";
+    }
+    state.Write(out);
+    
+    // H1 bin contents, offset 0 = underflow, nbins+1 = overflow
+    out << "# H1 id offset entries Sw Sw2 Sxw Sx2w\n";
+    out << std::setprecision(std::numeric_limits<G4double>::max_digits10);
+    auto am = G4AnalysisManager::Instance();
+    G4int first = am->GetFirstH1Id();
+    for (G4int id = first; id < first + am->GetNofH1s(); id++) {
+        auto* h = am->GetH1(id, false, false);
+        if (!h) continue;
+        unsigned int nOffsets = h->axis().bins() + 2;
+        for (unsigned int off = 0; off < nOffsets; off++) {
+            unsigned int entries;
+            G4double sw, sw2, sxw, sx2w;
+            h->get_bin_content(off, entries, sw, sw2, sxw, sx2w);
+            if (entries == 0) continue;
+            out << "H1 " << id << " " << off << " " << entries << " "
+                << sw << " " << sw2 << " " << sxw << " " << sx2w << "\n";
+        }
+    }
+    
+    // H2 bin contents by x and y bin, 0 = underflow, nbins+1 = overflow
+    out << "# H2 id ix iy entries Sw Sw2 Sxw Sx2w Syw Sy2w\n";
+    first = am->GetFirstH2Id();
+    for (G4int id = first; id < first + am->GetNofH2s(); id++) {
+        auto* h = am->GetH2(id, false, false);
+        if (!h) continue;
+        unsigned int nx = h->axis_x().bins() + 2, ny = h->axis_y().bins() + 2;
+        for (unsigned int iy = 0; iy < ny; iy++) {
+            for (unsigned int ix = 0; ix < nx; ix++) {
+                unsigned int entries;
+                G4double sw, sw2, sxw, sx2w, syw, sy2w;
+                h->get_bin_content(ix, iy, entries, sw, sw2, sxw, sx2w, syw, sy2w);
+                if (entries == 0) continue;
+                out << "H2 " << id << " " << ix << " " << iy << " " << entries << " "
+                    << sw << " " << sw2 << " " << sxw << " " << sx2w << " "
+                    << syw << " " << sy2w << "\n";
+            }
+        }
+    }
+    out.close();
+    if (!out) {
+        G4cerr << "ERROR: Checkpoint write failed: " << tmp << G4endl;
+        return false;
+    }
+    
+    G4String rndm = file + ".rndm";
+    G4Random::getTheEngine()->saveStatus((rndm + ".tmp").c_str());
+    
+    return std::rename(tmp.c_str(), file.c_str()) == 0 &&
+           std::rename((rndm + ".tmp").c_str(), rndm.c_str()) == 0;
+}
+
+G4bool NESSACheckpoint::Read(const G4String& file, G4int& eventsTotal, G4int& runID,
+                             Precision& precision, NESSARunSummary& state)
+{
+    std::ifstream in(file);
+    if (!in.is_open()) {
+        G4cerr << "ERROR: Cannot open checkpoint: " << file << G4endl;
+        return false;
+    }
+    state.Read(in);
+    
+    in.clear();
+    in.seekg(0);
+    eventsTotal = 0;
+    runID = -1;
+    precision = Precision();
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 13, "EVENTS_TOTAL ") == 0) {
+            eventsTotal = std::stoi(line.substr(13));
+        } else if (line.compare(0, 7, "RUN_ID ") == 0) {
+            runID = std::stoi(line.substr(7));
+        } else if (line.compare(0, 10, "PRECISION ") == 0) {
+            std::istringstream iss(line.substr(10));
+            iss >> precision.detector >> precision.relErr >> precision.maxTime;
+            if (iss.fail()) precision = Precision();
+        } else if (line.compare(0, 1, "#") != 0 && eventsTotal > 0) {
+            break;
+        }
+    }
+    return eventsTotal > 0;
+}
+
+G4bool NESSACheckpoint::RestoreHistogramsAndEngine(const G4String& file)
+{
+    std::ifstream in(file);
+    if (!in.is_open()) return false;
+    
+    auto am = G4AnalysisManager::Instance();
+    std::string line;
+    while (std::getline(in, line)) {
+        const G4bool isH1 = line.compare(0, 3, "H1 ") == 0;
+        if (!isH1 && line.compare(0, 3, "H2 ") != 0) continue;
+        std::istringstream iss(line.substr(3));
+        G4int id;
+        unsigned int off, iy = 0, entries;
+        G4double sw, sw2, sxw, sx2w, syw = 0., sy2w = 0.;
+        G4bool ok;
+        if (isH1) {
+            iss >> id >> off >> entries >> sw >> sw2 >> sxw >> sx2w;
+            auto* h = am->GetH1(id, false, false);
+            ok = h && h->set_bin_content(off, entries, sw, sw2, sxw, sx2w);
+        } else {
+            iss >> id >> off >> iy >> entries >> sw >> sw2 >> sxw >> sx2w >> syw >> sy2w;
+            auto* h = am->GetH2(id, false, false);
+            ok = h && h->set_bin_content(off, iy, entries, sw, sw2, sxw, sx2w, syw, sy2w);
+        }
+        if (!ok) {
+            G4cerr << "ERROR: Checkpoint " << line.substr(0, 2) << " " << id
+                   << " does not match the booked histograms" << G4endl;
+            return false;
+        }
+    }
+    
+    G4Random::getTheEngine()->restoreStatus((file + ".rndm").c_str());
+    return true;
+}
@@ -24,6 +24,7 @@
 #include "G4VisAttributes.hh"
 #include "G4Colour.hh"
 #include "G4SDManager.hh"
+#include "G4Threading.hh"
 
 static NESSADetectorMessenger* gMessenger = nullptr;
 
@@ -145,7 +146,9 @@ void NESSADetectorConstruction::DefineMaterials()
 
 G4VPhysicalVolume* NESSADetectorConstruction::Construct()
 {
-    DefineMaterials();
+    // Construct() runs again after a detector layout change
+    // (NESSADetectorMessenger); materials outlive the geometry.
+    if (fMaterials.empty()) DefineMaterials();
     
     // World volume (96m x 96m x 96m)
     G4double worldHalf = 4800.0*cm;
@@ -158,6 +161,7 @@ G4VPhysicalVolume* NESSADetectorConstruction::Construct()
         worldLogical, "World", 0, false, 0);
     
     ConstructBunkerGeometry(worldLogical);
+    ConstructScoringVolumes();
     ApplyVisAttributes();
     
     G4cout << "*** NESSA geometry construction complete ***" << G4endl;
@@ -2202,46 +2206,73 @@ void NESSADetectorConstruction::ApplyVisAttributes()
     }
 }
 
-void NESSADetectorConstruction::ConstructSDandField()
+void NESSADetectorConstruction::ConstructScoringVolumes()
 {
-    auto* scoringSD = new NESSAScoringSD("ScoringSD");
-    G4SDManager::GetSDMpointer()->AddNewDetector(scoringSD);
-    
+    // Geometry is built once on the master and shared read-only by the
+    // workers, so the scoring spheres must be placed here and not in
+    // ConstructSDandField (which runs on every thread).
     const auto& pts = NESSAScoringConfig::Instance().GetPoints();
     
     for (G4int i = 0; i < (G4int)pts.size(); i++) {
         const auto& pt = pts[i];
+        if (!pt.active || pt.mcnpCell > 0) continue;
+        
+        // Create new scoring sphere
+        auto* solid = new G4Orb("score_" + pt.name, pt.radius*cm);
+        auto* lv = new G4LogicalVolume(solid, fMaterials[2], "score_" + pt.name);
+        
+        auto* detVis = new G4VisAttributes(G4Colour(1, 0, 0, 0.9));
+        detVis->SetForceSolid(true);
+        lv->SetVisAttributes(detVis);
+        
+        new G4PVPlacement(0,
+            G4ThreeVector(pt.x*cm, pt.y*cm, pt.z*cm),
+            lv, "phys_score_" + pt.name,
+            fWorldLogical, false, 90000 + i, false);
+        
+        G4cout << "SD: Created " << pt.name
+               << " at (" << pt.x << "," << pt.y << "," << pt.z << ") r="
+               << pt.radius << " cm" << G4endl;
+    }
+}
+
+void NESSADetectorConstruction::ConstructSDandField()
+{
+    // Called on every worker thread: one SD instance per thread, kept
+    // across geometry rebuilds (SD names must be unique)
+    auto* sdManager = G4SDManager::GetSDMpointer();
+    auto* scoringSD = dynamic_cast<NESSAScoringSD*>(
+        sdManager->FindSensitiveDetector("ScoringSD", false));
+    if (scoringSD) {
+        scoringSD->Reconfigure();
+    } else {
+        scoringSD = new NESSAScoringSD("ScoringSD");
+        sdManager->AddNewDetector(scoringSD);
+    }
+    
+    // Resolve each detector's logical volume once and hand its index to the
+    // SD, so ProcessHits never looks anything up by name
+    auto* lvStore = G4LogicalVolumeStore::GetInstance();
+    const auto& pts = NESSAScoringConfig::Instance().GetPoints();
+    G4int index = 0;
+    
+    for (const auto& pt : pts) {
         if (!pt.active) continue;
         
-        if (pt.mcnpCell > 0) {
-            // Attach to existing MCNP cell volume
-            G4String logName = "logic_c" + std::to_string(pt.mcnpCell);
-            auto* store = G4LogicalVolumeStore::GetInstance();
-            for (auto* lv : *store) {
-                if (lv->GetName() == logName) {
-                    lv->SetSensitiveDetector(scoringSD);
-                    G4cout << "SD: " << pt.name << " -> " << logName << G4endl;
-                    break;
-                }
-            }
-        } else {
-            // Create new scoring sphere
-            auto* solid = new G4Orb("score_" + pt.name, pt.radius*cm);
-            auto* lv = new G4LogicalVolume(solid, fMaterials[2], "score_" + pt.name);
-            lv->SetSensitiveDetector(scoringSD);
-            
-            auto* detVis = new G4VisAttributes(G4Colour(1, 0, 0, 0.9));
-            detVis->SetForceSolid(true);
-            lv->SetVisAttributes(detVis);
-            
-            new G4PVPlacement(0,
-                G4ThreeVector(pt.x*cm, pt.y*cm, pt.z*cm),
-                lv, "phys_score_" + pt.name,
-                fWorldLogical, false, 90000 + i, false);
-            
-            G4cout << "SD: Created " << pt.name
-                   << " at (" << pt.x << "," << pt.y << "," << pt.z << ") r="
-                   << pt.radius << " cm" << G4endl;
+        G4String logName = (pt.mcnpCell > 0)
+            ? G4String("logic_c" + std::to_string(pt.mcnpCell))
+            : G4String("score_" + pt.name);
+        auto* lv = lvStore->GetVolume(logName, false);
+        if (!lv) {
+            G4Exception("NESSADetectorConstruction::ConstructSDandField",
+                "SD001", JustWarning,
+                ("No volume " + logName + " for detector " + pt.name).c_str());
+            index++;
+            continue;
         }
+        SetSensitiveDetector(lv, scoringSD);
+        scoringSD->AttachVolume(lv, index++);
+        if (pt.mcnpCell > 0 && G4Threading::IsMasterThread())
+            G4cout << "SD: " << pt.name << " -> " << logName << G4endl;
     }
 }
@@ -1,11 +1,15 @@
 #include "NESSADetectorMessenger.hh"
 #include "NESSAScoringConfig.hh"
 #include "G4UImanager.hh"
+#include "G4RunManager.hh"
+#include "G4StateManager.hh"
 #include <sstream>
 
 NESSADetectorMessenger::NESSADetectorMessenger()
 {
-    fNessaDir = new G4UIdirectory("/nessa/");
+    // Not broadcast: the configuration is a shared singleton, and the
+    // messenger only exists on the master thread.
+    fNessaDir = new G4UIdirectory("/nessa/", false);
     fNessaDir->SetGuidance("NESSA simulation control");
     
     fDetDir = new G4UIdirectory("/nessa/detector/");
@@ -27,6 +31,34 @@ NESSADetectorMessenger::NESSADetectorMessenger()
     fDisableCmd->SetGuidance("Disable detector by name");
     fDisableCmd->SetParameterName("name", false);
     
+    fNextEventCmd = new G4UIcmdWithAString("/nessa/detector/nextEvent", this);
+    fNextEventCmd->SetGuidance("Score a detector (or all) with the next-event point");
+    fNextEventCmd->SetGuidance("estimator as well: name|all [true|false]. Flux at the");
+    fNextEventCmd->SetGuidance("centre from every source emission and collision, for");
+    fNextEventCmd->SetGuidance("distant points that tracks rarely reach.");
+    fNextEventCmd->SetParameterName("params", false);
+    
+    fBinningCmd = new G4UIcmdWithAString("/nessa/detector/binning", this);
+    fBinningCmd->SetGuidance("Spectrum energy bins of a detector (or all): name|all n|g spec");
+    fBinningCmd->SetGuidance("  lin n Emin Emax | log n Emin Emax (MeV)");
+    fBinningCmd->SetGuidance("  sand2 (620 groups) | sand2-640 | file path (edges, MeV)");
+    fBinningCmd->SetGuidance("No spec: the default, n log 300 1e-11 20 and g lin 200 0 10");
+    fBinningCmd->SetParameterName("params", false);
+    
+    fTimeBinsCmd = new G4UIcmdWithAString("/nessa/detector/timeBins", this);
+    fTimeBinsCmd->SetGuidance("Time tallies of a detector (or all): name|all nTime tMin tMax [nEnergy]");
+    fTimeBinsCmd->SetGuidance("nTime log bins of the global time from tMin to tMax [s], and an");
+    fTimeBinsCmd->SetGuidance("energy x time array with nEnergy log energy bins (default 20).");
+    fTimeBinsCmd->SetGuidance("nTime = 0 turns them off.");
+    fTimeBinsCmd->SetParameterName("params", false);
+    
+    fTimeCutoffCmd = new G4UIcmdWithAString("/nessa/detector/timeCutoff", this);
+    fTimeCutoffCmd->SetGuidance("Kill all tracks after the last time bin of the active");
+    fTimeCutoffCmd->SetGuidance("detectors (saves the CPU of late, unscored transport;");
+    fTimeCutoffCmd->SetGuidance("activation after that time is not counted)");
+    fTimeCutoffCmd->SetParameterName("on", true);
+    fTimeCutoffCmd->SetDefaultValue("true");
+    
     fListCmd = new G4UIcmdWithoutParameter("/nessa/detector/list", this);
     fListCmd->SetGuidance("List all configured detectors");
 }
@@ -34,10 +66,21 @@ NESSADetectorMessenger::NESSADetectorMessenger()
 NESSADetectorMessenger::~NESSADetectorMessenger()
 {
     delete fAddCmd; delete fRemoveCmd;
-    delete fEnableCmd; delete fDisableCmd;
+    delete fEnableCmd; delete fDisableCmd; delete fNextEventCmd; delete fBinningCmd;
+    delete fTimeBinsCmd; delete fTimeCutoffCmd;
     delete fListCmd; delete fDetDir; delete fNessaDir;
 }
 
+/// Layout changes after /run/initialize: rebuild the geometry (scoring
+/// spheres, SD attachment) at the next beamOn. Physics tables and the
+/// neutron HP data stay loaded; histograms are rebooked by NESSARunAction.
+static void RequestGeometryRebuild()
+{
+    if (G4StateManager::GetStateManager()->GetCurrentState() != G4State_Idle)
+        return;
+    G4RunManager::GetRunManager()->ReinitializeGeometry(true);
+}
+
 void NESSADetectorMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
 {
     auto& config = NESSAScoringConfig::Instance();
@@ -50,18 +93,78 @@ void NESSADetectorMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
         config.AddDetector(name, x, y, z, r);
         G4cout << "Added detector: " << name
                << " at (" << x << "," << y << "," << z << ") r=" << r << " cm" << G4endl;
+        RequestGeometryRebuild();
     }
     else if (cmd == fRemoveCmd) {
         config.RemoveDetector(val);
         G4cout << "Removed detector: " << val << G4endl;
+        RequestGeometryRebuild();
     }
     else if (cmd == fEnableCmd) {
         config.SetActive(val, true);
         G4cout << "Enabled: " << val << G4endl;
+        RequestGeometryRebuild();
     }
     else if (cmd == fDisableCmd) {
         config.SetActive(val, false);
         G4cout << "Disabled: " << val << G4endl;
+        RequestGeometryRebuild();
+    }
+    else if (cmd == fNextEventCmd) {
+        // No geometry change: the estimator picks this up at the next run
+        std::istringstream iss(val);
+        G4String name, flag = "true";
+        iss >> name >> flag;
+        G4bool on = G4UIcommand::ConvertToBool(flag);
+        config.SetNextEvent(name, on);
+        G4cout << "Next-event estimator " << (on ? "on" : "off")
+               << ": " << name << G4endl;
+    }
+    else if (cmd == fBinningCmd) {
+        // No geometry change: the histograms are rebinned at the next run
+        std::istringstream iss(val);
+        G4String name, particle, spec;
+        iss >> name >> particle;
+        std::getline(iss >> std::ws, spec);
+        std::vector<G4double> edges;
+        G4String error;
+        if ((particle != "n" && particle != "g") ||
+            (!spec.empty() && !NESSAEnergyBinning::MakeEdges(spec, edges, error))) {
+            G4Exception("NESSADetectorMessenger::SetNewValue", "Binning001", JustWarning,
+                ("Usage: binning name|all n|g spec; " + error).c_str());
+            return;
+        }
+        config.SetBinning(name, particle == "n" ? 0 : 1, spec);
+        G4cout << "Binning " << particle << " " << name << ": "
+               << (spec.empty() ? "default" : spec);
+        if (!edges.empty()) G4cout << " (" << edges.size() - 1 << " bins)";
+        G4cout << G4endl;
+    }
+    else if (cmd == fTimeBinsCmd) {
+        std::istringstream iss(val);
+        G4String name;
+        G4int nTime = -1, nEnergy = 20;
+        G4double tMin = 0., tMax = 0.;
+        iss >> name >> nTime;
+        if (nTime > 0) iss >> tMin >> tMax;
+        G4bool ok = !iss.fail();
+        iss >> nEnergy;
+        if (!ok || nTime < 0 || (nTime > 0 && (tMin <= 0. || tMax <= tMin)) || nEnergy < 1) {
+            G4Exception("NESSADetectorMessenger::SetNewValue", "Binning003", JustWarning,
+                ("Usage: timeBins name|all nTime tMin tMax [nEnergy] (s, 0 < tMin < tMax),"
+                 " got: " + val).c_str());
+            return;
+        }
+        config.SetTimeBinning(name, nTime, tMin, tMax, nEnergy);
+        if (nTime == 0) G4cout << "Time tallies off: " << name << G4endl;
+        else G4cout << "Time tallies " << name << ": " << nTime << " bins "
+                    << tMin << "-" << tMax << " s x " << nEnergy << " energy bins"
+                    << G4endl;
+    }
+    else if (cmd == fTimeCutoffCmd) {
+        G4bool on = G4UIcommand::ConvertToBool(val);
+        config.SetTimeCutoff(on);
+        G4cout << "Time cutoff " << (on ? "on" : "off") << G4endl;
     }
     else if (cmd == fListCmd) {
         const auto& pts = config.GetPoints();
@@ -75,7 +178,17 @@ void NESSADetectorMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
                    << "  (" << p.x << ", " << p.y << ", " << p.z << ") cm"
                    << "  r=" << p.radius << " cm"
                    << (p.mcnpCell > 0 ? "  [MCNP " + std::to_string(p.mcnpCell) + "]" : "")
+                   << (p.nextEvent ? "  [F5]" : "")
                    << G4endl;
+            for (G4int part = 0; part < 2; part++) {
+                if (p.binning[part].empty()) continue;
+                G4cout << "      " << (part == 0 ? "n" : "g") << " bins: "
+                       << p.binning[part] << G4endl;
+            }
+            if (!p.timeBinning.empty()) {
+                G4cout << "      time bins [s]: " << p.timeBinning << " x "
+                       << p.timeEnergyBins << " energy bins" << G4endl;
+            }
         }
         G4cout << "Active: " << config.GetNActive() << "/" << pts.size() << G4endl;
     }
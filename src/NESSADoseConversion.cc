@@ -0,0 +1,140 @@
+#include "NESSADoseConversion.hh"
+
+#include "G4ios.hh"
+#include "globals.hh"
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    
+// Resampled grid size: ~200 points per decade over the neutron range,
+// well below the interpolation differences between table points
+const G4int kGridPoints = 2048;
+    
+}  // namespace
+
+NESSADoseConversion& NESSADoseConversion::Instance()
+{
+    static NESSADoseConversion instance;
+    return instance;
+}
+
+NESSADoseConversion::NESSADoseConversion()
+{
+    Load("data/dose_coefficients.dat");
+    Select("H10");
+}
+
+void NESSADoseConversion::Load(const G4String& filename)
+{
+    std::ifstream infile(filename);
+    if (!infile.is_open()) {
+        infile.open("../" + filename);
+        if (!infile.is_open()) {
+            G4Exception("NESSADoseConversion::Load", "Dose001", JustWarning,
+                ("Cannot find " + filename + ": dose tallies will be zero").c_str());
+            return;
+        }
+    }
+    
+    std::string line;
+    std::string quantity;
+    G4int particle = -1;
+    std::vector<std::pair<G4double, G4double>> points;
+    while (std::getline(infile, line)) {
+        if (line.empty() || line[0] == '#') continue;
+    
+        std::istringstream iss(line);
+        std::string keyword;
+        iss >> keyword;
+    
+        if (keyword == "TABLE") {
+            std::string part;
+            iss >> quantity >> part;
+            particle = (part == "n") ? 0 : (part == "g") ? 1 : -1;
+            points.clear();
+        }
+        else if (keyword == "END") {
+            if (particle >= 0 && !points.empty())
+                fTables[{quantity, particle}].Build(points);
+            particle = -1;
+        }
+        else if (particle >= 0) {
+            G4double e = std::stod(keyword), h = 0.;
+            iss >> h;
+            if (e > 0.) points.emplace_back(e, h);
+        }
+    }
+    
+    G4cout << "Loaded " << fTables.size() << " dose conversion tables from "
+           << filename << G4endl;
+}
+
+G4bool NESSADoseConversion::Select(const G4String& quantity)
+{
+    const Table* active[2] = {nullptr, nullptr};
+    for (G4int particle = 0; particle < 2; particle++) {
+        auto it = fTables.find({quantity, particle});
+        if (it != fTables.end()) active[particle] = &it->second;
+    }
+    if (!active[0] && !active[1]) return false;
+    
+    fActive[0] = active[0];
+    fActive[1] = active[1];
+    fQuantity = quantity;
+    return true;
+}
+
+std::vector<G4String> NESSADoseConversion::GetQuantities() const
+{
+    std::vector<G4String> names;
+    for (const auto& [key, table] : fTables) {
+        if (names.empty() || names.back() != key.first) names.push_back(key.first);
+    }
+    return names;
+}
+
+void NESSADoseConversion::Table::Build(
+    const std::vector<std::pair<G4double, G4double>>& points)
+{
+    const size_t n = points.size();
+    logEmin = std::log(points.front().first);
+    const G4double logEmax = std::log(points.back().first);
+    if (n == 1 || logEmax <= logEmin) {
+        values.assign(1, points.front().second);
+        invStep = 0.;
+        return;
+    }
+    
+    // Coefficients are close to power laws between table points, so the
+    // fine grid is filled by log-log interpolation
+    invStep = (kGridPoints - 1) / (logEmax - logEmin);
+    values.resize(kGridPoints);
+    size_t j = 0;
+    for (G4int i = 0; i < kGridPoints; i++) {
+        G4double logE = logEmin + i / invStep;
+        while (j + 2 < n && std::log(points[j+1].first) < logE) j++;
+        G4double l0 = std::log(points[j].first);
+        G4double l1 = std::log(points[j+1].first);
+        G4double f = std::min(1., std::max(0., (logE - l0) / (l1 - l0)));
+        G4double h0 = points[j].second, h1 = points[j+1].second;
+        values[i] = (h0 > 0. && h1 > 0.)
+                  ? std::exp((1. - f) * std::log(h0) + f * std::log(h1))
+                  : (1. - f) * h0 + f * h1;
+    }
+}
+
+G4double NESSADoseConversion::Table::Lookup(G4double energyMeV) const
+{
+    if (values.size() == 1) return values.front();
+    
+    G4double u = (std::log(energyMeV) - logEmin) * invStep;
+    if (!(u > 0.)) return values.front();  // also E = 0
+    const G4int last = (G4int)values.size() - 1;
+    if (u >= last) return values.back();
+    G4int i = (G4int)u;
+    G4double f = u - i;
+    return values[i] + f * (values[i+1] - values[i]);
+}
@@ -0,0 +1,187 @@
+#include "NESSAEnergyBinning.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+const char* const NESSAEnergyBinning::kDefaultNeutron = "log 300 1e-11 20";
+const char* const NESSAEnergyBinning::kDefaultPhoton  = "lin 200 0 10";
+
+G4bool NESSAEnergyBinning::MakeEdges(const G4String& spec,
+                                     std::vector<G4double>& edges, G4String& error)
+{
+    std::istringstream iss(spec);
+    std::string scheme;
+    iss >> scheme;
+    edges.clear();
+    
+    if (scheme == "lin" || scheme == "log") {
+        G4int n = 0;
+        G4double lo = 0., hi = 0.;
+        iss >> n >> lo >> hi;
+        if (iss.fail() || n < 1 || hi <= lo || (scheme == "log" && lo <= 0.)) {
+            error = "expected " + scheme + " n Emin Emax (MeV, Emin < Emax"
+                  + (scheme == "log" ? ", Emin > 0)" : ")");
+            return false;
+        }
+        for (G4int i = 0; i <= n; i++) {
+            edges.push_back(scheme == "lin" ? lo + (hi - lo) * i / n
+                                            : lo * std::pow(hi / lo, (G4double)i / n));
+        }
+        edges.back() = hi;
+    }
+    else if (scheme == "sand2" || scheme == "sand2-640") {
+        // 45 equal-lethargy groups per decade from 1e-10 to 1 MeV, then
+        // 0.1 MeV wide to 18 (20) MeV
+        for (G4int i = 0; i <= 450; i++) edges.push_back(1e-10 * std::pow(10., i / 45.));
+        edges.back() = 1.;
+        G4int nLinear = (scheme == "sand2") ? 170 : 190;
+        for (G4int i = 1; i <= nLinear; i++) edges.push_back(1. + 0.1 * i);
+    }
+    else if (scheme == "file") {
+        std::string path;
+        iss >> path;
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            error = "cannot open group structure file " + path;
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            auto hash = line.find('#');
+            if (hash != std::string::npos) line.erase(hash);
+            std::istringstream ls(line);
+            G4double e;
+            while (ls >> e) edges.push_back(e);
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        if (edges.size() < 2 || edges.front() <= 0.) {
+            error = "need at least two positive edges in " + path;
+            edges.clear();
+            return false;
+        }
+    }
+    else {
+        error = "unknown binning '" + scheme + "' (lin, log, sand2, sand2-640, file)";
+        return false;
+    }
+    return true;
+}
+
+G4bool NESSAEnergyBinning::IsLinear(const G4String& spec)
+{
+    std::istringstream iss(spec);
+    std::string scheme;
+    iss >> scheme;
+    return scheme == "lin";
+}
+
+void NESSAEnergyBinning::SetUp(const tools::histo::h1d& h)
+{
+    const auto& axis = h.axis();
+    if (!axis.is_fixed_binning()) {
+        SetUp(axis.edges());
+        return;
+    }
+    std::vector<G4double> edges;
+    for (unsigned int i = 0; i < axis.bins(); i++) edges.push_back(axis.bin_lower_edge(i));
+    edges.push_back(axis.upper_edge());
+    SetUp(edges);
+}
+
+void NESSAEnergyBinning::SetUp(const std::vector<G4double>& edges)
+{
+    fEdges = edges;
+    fNBins = (G4int)edges.size() - 1;
+    fLo = edges.front();
+    fHi = edges.back();
+    fFirstBin.clear();
+    fNCells = 0;
+    
+    // Equal width, or equal lethargy, to rounding
+    G4bool linear = true, log = fLo > 0.;
+    const G4double width = (fHi - fLo) / fNBins;
+    const G4double logWidth = log ? std::log(fHi / fLo) / fNBins : 0.;
+    G4double minLogWidth = logWidth;
+    for (G4int i = 0; i < fNBins; i++) {
+        G4double w = edges[i + 1] - edges[i];
+        linear = linear && std::abs(w - width) <= 1e-9 * width;
+        if (fLo > 0.) {
+            G4double lw = std::log(edges[i + 1] / edges[i]);
+            log = log && std::abs(lw - logWidth) <= 1e-9 * logWidth;
+            minLogWidth = std::min(minLogWidth, lw);
+        }
+    }
+    if (linear || fLo <= 0.) {
+        // Non-uniform edges from zero are not produced by MakeEdges; the
+        // linear guess plus the walk in Bin() still finds the right bin
+        fScheme = kLinear;
+        fInvStep = 1. / width;
+        return;
+    }
+    if (log) {
+        fScheme = kLog;
+        fInvStep = 1. / logWidth;
+        return;
+    }
+    
+    // Cells of at most the narrowest group's lethargy width (capped for
+    // pathological structures, which then walk a little further)
+    const G4double range = std::log(fHi / fLo);
+    fNCells = (G4int)std::min(std::ceil(range / minLogWidth), 65536.);
+    fNCells = std::max(fNCells, fNBins);
+    fScheme = kTable;
+    fInvStep = fNCells / range;
+    fFirstBin.resize(fNCells);
+    G4int g = 0;
+    for (G4int c = 0; c < fNCells; c++) {
+        G4double e = fLo * std::exp(c / fInvStep);
+        while (g + 1 < fNBins && e >= fEdges[g + 1]) g++;
+        fFirstBin[c] = g;
+    }
+}
+
+void NESSABinnedH1::Attach(tools::histo::h1d* h)
+{
+    fH1 = h;
+    fSums.assign(h ? h->axis().bins() + 2 : 0, Sums());
+}
+
+void NESSABinnedH1::Flush()
+{
+    if (!fH1) return;
+    for (unsigned int off = 0; off < fSums.size(); off++) {
+        Sums& s = fSums[off];
+        if (s.entries == 0) continue;
+        unsigned int entries;
+        G4double sw, sw2, sxw, sx2w;
+        fH1->get_bin_content(off, entries, sw, sw2, sxw, sx2w);
+        fH1->set_bin_content(off, entries + s.entries, sw + s.sw, sw2 + s.sw2,
+                             sxw + s.sxw, sx2w + s.sx2w);
+        s = Sums();
+    }
+}
+
+void NESSABinnedH2::Attach(tools::histo::h2d* h)
+{
+    fH2 = h;
+    fStride = h ? h->axis_x().bins() + 2 : 0;
+    fSums.assign(h ? fStride * (h->axis_y().bins() + 2) : 0, Sums());
+}
+
+void NESSABinnedH2::Flush()
+{
+    if (!fH2) return;
+    for (unsigned int off = 0; off < fSums.size(); off++) {
+        Sums& s = fSums[off];
+        if (s.entries == 0) continue;
+        unsigned int ix = off % fStride, iy = off / fStride;
+        unsigned int entries;
+        G4double sw, sw2, sxw, sx2w, syw, sy2w;
+        fH2->get_bin_content(ix, iy, entries, sw, sw2, sxw, sx2w, syw, sy2w);
+        fH2->set_bin_content(ix, iy, entries + s.entries, sw + s.sw, sw2 + s.sw2,
+                             sxw + s.sxw, sx2w + s.sx2w, syw + s.syw, sy2w + s.sy2w);
+        s = Sums();
+    }
+}
@@ -0,0 +1,36 @@
+#include "NESSAEventAction.hh"
+#include "NESSARunAction.hh"
+#include "NESSASteppingAction.hh"
+#include "NESSANextEventEstimator.hh"
+#include "NESSATallyStats.hh"
+#include "NESSAPrecisionMonitor.hh"
+
+#include "G4Event.hh"
+#include "G4RunManager.hh"
+
+NESSAEventAction::NESSAEventAction(NESSARunAction* run,
+                                   NESSASteppingAction* stepping)
+    : fRunAction(run), fSteppingAction(stepping) {}
+
+void NESSAEventAction::BeginOfEventAction(const G4Event* event)
+{
+    NESSATallyStats::SetChartHistory(fRunAction->HistoryIndex(event->GetEventID()));
+}
+
+void NESSAEventAction::EndOfEventAction(const G4Event* event)
+{
+    // SD EndOfEvent (tally flush) has already run at this point
+    NESSANextEventEstimator::Instance().EndOfHistory();
+    fSteppingAction->GetActivationTallies().EndOfHistory();
+    fSteppingAction->GetMeshTallies().EndOfHistory();
+    fSteppingAction->GetSurfaceTallies().GetTallies().EndOfHistory();
+    fSteppingAction->GetCellTallies().EndOfHistory();
+    if (!fSteppingAction->GetWindowGenerator().IsEmpty())
+        fSteppingAction->GetWindowGenerator().EndOfHistory();
+    fRunAction->CheckpointIfDue(event->GetEventID());
+    
+    // Soft abort: this thread's loop ends after the current event
+    auto& monitor = NESSAPrecisionMonitor::Instance();
+    if (monitor.IsArmed() && monitor.EndOfEvent())
+        G4RunManager::GetRunManager()->AbortRun(true);
+}
@@ -0,0 +1,113 @@
+#include "NESSAMeshMessenger.hh"
+#include "NESSAMeshConfig.hh"
+
+#include "globals.hh"
+#include <sstream>
+
+NESSAMeshMessenger::NESSAMeshMessenger()
+{
+    // /nessa/ itself is created by NESSADetectorMessenger
+    fMeshDir = new G4UIdirectory("/nessa/mesh/", false);
+    fMeshDir->SetGuidance("Track-length mesh tallies (fluence or dose on a box grid)");
+    
+    fAddCmd = new G4UIcmdWithAString("/nessa/mesh/add", this);
+    fAddCmd->SetGuidance("Add (or replace) a mesh: name n|g x0 y0 z0 x1 y1 z1 nx ny nz");
+    fAddCmd->SetGuidance("Box corners in global coordinates [cm], voxels per axis.");
+    fAddCmd->SetParameterName("params", false);
+    
+    fEnergyBinsCmd = new G4UIcmdWithAString("/nessa/mesh/energyBins", this);
+    fEnergyBinsCmd->SetGuidance("Log-spaced energy bins: name nE [Emin Emax] (MeV,");
+    fEnergyBinsCmd->SetGuidance("default 1e-9 20). The end bins take under/overflow.");
+    fEnergyBinsCmd->SetParameterName("params", false);
+    
+    fDoseCmd = new G4UIcmdWithAString("/nessa/mesh/dose", this);
+    fDoseCmd->SetGuidance("Score dose (/nessa/dose/quantity coefficients, pSv)");
+    fDoseCmd->SetGuidance("instead of fluence: name [true|false]");
+    fDoseCmd->SetParameterName("params", false);
+    
+    fRemoveCmd = new G4UIcmdWithAString("/nessa/mesh/remove", this);
+    fRemoveCmd->SetGuidance("Remove a mesh by name");
+    fRemoveCmd->SetParameterName("name", false);
+    
+    fListCmd = new G4UIcmdWithoutParameter("/nessa/mesh/list", this);
+    fListCmd->SetGuidance("List the mesh tallies");
+}
+
+NESSAMeshMessenger::~NESSAMeshMessenger()
+{
+    delete fAddCmd; delete fEnergyBinsCmd; delete fDoseCmd;
+    delete fRemoveCmd; delete fListCmd; delete fMeshDir;
+}
+
+void NESSAMeshMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
+{
+    auto& config = NESSAMeshConfig::Instance();
+    std::istringstream iss(val);
+    G4String name;
+    iss >> name;
+    
+    if (cmd == fAddCmd) {
+        MeshSpec spec;
+        spec.name = name;
+        G4String part;
+        iss >> part >> spec.lo[0] >> spec.lo[1] >> spec.lo[2]
+            >> spec.hi[0] >> spec.hi[1] >> spec.hi[2]
+            >> spec.n[0] >> spec.n[1] >> spec.n[2];
+        G4bool ok = !iss.fail() && (part == "n" || part == "g");
+        for (G4int k = 0; ok && k < 3; k++) {
+            if (spec.lo[k] > spec.hi[k]) std::swap(spec.lo[k], spec.hi[k]);
+            ok = spec.n[k] > 0 && spec.hi[k] > spec.lo[k];
+        }
+        if (!ok) {
+            G4Exception("NESSAMeshMessenger::SetNewValue", "Mesh002", JustWarning,
+                ("Usage: add name n|g x0 y0 z0 x1 y1 z1 nx ny nz, got: " + val).c_str());
+            return;
+        }
+        spec.particle = (part == "n") ? 0 : 1;
+        config.AddMesh(spec);
+        G4cout << "Added mesh: " << name << " (" << spec.n[0] << "x" << spec.n[1]
+               << "x" << spec.n[2] << ")" << G4endl;
+        return;
+    }
+    if (cmd == fListCmd) {
+        G4cout << "\n=== NESSA Mesh Tallies ===" << G4endl;
+        for (const auto& m : config.GetMeshes()) {
+            G4cout << "  " << m.name << "  " << (m.particle == 0 ? "n" : "g")
+                   << "  (" << m.lo[0] << ", " << m.lo[1] << ", " << m.lo[2] << ") - ("
+                   << m.hi[0] << ", " << m.hi[1] << ", " << m.hi[2] << ") cm  "
+                   << m.n[0] << "x" << m.n[1] << "x" << m.n[2]
+                   << "  " << m.nEnergy << " E bins"
+                   << (m.dose ? "  [dose]" : "") << G4endl;
+        }
+        return;
+    }
+    if (cmd == fRemoveCmd) {
+        config.RemoveMesh(name);
+        return;
+    }
+    
+    MeshSpec* spec = config.Find(name);
+    if (!spec) {
+        G4Exception("NESSAMeshMessenger::SetNewValue", "Mesh003", JustWarning,
+            ("No mesh named " + name).c_str());
+        return;
+    }
+    if (cmd == fEnergyBinsCmd) {
+        G4int nE = 0;
+        G4double eMin = spec->eMin, eMax = spec->eMax;
+        iss >> nE >> eMin >> eMax;
+        if (nE < 1 || !(eMin > 0.) || eMax <= eMin) {
+            G4Exception("NESSAMeshMessenger::SetNewValue", "Mesh004", JustWarning,
+                ("Usage: energyBins name nE [Emin Emax], got: " + val).c_str());
+            return;
+        }
+        spec->nEnergy = nE;
+        spec->eMin = eMin;
+        spec->eMax = eMax;
+    }
+    else if (cmd == fDoseCmd) {
+        G4String flag = "true";
+        iss >> flag;
+        spec->dose = G4UIcommand::ConvertToBool(flag);
+    }
+}
@@ -0,0 +1,267 @@
+#include "NESSAMeshTally.hh"
+#include "NESSATallyStats.hh"
+#include "NESSADoseConversion.hh"
+#include "NESSAProfiler.hh"
+#include "NESSAMeshFile.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4Neutron.hh"
+#include "G4Gamma.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4ios.hh"
+#include "globals.hh"
+
+#include <fstream>
+#include <cstring>
+#include <iomanip>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+NESSAMeshTally::NESSAMeshTally(const G4String& name)
+    : G4VAccumulable(name),
+      fNeutron(G4Neutron::Definition()),
+      fGamma(G4Gamma::Definition()) {}
+
+void NESSAMeshTally::SetUp(const std::vector<MeshSpec>& specs)
+{
+    // Tiles of up to 8 voxels per axis: a few kB to a few hundred kB with
+    // the energy bins, small against a full mesh, large against the index
+    const G4int kMaxTileShift = 3;
+    
+    fMeshes.clear();
+    G4long nTiles = 0;
+    for (const auto& spec : specs) {
+        Mesh m;
+        m.spec = spec;
+        G4double volume = 1.;  // cm3
+        m.tileBins = spec.nEnergy;
+        for (G4int k = 0; k < 3; k++) {
+            m.lo[k] = spec.lo[k] * cm;
+            m.width[k] = (spec.hi[k] - spec.lo[k]) * cm / spec.n[k];
+            m.invWidth[k] = 1. / m.width[k];
+            volume *= m.width[k] / cm;
+            G4int shift = 0;
+            while (shift < kMaxTileShift && (1 << shift) < spec.n[k]) shift++;
+            m.tileShift[k] = shift;
+            m.tileMask[k] = (1 << shift) - 1;
+            m.nTiles[k] = (spec.n[k] + m.tileMask[k]) >> shift;
+            m.tileBins <<= shift;
+        }
+        m.invVolume = 1. / volume;
+        m.logEmin = std::log(spec.eMin);
+        m.invLogStep = (spec.nEnergy > 1)
+                     ? spec.nEnergy / std::log(spec.eMax / spec.eMin) : 0.;
+        m.firstTile = nTiles;
+        nTiles += m.nTiles[0] * m.nTiles[1] * m.nTiles[2];
+        fMeshes.push_back(m);
+    }
+    
+    fTileStart.assign(nTiles, -1);
+    Reset();
+}
+
+G4long NESSAMeshTally::GetNBins() const
+{
+    G4long n = 0;
+    for (const auto& m : fMeshes) n += m.spec.NBins();
+    return n;
+}
+
+G4int NESSAMeshTally::Mesh::EnergyBin(G4double energyMeV) const
+{
+    if (spec.nEnergy == 1) return 0;
+    G4double u = (std::log(energyMeV) - logEmin) * invLogStep;
+    if (!(u > 0.)) return 0;  // also E = 0
+    return std::min((G4int)u, spec.nEnergy - 1);
+}
+
+void NESSAMeshTally::ScoreStep(const G4Step* step)
+{
+    NESSA_PROFILE(kMeshTally);
+    
+    const auto* def = step->GetTrack()->GetDefinition();
+    const G4int particle = (def == fNeutron) ? 0 : (def == fGamma) ? 1 : -1;
+    if (particle < 0) return;
+    const G4double length = step->GetStepLength();
+    if (length <= 0.) return;
+    
+    const auto* pre = step->GetPreStepPoint();
+    const G4ThreeVector& a = pre->GetPosition();
+    const G4ThreeVector d = step->GetPostStepPoint()->GetPosition() - a;
+    const G4double energy = pre->GetKineticEnergy() / MeV;
+    const G4double weight = pre->GetWeight();
+    
+    for (const auto& m : fMeshes) {
+        if (m.spec.particle != particle) continue;
+        // Weighted track length [cm] per unit of the segment parameter,
+        // per voxel volume: the fluence of a voxel is scorePerT * dt
+        G4double scorePerT = weight * (length / cm) * m.invVolume;
+        if (m.spec.dose) {
+            scorePerT *= NESSADoseConversion::Instance().Coefficient(particle, energy);
+            if (scorePerT <= 0.) continue;
+        }
+        Traverse(m, a, d, m.EnergyBin(energy), scorePerT);
+    }
+}
+
+void NESSAMeshTally::Traverse(const Mesh& m, const G4ThreeVector& a,
+    const G4ThreeVector& d, G4int energyBin, G4double scorePerT)
+{
+    // Clip the segment a + t d, t in [0, 1], to the mesh box (slab test)
+    G4double tEnter = 0., tExit = 1.;
+    for (G4int k = 0; k < 3; k++) {
+        G4double lo = m.lo[k], hi = m.lo[k] + m.width[k] * m.spec.n[k];
+        if (d[k] == 0.) {
+            if (a[k] < lo || a[k] >= hi) return;
+            continue;
+        }
+        G4double inv = 1. / d[k];
+        G4double t0 = (lo - a[k]) * inv, t1 = (hi - a[k]) * inv;
+        if (t0 > t1) std::swap(t0, t1);
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+    }
+    if (tEnter >= tExit) return;
+    
+    // Entry voxel, then the parameter of the next boundary along each axis
+    G4int i[3], stepDir[3];
+    G4double tMax[3], tDelta[3];
+    for (G4int k = 0; k < 3; k++) {
+        G4double x = a[k] + tEnter * d[k];
+        i[k] = std::min(std::max((G4int)((x - m.lo[k]) * m.invWidth[k]), 0),
+                        m.spec.n[k] - 1);
+        if (d[k] == 0.) {
+            stepDir[k] = 0;
+            tMax[k] = tDelta[k] = DBL_MAX;
+            continue;
+        }
+        stepDir[k] = (d[k] > 0.) ? 1 : -1;
+        G4double boundary = m.lo[k] + (i[k] + (stepDir[k] > 0)) * m.width[k];
+        tMax[k] = (boundary - a[k]) / d[k];
+        tDelta[k] = m.width[k] / std::abs(d[k]);
+    }
+    
+    G4double t = tEnter;
+    for (;;) {
+        G4int k = (tMax[0] < tMax[1]) ? (tMax[0] < tMax[2] ? 0 : 2)
+                                      : (tMax[1] < tMax[2] ? 1 : 2);
+        G4double tNext = std::min(tMax[k], tExit);
+        if (tNext > t)
+            Add(TileStart(m.Tile(i), m.tileBins) + m.LocalBin(i, energyBin),
+                (tNext - t) * scorePerT);
+        if (tNext >= tExit) return;
+        t = tNext;
+        i[k] += stepDir[k];
+        if (i[k] < 0 || i[k] >= m.spec.n[k]) return;
+        tMax[k] += tDelta[k];
+    }
+}
+
+void NESSAMeshTally::EndOfHistory()
+{
+    for (G4long bin : fTouched) {
+        G4double x = fHistory[bin];
+        fSum[bin] += x;
+        fSum2[bin] += x * x;
+        fHistory[bin] = 0.;
+    }
+    fTouched.clear();
+}
+
+void NESSAMeshTally::Merge(const G4VAccumulable& other)
+{
+    const auto& o = static_cast<const NESSAMeshTally&>(other);
+    if (o.fTileStart.size() != fTileStart.size()) return;
+    for (const auto& m : fMeshes) {
+        G4long end = m.firstTile + m.nTiles[0] * m.nTiles[1] * m.nTiles[2];
+        for (G4long tile = m.firstTile; tile < end; tile++) {
+            G4long from = o.fTileStart[tile];
+            if (from < 0) continue;
+            G4long to = TileStart(tile, m.tileBins);
+            for (G4long b = 0; b < m.tileBins; b++) {
+                fSum[to + b] += o.fSum[from + b];
+                fSum2[to + b] += o.fSum2[from + b];
+            }
+        }
+    }
+}
+
+void NESSAMeshTally::Reset()
+{
+    // Release the tiles: the next run allocates what it scores
+    std::fill(fTileStart.begin(), fTileStart.end(), -1);
+    fSum.clear();
+    fSum2.clear();
+    fHistory.clear();
+    fTouched.clear();
+}
+
+void NESSAMeshTally::Write(const G4String& outputFile, G4double nEvents) const
+{
+    if (fMeshes.empty() || nEvents <= 0) return;
+    
+    G4String base = outputFile;
+    auto dot = base.rfind('.');
+    auto slash = base.rfind('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        base = base.substr(0, dot);
+    
+    for (const auto& m : fMeshes) {
+        const auto& spec = m.spec;
+        G4String file = base + "_mesh_" + spec.name + ".bin";
+        std::ofstream out(file, std::ios::binary);
+        if (!out.is_open()) {
+            G4Exception("NESSAMeshTally::Write", "Mesh001", JustWarning,
+                ("Cannot write " + file).c_str());
+            continue;
+        }
+    
+        const G4long nTiles = m.nTiles[0] * m.nTiles[1] * m.nTiles[2];
+        MeshFileHeader header{};
+        std::memcpy(header.magic, "NESSAMSH", 8);
+        header.version = kMeshFileVersion;
+        header.particle = spec.particle;
+        header.dose = spec.dose;
+        header.nEnergy = spec.nEnergy;
+        for (G4int k = 0; k < 3; k++) {
+            header.n[k] = spec.n[k];
+            header.tileShift[k] = m.tileShift[k];
+            header.lo[k] = spec.lo[k];
+            header.hi[k] = spec.hi[k];
+        }
+        header.nEvents = nEvents;
+        header.nTiles = nTiles;
+    
+        std::vector<double> edges(spec.nEnergy + 1);
+        for (G4int ie = 0; ie <= spec.nEnergy; ie++)
+            edges[ie] = spec.eMin * std::pow(spec.eMax / spec.eMin, (G4double)ie / spec.nEnergy);
+    
+        // Stored tiles follow the index in tile order
+        std::vector<int64_t> index(nTiles, -1);
+        int64_t offset = sizeof(MeshFileHeader) + edges.size() * sizeof(double)
+                       + nTiles * sizeof(int64_t);
+        const int64_t tileBytes = 2 * m.tileBins * sizeof(double);
+        for (G4long t = 0; t < nTiles; t++) {
+            if (fTileStart[m.firstTile + t] < 0) continue;
+            index[t] = offset;
+            offset += tileBytes;
+            header.nStored++;
+        }
+    
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(edges.data()), edges.size() * sizeof(double));
+        out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(int64_t));
+        for (G4long t = 0; t < nTiles; t++) {
+            G4long start = fTileStart[m.firstTile + t];
+            if (start < 0) continue;
+            out.write(reinterpret_cast<const char*>(&fSum[start]), m.tileBins * sizeof(double));
+            out.write(reinterpret_cast<const char*>(&fSum2[start]), m.tileBins * sizeof(double));
+        }
+    
+        G4cout << "  Mesh tally:        " << file << " (" << header.nStored << "/"
+               << nTiles << " tiles, " << std::fixed << std::setprecision(1)
+               << offset / (1024. * 1024.) << " MB)" << G4endl;
+    }
+}
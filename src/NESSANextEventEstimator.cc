@@ -0,0 +1,298 @@
+#include "NESSANextEventEstimator.hh"
+#include "NESSAScoringConfig.hh"
+#include "NESSAPrimaryGeneratorAction.hh"
+#include "NESSAProfiler.hh"
+#include "NESSADoseConversion.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4VProcess.hh"
+#include "G4HadronicProcess.hh"
+#include "G4HadronicProcessType.hh"
+#include "G4HadronicProcessStore.hh"
+#include "G4Nucleus.hh"
+#include "G4NucleiProperties.hh"
+#include "G4EmCalculator.hh"
+#include "G4Navigator.hh"
+#include "G4TransportationManager.hh"
+#include "G4Material.hh"
+#include "G4Neutron.hh"
+#include "G4Gamma.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+
+#include <cmath>
+#include <cfloat>
+
+namespace {
+
+// Contributions attenuated by more than exp(-50) are dropped (and the
+// ray is not traced further)
+const G4double kMaxTau = 50.;
+
+// Photon cross-section tables: log grid from 1 keV to 20 MeV
+const G4double kPhotonEmin = 1.*keV;
+const G4double kPhotonEmax = 20.*MeV;
+const G4int    kPhotonBins = 256;
+
+}  // namespace
+
+NESSANextEventEstimator& NESSANextEventEstimator::Instance()
+{
+    static G4ThreadLocal NESSANextEventEstimator* instance = nullptr;
+    if (!instance) instance = new NESSANextEventEstimator();
+    return *instance;
+}
+
+NESSANextEventEstimator::NESSANextEventEstimator()
+    : fNeutron(G4Neutron::Definition()),
+      fGamma(G4Gamma::Definition()),
+      fNavigator(new G4Navigator()),
+      fTallies("nextEvent") {}
+
+void NESSANextEventEstimator::BeginOfRun()
+{
+    fPoints.clear();
+    G4int idx = 0;
+    for (const auto& p : NESSAScoringConfig::Instance().GetPoints()) {
+        if (!p.active) continue;
+        if (p.nextEvent) {
+            fPoints.push_back({idx, G4ThreeVector(p.x, p.y, p.z) * cm,
+                               p.radius * cm});
+        }
+        idx++;
+    }
+    fDoseOffset = 2 * idx;
+    fTallies.SetNBins(4 * idx);
+    
+    // The geometry may have been rebuilt since the last run
+    if (!fPoints.empty()) {
+        fNavigator->SetWorldVolume(G4TransportationManager::GetTransportationManager()
+                                       ->GetNavigatorForTracking()->GetWorldVolume());
+    }
+}
+
+void NESSANextEventEstimator::ScoreSource(const G4ThreeVector& pos, G4double weight,
+    uint64_t eventKey, const NESSAPrimaryGeneratorAction& source)
+{
+    // Energies towards each point come from a side stream keyed on the
+    // history (and run, so that repeated runs differ), so the primary
+    // itself is sampled exactly as without estimator. The complement
+    // keeps it apart from the engine seeds drawn from the same key.
+    fRandom.Seed(~eventKey);
+    
+    Contribute(pos, 0, weight, [&](const G4ThreeVector& dir, G4double& e) {
+        G4int bin = 0;
+        G4double density = source.EmissionDensity(dir, bin);
+        if (density <= 0.) return 0.;
+        G4double r1 = fRandom.Uniform();
+        G4double r2 = fRandom.Uniform();
+        e = source.EnergyFromUniforms(bin, r1, r2);
+        return density;
+    });
+}
+
+void NESSANextEventEstimator::ScoreCollision(const G4Step* step)
+{
+    NESSA_PROFILE(kNextEvent);
+    
+    // Interactions only: not boundaries, step limits or decays
+    const auto* post = step->GetPostStepPoint();
+    const auto* proc = post->GetProcessDefinedStep();
+    if (!proc) return;
+    auto type = proc->GetProcessType();
+    if (type != fHadronic && type != fElectromagnetic) return;
+    
+    const auto* track = step->GetTrack();
+    const auto* def = track->GetDefinition();
+    if (def != fNeutron && def != fGamma) return;
+    
+    const auto* pre = step->GetPreStepPoint();
+    const G4ThreeVector& x = post->GetPosition();
+    const G4ThreeVector& u0 = pre->GetMomentumDirection();
+    const G4double e0 = pre->GetKineticEnergy();
+    const G4double w = pre->GetWeight();
+    
+    if (def == fGamma) {
+        // Compton is the only photon interaction that leaves the photon
+        // alive with less energy (photoelectric and pair production absorb
+        // it, Rayleigh scattering keeps the energy)
+        if (track->GetTrackStatus() != fAlive || post->GetKineticEnergy() >= e0)
+            return;
+        Contribute(x, 1, w, [&](const G4ThreeVector& dir, G4double& e) {
+            return ComptonDensity(u0.dot(dir), e0, e);
+        });
+        return;
+    }
+    
+    if (proc->GetProcessSubType() == fHadronElastic) {
+        const auto* hadProc = dynamic_cast<const G4HadronicProcess*>(proc);
+        const G4Nucleus* target = hadProc ? hadProc->GetTargetNucleus() : nullptr;
+        if (!target || target->GetA_asInt() < 1) return;
+        G4double A = G4NucleiProperties::GetNuclearMass(target->GetA_asInt(),
+                         target->GetZ_asInt()) / neutron_mass_c2;
+        Contribute(x, 0, w, [&](const G4ThreeVector& dir, G4double& e) {
+            return ElasticDensity(A, u0.dot(dir), e0, e);
+        });
+        return;
+    }
+    
+    // Other neutron reactions: every emitted neutron and photon with its own
+    // energy and weight; a primary that survives counts as emitted
+    if (track->GetTrackStatus() == fAlive)
+        Isotropic(x, 0, post->GetWeight(), post->GetKineticEnergy());
+    if (const auto* secondaries = step->GetSecondaryInCurrentStep()) {
+        for (const auto* sec : *secondaries) {
+            const auto* secDef = sec->GetDefinition();
+            if (secDef == fNeutron)
+                Isotropic(x, 0, sec->GetWeight(), sec->GetKineticEnergy());
+            else if (secDef == fGamma)
+                Isotropic(x, 1, sec->GetWeight(), sec->GetKineticEnergy());
+        }
+    }
+}
+
+template <class Density>
+void NESSANextEventEstimator::Contribute(const G4ThreeVector& x, G4int particle,
+    G4double weight, Density&& density)
+{
+    const auto& dose = NESSADoseConversion::Instance();
+    for (const auto& p : fPoints) {
+        G4ThreeVector dir = p.pos - x;
+        G4double R = dir.mag();
+        if (R <= 0.) continue;
+        dir /= R;
+    
+        G4double e = 0.;
+        G4double pdf = density(dir, e);
+        if (pdf <= 0. || e <= 0.) continue;
+    
+        G4double geom = (R < p.r0) ? 3. / (p.r0 * p.r0) : 1. / (R * R);
+        G4double tau = OpticalDepth(x, dir, R, particle, e);
+        if (tau >= kMaxTau) continue;
+        G4double flux = weight * pdf * geom * std::exp(-tau) * cm2;
+        fTallies.Score(2*p.index + particle, flux);
+        fTallies.Score(fDoseOffset + 2*p.index + particle,
+                       flux * dose.Coefficient(particle, e / MeV));
+    }
+}
+
+void NESSANextEventEstimator::Isotropic(const G4ThreeVector& x, G4int particle,
+    G4double weight, G4double energy)
+{
+    Contribute(x, particle, weight, [&](const G4ThreeVector&, G4double& e) {
+        e = energy;
+        return 1. / (4. * pi);
+    });
+}
+
+G4double NESSANextEventEstimator::OpticalDepth(const G4ThreeVector& from,
+    const G4ThreeVector& dir, G4double distance, G4int particle, G4double energy)
+{
+    fXSCache.clear();
+    G4ThreeVector pos = from;
+    G4double remaining = distance;
+    G4double tau = 0.;
+    
+    auto* pv = fNavigator->LocateGlobalPointAndSetup(pos, &dir, false, false);
+    for (G4int nSteps = 0; pv && remaining > 0. && nSteps < 100000; nSteps++) {
+        G4double safety = 0.;
+        G4double s = fNavigator->ComputeStep(pos, dir, remaining, safety);
+        if (s > remaining) s = remaining;  // also kInfinity: no boundary ahead
+    
+        tau += s * MacroscopicXS(pv->GetLogicalVolume()->GetMaterial(), particle, energy);
+        if (tau >= kMaxTau) break;
+    
+        remaining -= s;
+        pos += s * dir;
+        fNavigator->SetGeometricallyLimitedStep();
+        pv = fNavigator->LocateGlobalPointAndSetup(pos, &dir, true);
+    }
+    return tau;
+}
+
+G4double NESSANextEventEstimator::MacroscopicXS(const G4Material* mat,
+    G4int particle, G4double energy)
+{
+    // One energy per ray, and a ray crosses only a few materials
+    for (const auto& [m, xs] : fXSCache) {
+        if (m == mat) return xs;
+    }
+    
+    G4double xs = 0.;
+    if (particle == 0) {
+        auto* store = G4HadronicProcessStore::Instance();
+        xs = store->GetElasticCrossSectionPerVolume(fNeutron, energy, mat)
+           + store->GetInelasticCrossSectionPerVolume(fNeutron, energy, mat)
+           + store->GetCaptureCrossSectionPerVolume(fNeutron, energy, mat)
+           + store->GetFissionCrossSectionPerVolume(fNeutron, energy, mat);
+    } else {
+        xs = PhotonXS(mat, energy);
+    }
+    fXSCache.emplace_back(mat, xs);
+    return xs;
+}
+
+G4double NESSANextEventEstimator::PhotonXS(const G4Material* mat, G4double energy)
+{
+    // Smooth in energy (apart from absorption edges), so tabulated once
+    // per material and interpolated in log(E)
+    auto& table = fPhotonTables[mat];
+    const G4double logRange = std::log(kPhotonEmax / kPhotonEmin);
+    if (table.empty()) {
+        G4EmCalculator calc;
+        table.resize(kPhotonBins + 1);
+        for (G4int i = 0; i <= kPhotonBins; i++) {
+            G4double e = kPhotonEmin * std::exp(logRange * i / kPhotonBins);
+            G4double length = calc.ComputeGammaAttenuationLength(e, mat);
+            table[i] = (length > 0. && length < DBL_MAX) ? 1. / length : 0.;
+        }
+    }
+    
+    G4double u = std::log(energy / kPhotonEmin) / logRange * kPhotonBins;
+    if (u <= 0.) return table.front();
+    if (u >= kPhotonBins) return table.back();
+    G4int i = (G4int)u;
+    G4double f = u - i;
+    return (1. - f) * table[i] + f * table[i+1];
+}
+
+G4double NESSANextEventEstimator::ElasticDensity(G4double A, G4double muLab,
+    G4double e0, G4double& e1)
+{
+    // Hydrogen (A ~ 1): forward hemisphere only, E' = E cos^2(theta)
+    if (A < 1.001) {
+        if (muLab <= 0.) return 0.;
+        e1 = e0 * muLab * muLab;
+        return muLab / pi;
+    }
+    
+    // CM cosine for this lab cosine (single-valued for A > 1)
+    G4double muCM = (muLab * std::sqrt(A*A - 1. + muLab*muLab)
+                     - (1. - muLab*muLab)) / A;
+    G4double s = A*A + 2.*A*muCM + 1.;
+    e1 = e0 * s / ((A + 1.) * (A + 1.));
+    
+    // p(muLab) = p(muCM) dmuCM/dmuLab, with p(muCM) = 1/2
+    G4double dMuLabdMuCM = A*A * (A + muCM) / (s * std::sqrt(s));
+    return 0.5 / dMuLabdMuCM / twopi;
+}
+
+G4double NESSANextEventEstimator::ComptonDensity(G4double muLab, G4double e0,
+    G4double& e1)
+{
+    G4double k = e0 / electron_mass_c2;
+    G4double ratio = 1. / (1. + k * (1. - muLab));  // E'/E
+    e1 = e0 * ratio;
+    
+    // Total cross section / (2 pi r_e^2)
+    G4double f;
+    if (k < 1e-3) {
+        f = 4./3. * (1. - 2.*k);  // Thomson limit
+    } else {
+        G4double l = std::log(1. + 2.*k);
+        f = (1. + k) / (k*k) * (2.*(1. + k) / (1. + 2.*k) - l / k)
+          + l / (2.*k) - (1. + 3.*k) / ((1. + 2.*k) * (1. + 2.*k));
+    }
+    return ratio*ratio * (ratio + 1./ratio - 1. + muLab*muLab) / (4. * pi * f);
+}
@@ -0,0 +1,187 @@
+#include "NESSAPrecisionMonitor.hh"
+#include "NESSAScoringConfig.hh"
+#include "NESSARunSummary.hh"
+
+#include "G4ios.hh"
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+    
+// Threads publish at most this often, so the lock is taken a few times
+// per second in total, whatever the event rate
+const G4double kPublishInterval = 1.;  // s
+    
+// No decision on fewer histories: R of a tally that has scored a handful
+// of times is not a meaningful estimate yet
+const G4double kMinHistories = 1000.;
+    
+/// One thread's view: its tallies and what it has published of them
+struct ThreadState {
+    const NESSATallyStats* sources[2] = {nullptr, nullptr};  // scoring, next-event
+    std::vector<TallyMoments> published;
+    G4double events = 0.;  // since the last publish
+    std::chrono::steady_clock::time_point last;
+};
+G4ThreadLocal ThreadState* gState = nullptr;
+    
+}  // namespace
+
+NESSAPrecisionMonitor& NESSAPrecisionMonitor::Instance()
+{
+    static NESSAPrecisionMonitor instance;
+    return instance;
+}
+
+void NESSAPrecisionMonitor::Arm(const G4String& detector, G4double relErr,
+                                G4double maxTime)
+{
+    fDetector = detector;
+    fRelErr = relErr;
+    fMaxTime = maxTime;
+    fArmed = true;
+}
+
+void NESSAPrecisionMonitor::BeginOfRun(G4bool isMaster,
+    const NESSATallyStats* scoring, const NESSATallyStats* nextEvent)
+{
+    if (!fArmed) return;
+    
+    // The master's BeginOfRunAction runs before any worker's, and the
+    // watch list is only read afterwards
+    if (isMaster) {
+        fWatches.clear();
+        G4int idx = 0;
+        for (const auto& p : NESSAScoringConfig::Instance().GetPoints()) {
+            if (!p.active) continue;
+            if (fDetector == "all" || p.name == fDetector) {
+                for (G4int part = 0; part < 2; part++) {
+                    fWatches.push_back({p.name, part, 2*idx + part});
+                    if (p.nextEvent) fWatches.push_back({p.name, 2 + part, 2*idx + part});
+                }
+            }
+            idx++;
+        }
+        fSums.assign(fWatches.size(), TallyMoments());
+        fHistories = 0.;
+        fStop = false;
+        fStopReason = "";
+        fStart = std::chrono::steady_clock::now();
+    
+        G4cout << "Running until R <= " << fRelErr << " on " << fDetector
+               << " (" << fWatches.size() << " tallies";
+        if (fMaxTime > 0) G4cout << ", at most " << fMaxTime << " s";
+        G4cout << ")" << G4endl;
+    }
+    
+    // Threads that score (workers, or the serial run)
+    if (!scoring) return;
+    if (!gState) gState = new ThreadState();
+    gState->sources[0] = scoring;
+    gState->sources[1] = nextEvent;
+    gState->published.assign(fWatches.size(), TallyMoments());
+    gState->events = 0.;
+    gState->last = std::chrono::steady_clock::now();
+}
+
+void NESSAPrecisionMonitor::Resume(G4double histories, G4double seconds)
+{
+    if (!fArmed) return;
+    G4AutoLock lock(&fMutex);
+    fHistories = histories;
+    fStart -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<G4double>(seconds));
+}
+
+G4bool NESSAPrecisionMonitor::EndOfEvent()
+{
+    if (fStop) return true;
+    if (!gState || !gState->sources[0]) return false;
+    
+    gState->events += 1.;
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<G4double> dt = now - gState->last;
+    if (dt.count() < kPublishInterval) return false;
+    gState->last = now;
+    
+    // Only what this thread has added since its last publish goes in, so
+    // the shared sums are the run's sums up to each thread's last publish
+    G4AutoLock lock(&fMutex);
+    for (size_t i = 0; i < fWatches.size(); i++) {
+        const auto& w = fWatches[i];
+        const NESSATallyStats* t = gState->sources[w.particle / 2];
+        if (!t || w.bin >= t->GetNBins()) continue;
+        const TallyMoments& m = t->GetMoments(w.bin);
+        TallyMoments& old = gState->published[i];
+        fSums[i].s1 += m.s1 - old.s1;
+        fSums[i].s2 += m.s2 - old.s2;
+        old = m;
+    }
+    fHistories += gState->events;
+    gState->events = 0.;
+    Evaluate();
+    return fStop;
+}
+
+void NESSAPrecisionMonitor::Evaluate()
+{
+    if (fMaxTime > 0 && Elapsed() >= fMaxTime) {
+        fStopReason = "time budget spent";
+        fStop = true;
+        return;
+    }
+    if (fHistories < kMinHistories || fWatches.empty()) return;
+    
+    // Every watched tally must have scored: an unscored one has R = 0 and
+    // would otherwise count as converged
+    for (const auto& sum : fSums) {
+        if (sum.s1 <= 0.) return;
+        G4double mean = 0., relErr = 0.;
+        NESSATallyStats::MeanAndError(sum.s1, sum.s2, fHistories, mean, relErr);
+        if (relErr > fRelErr) return;
+    }
+    fStopReason = "precision reached";
+    fStop = true;
+}
+
+G4double NESSAPrecisionMonitor::Elapsed() const
+{
+    std::chrono::duration<G4double> dt = std::chrono::steady_clock::now() - fStart;
+    return dt.count();
+}
+
+void NESSAPrecisionMonitor::Report(const NESSARunSummary& summary)
+{
+    if (!fArmed) return;
+    fArmed = false;
+    
+    static const char* estimators[2] = {"track", "F5"};
+    G4int nMet = 0;
+    G4cout << "\n  --- Precision target R <= " << std::fixed << std::setprecision(4)
+           << fRelErr << " (" << fDetector << ") ---" << G4endl;
+    for (const auto& w : fWatches) {
+        auto it = std::find_if(summary.tallies.begin(), summary.tallies.end(),
+            [&](const TallyEntry& t) {
+                return t.name == w.name && t.particle == w.particle;
+            });
+        if (it == summary.tallies.end()) continue;
+        G4double mean = 0., relErr = 0.;
+        NESSATallyStats::MeanAndError(it->moments.s1, it->moments.s2,
+                                      summary.nEvents, mean, relErr);
+        G4bool met = it->moments.s1 > 0. && relErr <= fRelErr;
+        nMet += met;
+        G4cout << std::left
+               << "  " << std::setw(18) << w.name
+               << std::setw(5) << (w.particle % 2 == 0 ? "n" : "g")
+               << std::setw(9) << estimators[w.particle / 2]
+               << std::right << std::fixed << std::setprecision(4)
+               << "R = " << std::setw(7) << relErr
+               << (met ? "  met" : it->moments.s1 > 0. ? "  NOT met" : "  no score")
+               << G4endl;
+    }
+    G4cout << "  " << nMet << "/" << fWatches.size() << " targets met after "
+           << (G4long)summary.nEvents << " events, " << std::setprecision(1)
+           << Elapsed() << " s: "
+           << (fStopReason.empty() ? "event limit reached" : fStopReason)
+           << G4endl;
+}
@@ -5,8 +5,18 @@
 // ============================================================
 
 #include "NESSAPrimaryGeneratorAction.hh"
+#include "NESSARunConfig.hh"
+#include "NESSASplitMix.hh"
+#include "NESSANextEventEstimator.hh"
+#include "NESSARunAction.hh"
+#include "NESSASourceConfig.hh"
 
 #include "G4Event.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4Threading.hh"
+#include "G4Run.hh"
+#include "G4RunManager.hh"
 #include "G4ParticleTable.hh"
 #include "G4ParticleDefinition.hh"
 #include "G4SystemOfUnits.hh"
@@ -131,14 +141,123 @@ void NESSAPrimaryGeneratorAction::LoadSourceData(const G4String& filename)
            << fEnergyCDFs.size() << " energy distributions" << G4endl;
 }
 
-G4int NESSAPrimaryGeneratorAction::SampleDirectionBin()
+G4int NESSAPrimaryGeneratorAction::SampleDirectionBin(G4double& weight)
 {
+    const auto& cdf = fBiasCDF.empty() ? fDirCDF : fBiasCDF;
     G4double r = G4UniformRand();
-    auto it = std::lower_bound(fDirCDF.begin(), fDirCDF.end(), r);
-    return std::distance(fDirCDF.begin(), it);
+    auto it = std::lower_bound(cdf.begin(), cdf.end(), r);
+    G4int dirBin = std::distance(cdf.begin(), it);
+    if (!fBiasCDF.empty() && dirBin < fNDirBins) weight *= fBiasWeight[dirBin];
+    return dirBin;
+}
+
+G4double NESSAPrimaryGeneratorAction::SampleAzimuth(G4double& weight)
+{
+    // One uniform either way, so that biasing does not shift the random
+    // numbers drawn after it
+    G4double u = G4UniformRand();
+    if (fConeHalfWidth <= 0.) return twopi * u;
+    
+    G4double phi = (u < fConeFraction)
+        ? fConePhi + fConeHalfWidth * (2. * u / fConeFraction - 1.)
+        : twopi * (u - fConeFraction) / (1. - fConeFraction);
+    // Mixture density at phi (the cone overlaps the uniform part)
+    G4double offset = std::remainder(phi - fConePhi, twopi);
+    G4double density = (1. - fConeFraction) / twopi;
+    if (std::abs(offset) <= fConeHalfWidth) density += fConeFraction / (2. * fConeHalfWidth);
+    weight *= 1. / (twopi * density);
+    return phi;
+}
+
+void NESSAPrimaryGeneratorAction::UpdateBias()
+{
+    const auto& config = NESSASourceConfig::Instance();
+    if (config.GetVersion() == fBiasVersion) return;
+    fBiasVersion = config.GetVersion();
+    fBiasCDF.clear();
+    fBiasWeight.clear();
+    fConeHalfWidth = 0.;
+    const G4bool report = G4Threading::G4GetThreadId() <= 0;
+    
+    // Given (or analog) bin probabilities times the cosine-range factors
+    const auto& given = config.GetBinProbabilities();
+    const auto& factors = config.GetCosineFactors();
+    std::vector<G4double> biased(fNDirBins);
+    for (G4int i = 0; i < fNDirBins; i++) {
+        biased[i] = given.empty() ? DirectionBinProbability(i)
+                  : (i < (G4int)given.size()) ? given[i] : 0.;
+        G4double muLo, muHi;
+        DirectionBinRange(i, muLo, muHi);
+        const G4double mu = 0.5 * (muLo + muHi);
+        for (const auto& f : factors) {
+            if (mu >= f.muLo && mu <= f.muHi) biased[i] *= f.factor;
+        }
+    }
+    if (!given.empty() || !factors.empty()) {
+        // Every direction of the analog source must remain possible
+        G4double total = std::accumulate(biased.begin(), biased.end(), 0.);
+        G4bool fair = total > 0.;
+        for (G4int i = 0; i < fNDirBins; i++) {
+            if (DirectionBinProbability(i) > 0. && !(biased[i] > 0.)) fair = false;
+        }
+        if (!fair) {
+            G4Exception("NESSAPrimaryGeneratorAction::UpdateBias", "Source002", JustWarning,
+                "The direction bias leaves out bins the source emits into: "
+                "sampling the analog direction bins");
+        } else {
+            fBiasCDF.resize(fNDirBins);
+            fBiasWeight.resize(fNDirBins);
+            G4double sum = 0.;
+            for (G4int i = 0; i < fNDirBins; i++) {
+                sum += biased[i] / total;
+                fBiasCDF[i] = sum;
+                fBiasWeight[i] = DirectionBinProbability(i) * total / biased[i];
+            }
+            fBiasCDF.back() = 1.;
+            if (report) {
+                G4double wMin = 0., wMax = 0.;
+                for (G4int i = 0; i < fNDirBins; i++) {
+                    if (DirectionBinProbability(i) <= 0.) continue;
+                    wMin = (wMin > 0.) ? std::min(wMin, fBiasWeight[i]) : fBiasWeight[i];
+                    wMax = std::max(wMax, fBiasWeight[i]);
+                }
+                G4cout << "Source direction bias: bin weights " << wMin << " to " << wMax
+                       << G4endl;
+            }
+        }
+    }
+    
+    if (config.HasCone()) {
+        const G4ThreeVector d = config.GetConeTarget() * cm - fSourcePos;
+        if (std::hypot(d.x(), d.y()) < 1e-6 * d.mag()) {
+            G4Exception("NESSAPrimaryGeneratorAction::UpdateBias", "Source003", JustWarning,
+                "The cone target is on the source axis: no azimuthal biasing");
+        } else {
+            fConePhi = std::atan2(d.y(), d.x());
+            fConeHalfWidth = config.GetConeHalfWidth() * deg;
+            fConeFraction = config.GetConeFraction();
+            if (report) {
+                G4cout << "Source azimuthal cone: " << fConePhi / deg << " +- "
+                       << fConeHalfWidth / deg << " deg, fraction " << fConeFraction
+                       << G4endl;
+            }
+        }
+    }
 }
 
 G4double NESSAPrimaryGeneratorAction::SampleEnergy(G4int dirBin)
+{
+    if (dirBin < 0 || dirBin >= (G4int)fEnergyCDFs.size() ||
+        fEnergyCDFs[dirBin].empty() || fEnergyCDFs[dirBin].back() <= 0) {
+        return 14.1*MeV;  // Fallback: monoenergetic DT
+    }
+    G4double r1 = G4UniformRand();
+    G4double r2 = G4UniformRand();
+    return EnergyFromUniforms(dirBin, r1, r2);
+}
+
+G4double NESSAPrimaryGeneratorAction::EnergyFromUniforms(
+    G4int dirBin, G4double r1, G4double r2) const
 {
     if (dirBin < 0 || dirBin >= (G4int)fEnergyCDFs.size()) {
         return 14.1*MeV;  // Fallback: monoenergetic DT
@@ -149,8 +268,7 @@ G4double NESSAPrimaryGeneratorAction::SampleEnergy(G4int dirBin)
         return 14.1*MeV;
     }
     
-    G4double r = G4UniformRand();
-    auto it = std::lower_bound(cdf.begin(), cdf.end(), r);
+    auto it = std::lower_bound(cdf.begin(), cdf.end(), r1);
     G4int idx = std::distance(cdf.begin(), it);
     
     if (idx <= 0) idx = 1;
@@ -159,13 +277,98 @@ G4double NESSAPrimaryGeneratorAction::SampleEnergy(G4int dirBin)
     // Linear interpolation within the bin
     G4double elow = fEnergyBins[idx-1];
     G4double ehigh = fEnergyBins[idx];
-    G4double frac = G4UniformRand();
     
-    return (elow + frac * (ehigh - elow)) * MeV;
+    return (elow + r2 * (ehigh - elow)) * MeV;
+}
+
+G4double NESSAPrimaryGeneratorAction::DirectionBinProbability(G4int dirBin) const
+{
+    if (dirBin < 0 || dirBin >= fNDirBins) return 0.;
+    return (dirBin == 0) ? fDirCDF[0] : fDirCDF[dirBin] - fDirCDF[dirBin-1];
+}
+
+void NESSAPrimaryGeneratorAction::DirectionBinRange(G4int dirBin, G4double& muLo,
+                                                    G4double& muHi) const
+{
+    dirBin = std::max(0, std::min(dirBin, fNDirBins - 1));
+    muHi = fDirBins[dirBin];
+    muLo = (dirBin == 0) ? muHi : fDirBins[dirBin-1];
+}
+
+G4double NESSAPrimaryGeneratorAction::EnergyFraction(G4int dirBin, G4double eLo,
+                                                     G4double eHi) const
+{
+    // As EnergyFromUniforms: uniform within each energy bin, the mass of
+    // the first CDF entry in the first bin
+    if (dirBin < 0 || dirBin >= (G4int)fEnergyCDFs.size() || fEnergyCDFs[dirBin].empty()
+        || fEnergyCDFs[dirBin].back() <= 0) {
+        return (eLo < 14.1 && 14.1 <= eHi) ? 1. : 0.;
+    }
+    const auto& cdf = fEnergyCDFs[dirBin];
+    G4double fraction = 0.;
+    for (G4int i = 1; i < fNEnergyBins; i++) {
+        G4double p = cdf[i] - cdf[i-1] + (i == 1 ? cdf[0] : 0.);
+        G4double lo = fEnergyBins[i-1], hi = fEnergyBins[i];
+        G4double overlap = std::min(hi, eHi) - std::max(lo, eLo);
+        if (p > 0. && overlap > 0.) fraction += p * ((hi > lo) ? overlap / (hi - lo) : 1.);
+    }
+    return fraction;
+}
+
+G4double NESSAPrimaryGeneratorAction::EmissionDensity(
+    const G4ThreeVector& dir, G4int& dirBin) const
+{
+    // Bin i > 0 covers cos(theta) in [fDirBins[i-1], fDirBins[i]] and is
+    // sampled uniformly in cos(theta) and azimuth (see GeneratePrimaries)
+    G4double mu = dir.dot(fSourceAxis);
+    auto it = std::lower_bound(fDirBins.begin(), fDirBins.end(), mu);
+    dirBin = std::distance(fDirBins.begin(), it);
+    if (dirBin <= 0 || dirBin >= fNDirBins) return 0.;
+    
+    G4double width = fDirBins[dirBin] - fDirBins[dirBin-1];
+    G4double prob = fDirCDF[dirBin] - fDirCDF[dirBin-1];
+    return (width > 0) ? prob / (twopi * width) : 0.;
+}
+
+uint64_t NESSAPrimaryGeneratorAction::EventKey(const G4Event* event) const
+{
+    // The run action knows the history numbering of a resumed run
+    const auto* runAction = dynamic_cast<const NESSARunAction*>(
+        G4RunManager::GetRunManager()->GetUserRunAction());
+    if (runAction) return runAction->EventKey(event->GetEventID());
+    const auto& config = NESSARunConfig::Instance();
+    G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+    uint64_t key = NESSAMixBits((uint64_t)config.GetEventSeed());
+    key = NESSAMixBits(key ^ (uint64_t)runID);
+    return NESSAMixBits(key ^ (uint64_t)(config.GetEventOffset() + event->GetEventID()));
+}
+
+void NESSAPrimaryGeneratorAction::SeedEvent(uint64_t key)
+{
+    if (NESSARunConfig::Instance().GetEventSeed() == 0) return;
+    
+    // The worker run managers also reseed per event, but from a master
+    // stream whose assignment depends on thread scheduling; override it
+    // with a pure function of (seed, run, history), which a resumed run
+    // continues where the checkpoint left off.
+    
+    // Two non-zero 31-bit seeds, zero-terminated (valid for all engines)
+    long seeds[3];
+    seeds[0] = (long)(key & 0x7FFFFFFF);
+    seeds[1] = (long)((key >> 32) & 0x7FFFFFFF);
+    seeds[2] = 0;
+    if (seeds[0] == 0) seeds[0] = 1;
+    if (seeds[1] == 0) seeds[1] = 1;
+    G4Random::setTheSeeds(seeds);
 }
 
 void NESSAPrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
 {
+    const uint64_t key = EventKey(anEvent);
+    SeedEvent(key);
+    UpdateBias();
+    G4double weight = 1.;
+    
     // 1. Sample position on uniform disk (sp3 -21 1 = power law r^1)
     G4double r = fSourceRadius * std::sqrt(G4UniformRand());
     G4double phi = twopi * G4UniformRand();
@@ -175,7 +378,7 @@ void NESSAPrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
     pos += G4ThreeVector(r * std::cos(phi), r * std::sin(phi), 0.);
     
     // 2. Sample direction bin (determines both direction and energy)
-    G4int dirBin = SampleDirectionBin();
+    G4int dirBin = SampleDirectionBin(weight);
     
     // Get the direction cosine (cos theta relative to source axis)
     G4double cosTheta;
@@ -193,7 +396,7 @@ void NESSAPrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
     // Convert to direction vector
     // cosTheta is relative to the source axis (0,0,1)
     G4double sinTheta = std::sqrt(1. - cosTheta*cosTheta);
-    G4double phiDir = twopi * G4UniformRand();
+    G4double phiDir = SampleAzimuth(weight);
     
     G4ThreeVector direction(
         sinTheta * std::cos(phiDir),
@@ -210,4 +413,12 @@ void NESSAPrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
     fParticleGun->SetParticleEnergy(energy);
     
     fParticleGun->GeneratePrimaryVertex(anEvent);
+    anEvent->GetPrimaryVertex()->GetPrimary()->SetWeight(weight);
+    
+    // Point detectors: expected flux from this source emission. This is
+    // taken over the analog emission density, whatever direction was
+    // drawn, so it keeps the unbiased source weight.
+    auto& nextEvent = NESSANextEventEstimator::Instance();
+    if (nextEvent.IsEnabled())
+        nextEvent.ScoreSource(pos, 1., key, *this);
 }
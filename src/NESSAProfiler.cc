@@ -0,0 +1,49 @@
+#include "NESSAProfiler.hh"
+
+#ifdef NESSA_PROFILE_USER_ACTIONS
+
+#include "G4ios.hh"
+#include "G4Threading.hh"
+#include <iomanip>
+
+G4ThreadLocal G4long   NESSAProfiler::fCalls[kNSlots] = {0};
+G4ThreadLocal G4double NESSAProfiler::fNanoseconds[kNSlots] = {0};
+
+void NESSAProfiler::Reset()
+{
+    for (G4int i = 0; i < kNSlots; i++) { fCalls[i] = 0; fNanoseconds[i] = 0; }
+}
+
+void NESSAProfiler::Print()
+{
+    // Cost of an empty timed scope, subtracted from every call
+    const G4int nCalib = 100000;
+    G4long   calls0 = fCalls[kSteppingAction];
+    G4double ns0    = fNanoseconds[kSteppingAction];
+    for (G4int i = 0; i < nCalib; i++) {
+        NESSAScopedTimer t(kSteppingAction);
+    }
+    G4double overhead = (fNanoseconds[kSteppingAction] - ns0) / nCalib;
+    fCalls[kSteppingAction] = calls0;
+    fNanoseconds[kSteppingAction] = ns0;
+    
+    static const char* names[kNSlots] = {"UserSteppingAction", "ProcessHits",
+                                         "SD EndOfEvent", "NextEvent collision",
+                                         "Mesh tally step", "Surface crossing",
+                                         "Cell tally step", "Weight window",
+                                         "Window generator"};
+    G4cout << "  --- User action profile (thread " << G4Threading::G4GetThreadId()
+           << ", timer overhead " << std::fixed << std::setprecision(1)
+           << overhead << " ns subtracted) ---" << G4endl;
+    for (G4int i = 0; i < kNSlots; i++) {
+        if (fCalls[i] == 0) continue;
+        G4double perCall = fNanoseconds[i] / fCalls[i] - overhead;
+        G4cout << "  " << std::left << std::setw(20) << names[i]
+               << std::right << std::setw(14) << fCalls[i] << " calls"
+               << std::setw(10) << perCall << " ns/call"
+               << std::setw(10) << perCall * fCalls[i] * 1e-9 << " s total"
+               << G4endl;
+    }
+}
+
+#endif
@@ -1,44 +1,53 @@
 #include "NESSARunAction.hh"
 #include "NESSASteppingAction.hh"
 #include "NESSAScoringConfig.hh"
+#include "NESSAScoringSD.hh"
+#include "NESSARunSummary.hh"
+#include "NESSARunConfig.hh"
+#include "NESSACheckpoint.hh"
+#include "NESSAProfiler.hh"
+#include "NESSANextEventEstimator.hh"
+#include "NESSADoseConversion.hh"
+#include "NESSAPrecisionMonitor.hh"
+#include "NESSAMeshConfig.hh"
+#include "NESSASurfaceConfig.hh"
+#include "NESSACellConfig.hh"
+#include "NESSAWeightWindowConfig.hh"
+#include "NESSAEnergyBinning.hh"
+#include "NESSASplitMix.hh"
 
 #include "G4Run.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4AnalysisManager.hh"
+#include "G4AccumulableManager.hh"
+#include "G4SDManager.hh"
+#include "G4Threading.hh"
 #include <iomanip>
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <array>
 
 NESSARunAction::NESSARunAction(NESSASteppingAction* stepping)
-    : fSteppingAction(stepping)
+    : fSteppingAction(stepping), fNextEvent("nextEvent"),
+      fActivationTallies("activationTallies"), fSurfaceTallies("surfaceTallies"),
+      fMeshTallies(stepping ? &stepping->GetMeshTallies() : &fOwnMeshTallies),
+      fCellTallies(stepping ? &stepping->GetCellTallies() : &fOwnCellTallies),
+      fCellImportance(stepping ? &stepping->GetCellImportance() : &fOwnCellImportance),
+      fWeightWindow(stepping ? &stepping->GetWeightWindow() : &fOwnWeightWindow),
+      fWindowGenerator(stepping ? &stepping->GetWindowGenerator() : &fOwnWindowGenerator)
 {
     auto am = G4AnalysisManager::Instance();
     am->SetVerboseLevel(1);
     am->SetFileName("nessa_output.root");
+    // In MT/tasking mode histograms are merged by the master automatically;
+    // ntuple rows from the workers are merged into the master file too.
+    am->SetNtupleMerging(true);
     
     G4cout << "Analysis manager type: " << am->GetType() << G4endl;
     
-    const auto& pts = NESSAScoringConfig::Instance().GetPoints();
-    G4int N = NESSAScoringConfig::Instance().GetNActive();
-    
-    // --- Neutron histograms: IDs 0..(2N-1) ---
-    for (const auto& p : pts) {
-        if (!p.active) continue;
-        am->CreateH1("n_spec_" + p.name,
-            "Neutron spectrum " + p.name, 300, 1e-9, 20.0);
-        am->CreateH1("n_dose_" + p.name,
-            "Neutron Edep " + p.name, 300, 1e-9, 20.0);
-    }
-    
-    // --- Photon histograms: IDs 2N..(4N-1) ---
-    for (const auto& p : pts) {
-        if (!p.active) continue;
-        am->CreateH1("g_spec_" + p.name,
-            "Photon spectrum " + p.name, 200, 0.0, 10.0);
-        am->CreateH1("g_dose_" + p.name,
-            "Photon Edep " + p.name, 200, 0.0, 10.0);
-    }
+    // Detector histograms are booked per run (BookDetectorHistograms),
+    // since the detector layout can change between runs
     
     // --- Ntuple 0: Point detector scoring ---
     am->CreateNtuple("scoring", "Point detector data");
@@ -47,6 +56,7 @@ NESSARunAction::NESSARunAction(NESSASteppingAction* stepping)
     am->CreateNtupleDColumn("edep_MeV");    // 2
     am->CreateNtupleDColumn("trackLen_cm"); // 3
     am->CreateNtupleIColumn("particle");    // 4: 0=n, 1=gamma
+    am->CreateNtupleDColumn("rowWeight");   // 5: 1/fraction when sampled
     am->FinishNtuple();
     
     // --- Ntuple 1: Activation products (all isotopes) ---
@@ -63,20 +73,512 @@ NESSARunAction::NESSARunAction(NESSASteppingAction* stepping)
     am->CreateNtupleSColumn("process");      // 9
     am->CreateNtupleDColumn("halfLife_s");   // 10
     am->FinishNtuple();
+    
+    // Activation tables and tally moments: registered on master and
+    // workers alike, in the same order
+    auto accMgr = G4AccumulableManager::Instance();
+    accMgr->RegisterAccumulable(&fActivation);
+    accMgr->RegisterAccumulable(&fTallies);
+    accMgr->RegisterAccumulable(&fNextEvent);
+    accMgr->RegisterAccumulable(&fActivationTallies);
+    accMgr->RegisterAccumulable(fMeshTallies);
+    accMgr->RegisterAccumulable(&fSurfaceTallies);
+    accMgr->RegisterAccumulable(fCellTallies);
+    accMgr->RegisterAccumulable(fCellImportance);
+    accMgr->RegisterAccumulable(fWeightWindow);
+    accMgr->RegisterAccumulable(fWindowGenerator);
+}
+
+/// This thread's scoring SD (none on the MT master)
+static NESSAScoringSD* FindScoringSD()
+{
+    auto* sdm = G4SDManager::GetSDMpointerIfExist();
+    if (!sdm) return nullptr;
+    return dynamic_cast<NESSAScoringSD*>(
+        sdm->FindSensitiveDetector("ScoringSD", false));
+}
+
+/// Tally objects a summary is filled from or restored into
+enum TallySource { kScoringTallies, kNextEventTallies, kActivationTallies,
+                   kSurfaceTallies };
+template <class T> using TallySources = std::array<T*, 4>;
+
+/// Tally bins in summary order: track length (particle 0 = n, 1 = gamma)
+/// for every active detector, next-event estimates (2 = n, 3 = gamma) for
+/// the detectors that use it, then the dose of each (4/5 from the track
+/// length, 6/7 from the next-event flux), then the activation tallies
+/// (8), then the surface current of every surface (10/11) and the
+/// fluence of the discs (12/13). Bin 2*idx + (0/1), offset by 2*nActive
+/// for dose (2*nSurfaces for fluence); idx = active rank.
+/// f(name, particle, source, bin)
+template <class F>
+static void ForEachTallyBin(F&& f)
+{
+    const auto& config = NESSAScoringConfig::Instance();
+    const G4int doseOffset = 2 * config.GetNActive();
+    for (G4int pass = 0; pass < 4; pass++) {
+        G4bool isNextEvent = (pass % 2 == 1);
+        TallySource source = isNextEvent ? kNextEventTallies : kScoringTallies;
+        G4int offset = (pass >= 2) ? doseOffset : 0;
+        G4int idx = 0;
+        for (const auto& p : config.GetPoints()) {
+            if (!p.active) continue;
+            if (!isNextEvent || p.nextEvent) {
+                for (G4int part = 0; part < 2; part++)
+                    f(p.name, 2*pass + part, source, offset + 2*idx + part);
+            }
+            idx++;
+        }
+    }
+    
+    static const char* activation[NESSASteppingAction::kNActivationTallies] =
+        {"Ar-41", "radioactive"};
+    for (G4int bin = 0; bin < NESSASteppingAction::kNActivationTallies; bin++)
+        f(activation[bin], 8, kActivationTallies, bin);
+    
+    const auto& surfaces = NESSASurfaceConfig::Instance().GetSurfaces();
+    const G4int fluenceOffset = 2 * (G4int)surfaces.size();
+    for (G4int pass = 0; pass < 2; pass++) {
+        for (size_t idx = 0; idx < surfaces.size(); idx++) {
+            if (pass == 1 && surfaces[idx].radius <= 0.) continue;  // planes: no fluence
+            for (G4int part = 0; part < 2; part++)
+                f(surfaces[idx].name, 10 + 2*pass + part, kSurfaceTallies,
+                  pass * fluenceOffset + 2*(G4int)idx + part);
+        }
+    }
+}
+
+static void FillTallyEntries(NESSARunSummary& summary,
+                             const TallySources<const NESSATallyStats>& sources)
+{
+    ForEachTallyBin([&](const G4String& name, G4int particle, TallySource source,
+                        G4int bin) {
+        const auto* t = sources[source];
+        if (!t || bin >= t->GetNBins()) return;
+        summary.tallies.push_back({name, particle, t->GetMoments(bin),
+                                   t->GetChart(bin), t->GetTail(bin)});
+    });
 }
 
 NESSARunAction::~NESSARunAction() {}
 
+/// Book a spectrum histogram (id < 0) or rebin it to an energy binning
+/// spec; returns its ID. Equal-width bins are booked as fixed binning.
+static G4int BookSpectrum(G4int id, const G4String& name, const G4String& title,
+                          const G4String& spec)
+{
+    auto am = G4AnalysisManager::Instance();
+    std::vector<G4double> edges;
+    G4String error;
+    if (!NESSAEnergyBinning::MakeEdges(spec, edges, error)) {
+        // Checked by the messenger; only a file that went away gets here
+        G4Exception("NESSARunAction::BookSpectrum", "Binning002", JustWarning,
+            (name + ": " + error + ", using the default binning").c_str());
+        G4bool neutron = name.compare(0, 2, "n_") == 0;
+        return BookSpectrum(id, name, title, neutron ? NESSAEnergyBinning::kDefaultNeutron
+                                                     : NESSAEnergyBinning::kDefaultPhoton);
+    }
+    const G4int n = (G4int)edges.size() - 1;
+    if (NESSAEnergyBinning::IsLinear(spec)) {
+        if (id < 0) return am->CreateH1(name, title, n, edges.front(), edges.back());
+        am->SetH1(id, n, edges.front(), edges.back());
+    } else {
+        if (id < 0) return am->CreateH1(name, title, edges);
+        am->SetH1(id, edges);
+    }
+    return id;
+}
+
+void NESSARunAction::BookDetectorHistograms()
+{
+    // Four histograms per detector name, created the first time the name
+    // is seen and never deleted: a detector keeps its IDs across layout
+    // changes, and every thread books the same names in the same order.
+    // Histograms of detectors outside the current layout are deactivated
+    // (neither filled nor written).
+    auto am = G4AnalysisManager::Instance();
+    auto& config = NESSAScoringConfig::Instance();
+    
+    // The binning is per detector and particle (/nessa/detector/binning);
+    // a histogram is rebinned when its detector's binning changes.
+    static const char* kinds[4] = {"n_spec_", "n_dose_", "g_spec_", "g_dose_"};
+    static const char* titles[4] = {"Neutron spectrum ", "Neutron dose [pSv] ",
+                                    "Photon spectrum ", "Photon dose [pSv] "};
+    for (const auto& name : config.GetAllNames()) {
+        if (am->GetH1Id("n_spec_" + name, false) >= 0) continue;
+        for (G4int k = 0; k < 4; k++) {
+            G4String spec = (k < 2) ? NESSAEnergyBinning::kDefaultNeutron
+                                    : NESSAEnergyBinning::kDefaultPhoton;
+            BookSpectrum(-1, kinds[k] + name, titles[k] + name, spec);
+            fSpectrumBinning[kinds[k] + name] = spec;
+        }
+    }
+    for (const auto& p : config.GetPoints()) {
+        if (!p.active) continue;
+        for (G4int k = 0; k < 4; k++) {
+            G4String spec = NESSAScoringConfig::GetBinning(p, k / 2);
+            G4String hName = kinds[k] + p.name;
+            if (fSpectrumBinning[hName] == spec) continue;
+            BookSpectrum(am->GetH1Id(hName), hName, titles[k] + p.name, spec);
+            fSpectrumBinning[hName] = spec;
+        }
+    }
+    
+    G4int first = am->GetFirstH1Id();
+    for (G4int id = first; id < first + am->GetNofH1s(); id++)
+        am->SetH1Activation(id, false);
+    
+    std::vector<G4int> ids;  // 4 per active detector, for the SD
+    for (const auto& p : config.GetPoints()) {
+        if (!p.active) continue;
+        for (const char* kind : kinds) {
+            G4int id = am->GetH1Id(kind + p.name);
+            am->SetH1Activation(id, true);
+            ids.push_back(id);
+        }
+    }
+    
+    // Time tallies: a time spectrum and an energy x time array per particle
+    // for the detectors that have time bins, booked when first needed
+    // (the same on every thread) and rebinned like the spectra
+    static const char* timeKinds[2] = {"n_time_", "g_time_"};
+    static const char* timeEnergyKinds[2] = {"n_etime_", "g_etime_"};
+    std::vector<G4int> timeIds(2 * config.GetNActive(), -1);
+    std::vector<G4int> timeEnergyIds(2 * config.GetNActive(), -1);
+    G4int idx = 0;
+    for (const auto& p : config.GetPoints()) {
+        if (!p.active) continue;
+        for (G4int part = 0; part < 2 && !p.timeBinning.empty(); part++) {
+            std::vector<G4double> tEdges, eEdges;
+            G4String error;
+            G4String eSpec = NESSAScoringConfig::GetTimeEnergyBinning(p, part);
+            NESSAEnergyBinning::MakeEdges(p.timeBinning, tEdges, error);
+            NESSAEnergyBinning::MakeEdges(eSpec, eEdges, error);
+            G4String hName = timeKinds[part] + p.name;
+            G4String h2Name = timeEnergyKinds[part] + p.name;
+            G4String title = (part == 0 ? "Neutron " : "Photon ");
+            G4int id = am->GetH1Id(hName, false);
+            G4int id2 = am->GetH2Id(h2Name, false);
+            G4String booked = p.timeBinning + " x " + eSpec;
+            if (id < 0) {
+                id = am->CreateH1(hName, title + "time spectrum t [s] " + p.name, tEdges);
+                id2 = am->CreateH2(h2Name, title + "E [MeV] x t [s] " + p.name,
+                                   eEdges, tEdges);
+            } else if (fSpectrumBinning[hName] != booked) {
+                am->SetH1(id, tEdges);
+                am->SetH2(id2, eEdges, tEdges);
+            }
+            fSpectrumBinning[hName] = booked;
+            am->SetH1Activation(id, true);
+            timeIds[2*idx + part] = id;
+            timeEnergyIds[2*idx + part] = id2;
+        }
+        idx++;
+    }
+    
+    // Energy x cosine of the surface crossings, booked the same way
+    auto& surfaceConfig = NESSASurfaceConfig::Instance();
+    for (const auto& name : surfaceConfig.GetAllNames()) {
+        if (am->GetH2Id("n_surf_" + name, false) >= 0) continue;
+        am->CreateH2("n_surf_" + name, "Neutron crossings E [MeV] x cos " + name,
+                     108, 1e-9, 20.0, 20, -1.0, 1.0, "none", "none", "none", "none",
+                     "log", "linear");
+        am->CreateH2("g_surf_" + name, "Photon crossings E [MeV] x cos " + name,
+                     100, 1e-3, 10.0, 20, -1.0, 1.0, "none", "none", "none", "none",
+                     "log", "linear");
+    }
+    G4int firstH2 = am->GetFirstH2Id();
+    for (G4int id = firstH2; id < firstH2 + am->GetNofH2s(); id++)
+        am->SetH2Activation(id, false);
+    std::vector<G4int> surfaceIds;  // 2 per surface, for the stepping action
+    for (const auto& s : surfaceConfig.GetSurfaces()) {
+        for (const char* kind : {"n_surf_", "g_surf_"}) {
+            G4int id = am->GetH2Id(kind + s.name);
+            am->SetH2Activation(id, true);
+            surfaceIds.push_back(id);
+        }
+    }
+    for (G4int id : timeEnergyIds) {
+        if (id >= 0) am->SetH2Activation(id, true);
+    }
+    
+    // Scoring ntuple is not written at all in "off" mode
+    am->SetNtupleActivation(0, NESSARunConfig::Instance().GetScoringNtupleMode()
+                               != NESSARunConfig::kNtupleOff);
+    am->SetActivation(true);
+    if (auto* sd = FindScoringSD()) {
+        sd->SetHistogramIDs(ids);
+        sd->SetTimeHistogramIDs(timeIds, timeEnergyIds);
+    }
+    if (fSteppingAction) fSteppingAction->GetSurfaceTallies().SetHistogramIDs(surfaceIds);
+}
+
 void NESSARunAction::BeginOfRunAction(const G4Run* run)
 {
     G4cout << "\n### Run " << run->GetRunID() << " start ("
            << run->GetNumberOfEventToBeProcessed() << " events)" << G4endl;
     fTimer.Start();
+    NESSA_PROFILE_RESET();
     
+    const auto& surfaces = NESSASurfaceConfig::Instance().GetSurfaces();
+    if (fSteppingAction) fSteppingAction->GetSurfaceTallies().SetUp(surfaces);
+    BookDetectorHistograms();
     if (fSteppingAction) fSteppingAction->Reset();
+    const G4double timeCutoff = NESSAScoringConfig::Instance().GetTimeCutoff();
+    if (fSteppingAction) fSteppingAction->SetTimeCutoff(timeCutoff * s);
+    if (IsMaster() && timeCutoff > 0.) {
+        G4cout << "Time cutoff: tracks are killed after " << std::scientific
+               << std::setprecision(3) << timeCutoff << " s" << G4endl;
+    }
+    fTallies.SetNBins(4 * NESSAScoringConfig::Instance().GetNActive());
+    fNextEvent.SetNBins(4 * NESSAScoringConfig::Instance().GetNActive());
+    fActivationTallies.SetNBins(NESSASteppingAction::kNActivationTallies);
+    fSurfaceTallies.SetNBins(4 * (G4int)surfaces.size());
+    fMeshTallies->SetUp(NESSAMeshConfig::Instance().GetMeshes());
+    if (IsMaster() && !fMeshTallies->IsEmpty()) {
+        G4cout << "Mesh tallies: " << fMeshTallies->GetNBins() << " bins ("
+               << std::fixed << std::setprecision(1)
+               << 3. * 8. * fMeshTallies->GetNBins() / (1024. * 1024.)
+               << " MB per thread if every tile is scored)" << G4endl;
+    }
+    const auto cellResponse = NESSACellConfig::Instance().GetResponse();
+    fCellTallies->SetUp(cellResponse);
+    if (IsMaster() && !fCellTallies->IsEmpty()) {
+        G4cout << "Cell tally: " << NESSACellConfig::ResponseName(cellResponse)
+               << " in " << fCellTallies->GetNCells() << " cells" << G4endl;
+    }
+    const auto& importances = NESSACellConfig::Instance().GetImportances();
+    fCellImportance->SetUp(importances);
+    if (IsMaster() && !fCellImportance->IsEmpty()) {
+        G4cout << "Cell importances: " << importances.size() << " cells listed"
+               << G4endl;
+        if (fCellImportance->GetNUnknownCells() > 0) {
+            G4Exception("NESSARunAction::BeginOfRunAction", "Cell004", JustWarning,
+                (std::to_string(fCellImportance->GetNUnknownCells())
+                 + " cells with importances are not in the geometry").c_str());
+        }
+        const auto& unlisted = fCellImportance->GetUnlistedCells();
+        if (!unlisted.empty()) {
+            G4String cells;
+            for (size_t i = 0; i < unlisted.size() && i < 10; i++)
+                cells += " " + std::to_string(unlisted[i]);
+            if (unlisted.size() > 10) cells += " ...";
+            G4Exception("NESSARunAction::BeginOfRunAction", "Cell007", JustWarning,
+                (std::to_string(unlisted.size()) + " geometry cells have no importance"
+                 " and take that of the cell around them (world: 1):" + cells).c_str());
+        }
+    }
+    fWeightWindow->SetUp();
+    if (IsMaster() && !fWeightWindow->IsEmpty()) {
+        const auto mesh = NESSAWeightWindowConfig::Instance().GetMesh();
+        G4cout << "Weight windows: " << mesh->NBins(0) << "x" << mesh->NBins(1) << "x"
+               << mesh->NBins(2) << (mesh->geometry == NESSAWeightWindowMesh::kCartesian
+                                     ? " Cartesian" : " cylindrical")
+               << " mesh, " << mesh->energies[0].size() << " n / "
+               << mesh->energies[1].size() << " gamma groups" << G4endl;
+        for (G4int p = 0; p < 2 && !fCellImportance->IsEmpty(); p++) {
+            if (!fCellImportance->IsWindowed(p)) continue;
+            G4Exception("NESSARunAction::BeginOfRunAction", "WW007", JustWarning,
+                (G4String(p == 0 ? "Neutron" : "Gamma") + " weight windows replace"
+                 " the cell importances; only importance 0 still kills").c_str());
+        }
+    }
+    const auto& wwConfig = NESSAWeightWindowConfig::Instance();
+    fWindowGenerator->SetUp();
+    if (IsMaster() && wwConfig.GetGeneratorMesh()) {
+        const G4int nTargets = fWindowGenerator->GetNTargets();
+        if (nTargets < (G4int)wwConfig.GetTargets().size()) {
+            G4Exception("NESSARunAction::BeginOfRunAction", "WW005", JustWarning,
+                (std::to_string(wwConfig.GetTargets().size() - nTargets)
+                 + " generator targets are not active detectors"
+                 + (nTargets == 0 ? "; no windows are generated" : "")).c_str());
+        }
+        if (!fWindowGenerator->IsEmpty()) {
+            G4cout << "Weight-window generator: pass "
+                   << wwConfig.GetPasses().size() + 1 << ", " << nTargets
+                   << " target detectors" << G4endl;
+        }
+    }
+    G4AccumulableManager::Instance()->Reset();
+    if (auto* sd = FindScoringSD()) sd->GetTallies().Reset();
+    NESSANextEventEstimator::Instance().BeginOfRun();
+    if (auto* sd = FindScoringSD()) {
+        NESSAPrecisionMonitor::Instance().BeginOfRun(IsMaster(), &sd->GetTallies(),
+            &NESSANextEventEstimator::Instance().GetTallies());
+    } else {
+        NESSAPrecisionMonitor::Instance().BeginOfRun(IsMaster(), nullptr, nullptr);
+    }
     
     auto am = G4AnalysisManager::Instance();
     am->OpenFile();
+    
+    fRestoredEvents = 0;
+    fRestoredTime = 0.;
+    fSeedRunID = run->GetRunID();
+    fRunStart = std::chrono::steady_clock::now();
+    fEventsTotal = run->GetNumberOfEventToBeProcessed();
+    fLastCheckpointEvents = 0;
+    fLastCheckpointTime = std::chrono::steady_clock::now();
+    
+    auto& runConfig = NESSARunConfig::Instance();
+    if (G4Threading::IsMultithreadedApplication()) {
+        if (IsMaster() && runConfig.CheckpointingEnabled()) {
+            G4Exception("NESSARunAction::BeginOfRunAction", "Checkpoint003",
+                JustWarning, "Checkpointing is only supported in serial mode");
+        }
+    } else if (!runConfig.GetResumeFile().empty()) {
+        RestoreCheckpoint(runConfig.GetResumeFile());
+        runConfig.SetResumeFile("");
+    }
+}
+
+void NESSARunAction::RestoreCheckpoint(const G4String& file)
+{
+    G4int total = 0, runID = -1;
+    NESSACheckpoint::Precision precision;
+    NESSARunSummary state;
+    if (!NESSACheckpoint::Read(file, total, runID, precision, state)) {
+        G4Exception("NESSARunAction::RestoreCheckpoint", "Checkpoint004",
+            FatalException, ("Cannot read checkpoint " + file).c_str());
+        return;
+    }
+    
+    // Tally moments go back into the SD, activation tables into the
+    // stepping action, so accumulation continues from the same partial sums
+    auto* sd = FindScoringSD();
+    TallySources<NESSATallyStats> sources = {
+        sd ? &sd->GetTallies() : nullptr,
+        &NESSANextEventEstimator::Instance().GetTallies(),
+        fSteppingAction ? &fSteppingAction->GetActivationTallies() : nullptr,
+        fSteppingAction ? &fSteppingAction->GetSurfaceTallies().GetTallies() : nullptr};
+    NESSARunSummary current;
+    if (sd) FillTallyEntries(current, {sources[0], sources[1], sources[2], sources[3]});
+    G4bool layoutOK = sd && current.tallies.size() == state.tallies.size();
+    for (size_t i = 0; layoutOK && i < state.tallies.size(); i++) {
+        layoutOK = current.tallies[i].name == state.tallies[i].name &&
+                   current.tallies[i].particle == state.tallies[i].particle;
+    }
+    if (!layoutOK) {
+        G4Exception("NESSARunAction::RestoreCheckpoint", "Checkpoint005",
+            FatalException, "Detector configuration differs from the checkpoint");
+        return;
+    }
+    size_t i = 0;
+    ForEachTallyBin([&](const G4String&, G4int, TallySource source, G4int bin) {
+        auto* t = sources[source];
+        if (!t || bin >= t->GetNBins()) return;
+        const auto& entry = state.tallies[i++];
+        t->SetState(bin, entry.moments, entry.chart, entry.tail);
+    });
+    if (fSteppingAction) {
+        fSteppingAction->SetProduction(state.globalProd, state.volumeProd);
+    }
+    
+    if (!NESSACheckpoint::RestoreHistogramsAndEngine(file)) {
+        G4Exception("NESSARunAction::RestoreCheckpoint", "Checkpoint006",
+            FatalException, ("Cannot restore histograms from " + file).c_str());
+        return;
+    }
+    
+    fRestoredEvents = (G4int)state.nEvents;
+    fRestoredTime = state.runTime;
+    if (runID >= 0) fSeedRunID = runID;
+    NESSAPrecisionMonitor::Instance().Resume(fRestoredEvents, fRestoredTime);
+    fEventsTotal = total;
+    fLastCheckpointEvents = fRestoredEvents;
+    G4cout << "Restored checkpoint " << file << " at event " << fRestoredEvents
+           << " of " << fEventsTotal << G4endl;
+    
+    // State outside the histograms, tallies and activation tables is not
+    // in the checkpoint: it covers only this session's events
+    std::vector<G4String> lost;
+    if (!NESSAMeshConfig::Instance().GetMeshes().empty()) lost.push_back("mesh tallies");
+    if (NESSACellConfig::Instance().IsEnabled()) lost.push_back("cell tallies");
+    if (!fCellImportance->IsEmpty()) lost.push_back("cell-importance counts");
+    if (!fWeightWindow->IsEmpty()) lost.push_back("weight-window counts");
+    if (!fWindowGenerator->IsEmpty()) lost.push_back("weight-window generator estimates");
+    if (!lost.empty()) {
+        G4String list;
+        for (const auto& item : lost) list += (list.empty() ? "" : ", ") + item;
+        G4Exception("NESSARunAction::RestoreCheckpoint", "Checkpoint007", JustWarning,
+            ("Not checkpointed, so without the " + std::to_string(fRestoredEvents)
+             + " restored events: " + list).c_str());
+    }
+}
+
+G4double NESSARunAction::RunTime() const
+{
+    std::chrono::duration<G4double> dt = std::chrono::steady_clock::now() - fRunStart;
+    return fRestoredTime + dt.count();
+}
+
+G4long NESSARunAction::HistoryIndex(G4int eventID) const
+{
+    // Event IDs are global in MT, so every thread numbers an event the
+    // same way, and a resumed run continues the original numbering
+    return fRestoredEvents + (G4long)eventID;
+}
+
+uint64_t NESSARunAction::EventKey(G4int eventID) const
+{
+    const auto& config = NESSARunConfig::Instance();
+    uint64_t key = NESSAMixBits((uint64_t)config.GetEventSeed());
+    key = NESSAMixBits(key ^ (uint64_t)fSeedRunID);
+    return NESSAMixBits(key ^ (uint64_t)(config.GetEventOffset() + HistoryIndex(eventID)));
+}
+
+void NESSARunAction::CheckpointIfDue(G4int eventID)
+{
+    const auto& runConfig = NESSARunConfig::Instance();
+    if (!runConfig.CheckpointingEnabled() ||
+        G4Threading::IsMultithreadedApplication()) return;
+    
+    // Serial: events are processed in order, so this is the event count
+    G4int done = fRestoredEvents + eventID + 1;
+    if (done >= fEventsTotal) return;  // the final output follows anyway
+    
+    G4bool due = runConfig.GetCheckpointEvery() > 0 &&
+                 done - fLastCheckpointEvents >= runConfig.GetCheckpointEvery();
+    if (!due && runConfig.GetCheckpointMinutes() > 0) {
+        std::chrono::duration<G4double> dt =
+            std::chrono::steady_clock::now() - fLastCheckpointTime;
+        due = dt.count() >= 60.0 * runConfig.GetCheckpointMinutes();
+    }
+    if (due) WriteCheckpoint(done);
+}
+
+void NESSARunAction::WriteCheckpoint(G4int eventsDone)
+{
+    if (auto* sd = FindScoringSD()) sd->FlushHistograms();
+    NESSARunSummary state;
+    state.nEvents = eventsDone;
+    state.runTime = RunTime();
+    if (auto* sd = FindScoringSD()) {
+        FillTallyEntries(state, {&sd->GetTallies(),
+                                 &NESSANextEventEstimator::Instance().GetTallies(),
+                                 fSteppingAction ? &fSteppingAction->GetActivationTallies()
+                                                 : nullptr,
+                                 fSteppingAction ? &fSteppingAction->GetSurfaceTallies().GetTallies()
+                                                 : nullptr});
+    }
+    if (fSteppingAction) {
+        state.globalProd = fSteppingAction->GetGlobalProduction();
+        state.volumeProd = fSteppingAction->GetVolumeProduction();
+    }
+    
+    NESSACheckpoint::Precision precision;
+    const auto& monitor = NESSAPrecisionMonitor::Instance();
+    if (monitor.IsArmed()) {
+        precision = {monitor.GetDetector(), monitor.GetRelErr(), monitor.GetMaxTime()};
+    }
+    
+    const G4String& file = NESSARunConfig::Instance().GetCheckpointFile();
+    if (NESSACheckpoint::Write(file, fEventsTotal, fSeedRunID, precision, state)) {
+        G4cout << "Checkpoint: " << eventsDone << "/" << fEventsTotal
+               << " events -> " << file << G4endl;
+    }
+    fLastCheckpointEvents = eventsDone;
+    fLastCheckpointTime = std::chrono::steady_clock::now();
 }
 
 void NESSARunAction::EndOfRunAction(const G4Run* run)
@@ -84,41 +586,135 @@ void NESSARunAction::EndOfRunAction(const G4Run* run)
     fTimer.Stop();
     
     auto am = G4AnalysisManager::Instance();
+    if (auto* sd = FindScoringSD()) sd->FlushHistograms();
     am->Write();
     am->CloseFile();
     
-    G4int nEvents = run->GetNumberOfEvent();
-    if (nEvents == 0) return;
+    // Hand this thread's activation tables to the accumulable; on workers
+    // Merge() adds them into the master instance (once per run, under the
+    // accumulable manager's lock), on the master/serial run it is a no-op.
+    if (fSteppingAction) {
+        fActivation.Add(fSteppingAction->GetGlobalProduction(),
+                        fSteppingAction->GetVolumeProduction());
+    }
+    if (auto* sd = FindScoringSD()) fTallies.Merge(sd->GetTallies());
+    fNextEvent.Merge(NESSANextEventEstimator::Instance().GetTallies());
+    if (fSteppingAction) {
+        fActivationTallies.Merge(fSteppingAction->GetActivationTallies());
+        fSurfaceTallies.Merge(fSteppingAction->GetSurfaceTallies().GetTallies());
+    }
+    G4AccumulableManager::Instance()->Merge();
+    if (fSteppingAction) NESSA_PROFILE_PRINT();
+    
+    // The run summary is printed once, by the master (or the serial run)
+    if (!IsMaster()) return;
+    
+    G4int nEvents = run->GetNumberOfEvent() + fRestoredEvents;
+    if (nEvents == 0) {
+        NESSAPrecisionMonitor::Instance().Disarm();
+        return;
+    }
     G4double elapsed = fTimer.GetRealElapsed();
     
     G4cout << "\n" << G4String(72, '=') << G4endl;
     G4cout << "  NESSA Run Summary" << G4endl;
     G4cout << G4String(72, '=') << G4endl;
-    G4cout << "  Events processed:  " << nEvents << G4endl;
+    G4cout << "  Events processed:  " << nEvents;
+    if (fRestoredEvents > 0)
+        G4cout << " (" << fRestoredEvents << " from checkpoint)";
+    G4cout << G4endl;
     G4cout << "  Wall-clock time:   " << std::fixed << std::setprecision(1)
-           << elapsed << " s (" << nEvents / elapsed << " evt/s)" << G4endl;
-    G4cout << "  Output file:       nessa_output (" << am->GetType() << ")" << G4endl;
+           << elapsed << " s (" << run->GetNumberOfEvent() / elapsed
+           << " evt/s)" << G4endl;
+    G4cout << "  Output file:       " << am->GetFileName()
+           << " (" << am->GetType() << ")" << G4endl;
     
-    if (fSteppingAction) {
-        PrintActivationReport(nEvents);
+    // Everything not in the histograms goes to <output>_summary.dat,
+    // which nessa_merge combines across independent processes
+    NESSARunSummary summary;
+    summary.nEvents = nEvents;
+    summary.sourceRate = NESSARunConfig::Instance().GetSourceRate();
+    summary.doseQuantity = NESSADoseConversion::Instance().GetQuantity();
+    summary.runTime = fRestoredTime + elapsed;
+    FillTallyEntries(summary, {&fTallies, &fNextEvent, &fActivationTallies,
+                               &fSurfaceTallies});
+    summary.globalProd = fActivation.GetGlobalProduction();
+    summary.volumeProd = fActivation.GetVolumeProduction();
+    G4String summaryFile = NESSARunSummary::FileNameFor(am->GetFileName());
+    if (summary.Write(summaryFile)) {
+        G4cout << "  Run summary:       " << summaryFile << G4endl;
     }
     
+    // Mesh and cell tallies are not checkpointed: only this session's
+    // events (RestoreCheckpoint warns)
+    fMeshTallies->Write(am->GetFileName(), run->GetNumberOfEvent());
+    fCellTallies->Write(am->GetFileName(), run->GetNumberOfEvent());
+    fCellImportance->Print(run->GetNumberOfEvent());
+    fWeightWindow->Print(run->GetNumberOfEvent());
+    UpdateWindowGenerator(run->GetNumberOfEvent(), elapsed, am->GetFileName());
+    summary.PrintTallies();
+    NESSAPrecisionMonitor::Instance().Report(summary);
+    PrintActivationReport(summary.globalProd, summary.volumeProd, nEvents,
+                          summary.sourceRate);
+    
     G4cout << G4String(72, '=') << G4endl;
 }
 
-void NESSARunAction::PrintActivationReport(G4int nEvents)
+void NESSARunAction::UpdateWindowGenerator(G4int nEvents, G4double seconds,
+                                           const G4String& outputFile)
 {
-    const auto& globalProd = fSteppingAction->GetGlobalProduction();
-    const auto& volumeProd = fSteppingAction->GetVolumeProduction();
+    if (fWindowGenerator->IsEmpty()) return;
+    auto& config = NESSAWeightWindowConfig::Instance();
+    
+    G4String file = config.GetGeneratorFile();
+    if (file.empty()) {
+        file = outputFile;
+        auto dot = file.rfind('.');
+        auto slash = file.rfind('/');
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+            file = file.substr(0, dot);
+        file += "_ww.bin";
+    }
+    auto& passes = config.GetPasses();
+    passes.push_back(fWindowGenerator->Update(config.GetEstimates(), config.GetUpperRatio(),
+                                              config.GetMinHits(), nEvents, seconds, file));
+    const auto& pass = passes.back();
+    const auto mesh = config.GetGeneratorMesh();
     
+    G4cout << "  Weight-window generator, pass " << passes.size() << ":" << G4endl;
+    G4cout << "    target flux " << std::scientific << std::setprecision(3) << pass.mean
+           << " /cm2 per source particle, R " << std::fixed << std::setprecision(4)
+           << pass.relError;
+    if (pass.relError > 0. && seconds > 0.)
+        G4cout << ", FOM " << std::setprecision(1) << 1. / (pass.relError * pass.relError * seconds);
+    G4cout << G4endl;
+    G4cout << "    scoring tracks " << std::scientific << std::setprecision(3)
+           << pass.population << " per source particle";
+    if (passes.size() > 1 && passes[passes.size() - 2].population > 0.) {
+        const G4double previous = passes[passes.size() - 2].population;
+        G4cout << " (" << std::showpos << std::fixed << std::setprecision(1)
+               << 100. * (pass.population - previous) / previous << "%"
+               << std::noshowpos << " from the last pass)";
+    }
+    G4cout << G4endl;
+    G4cout << "    windows set: " << pass.nSet[0] << " n, " << pass.nSet[1] << " gamma of "
+           << mesh->NVoxels() << " voxels x groups " << mesh->energies[0].size() << " n / "
+           << mesh->energies[1].size() << " gamma";
+    if (pass.nSet[0] + pass.nSet[1] > 0)
+        G4cout << ", written to " << file << " and used from the next run";
+    G4cout << G4endl;
+}
+
+void NESSARunAction::PrintActivationReport(
+    const NESSAActivationAccumulable::IsotopeMap& globalProd,
+    const NESSAActivationAccumulable::VolumeIsotopeMap& volumeProd,
+    G4double nEvents, G4double sourceRate)
+{
     if (globalProd.empty()) {
         G4cout << "\n  No activation products detected." << G4endl;
         return;
     }
     
-    // Typical Adelphi DT-110 source strength
-    G4double sourceRate = 1.0e8;  // n/s
-    
     // ================================================================
     // Build sorted list by saturation activity (radioactive only)
     // A_sat = production_rate = (count/nEvents) * sourceRate [Bq]
@@ -138,11 +734,11 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
     for (const auto& [id, rec] : globalProd) {
         G4double perN = rec.count / nEvents;
         G4double prodRate = perN * sourceRate;
-        
+    
         // Saturation activity: at equilibrium, production = decay
         // A_sat = production_rate [Bq] (only for radioactive isotopes)
         G4double satA = (rec.halfLife_s > 0) ? prodRate : 0;
-        
+    
         ranked.push_back({id, rec.count, rec.halfLife_s, satA, perN});
         totalProd += rec.count;
     }
@@ -184,7 +780,7 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
         if (r.satActivity_Bq <= 0) continue;  // skip stable
         rank++;
         if (rank > 10) break;
-        
+    
         // Format half-life nicely
         G4String tStr;
         if (r.halfLife_s < 60)
@@ -197,7 +793,7 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
             tStr = std::to_string((int)(r.halfLife_s/86400)) + " d";
         else
             tStr = std::to_string((int)(r.halfLife_s/(365.25*86400))) + " y";
-        
+    
         // Format activity with SI prefix
         G4String aStr;
         if (r.satActivity_Bq >= 1e9)
@@ -208,7 +804,7 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
             aStr = std::to_string((int)(r.satActivity_Bq/1e3)) + " kBq";
         else
             aStr = std::to_string((int)r.satActivity_Bq) + " Bq";
-        
+    
         G4cout << std::left
                << "  " << std::setw(4) << rank
                << std::setw(12) << NESSASteppingAction::IsotopeName(r.id)
@@ -245,7 +841,7 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
     for (const auto& r : ranked) {
         rank++;
         if (rank > 10) break;
-        
+    
         G4String tStr;
         if (r.halfLife_s <= 0) tStr = "stable";
         else if (r.halfLife_s < 60) tStr = std::to_string((int)r.halfLife_s) + " s";
@@ -253,7 +849,7 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
         else if (r.halfLife_s < 86400) tStr = std::to_string((int)(r.halfLife_s/3600)) + " h";
         else if (r.halfLife_s < 365.25*86400) tStr = std::to_string((int)(r.halfLife_s/86400)) + " d";
         else tStr = std::to_string((int)(r.halfLife_s/(365.25*86400))) + " y";
-        
+    
         G4cout << std::left
                << "  " << std::setw(4) << rank
                << std::setw(12) << NESSASteppingAction::IsotopeName(r.id)
@@ -276,7 +872,7 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
         G4double ar41Total = it->second.count;
         G4double perN = ar41Total / nEvents;
         G4double prodRate = perN * sourceRate;
-        
+    
         G4cout << "\n  --- Ar-41 Detail (air activation) ---" << G4endl;
         G4cout << "  Total Ar-41:           " << ar41Total << G4endl;
         G4cout << "  Per source neutron:    " << std::scientific
@@ -284,7 +880,7 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
         G4cout << "  Production rate:       " << prodRate << " /s" << G4endl;
         G4cout << "  Saturation activity:   " << prodRate << " Bq ("
                << prodRate / 1e6 << " MBq)" << G4endl;
-        
+    
         // Per-volume breakdown for Ar-41
         G4cout << "  Production by volume:" << G4endl;
         for (const auto& [vol, isomap] : volumeProd) {
@@ -319,7 +915,7 @@ void NESSARunAction::PrintActivationReport(G4int nEvents)
         G4double totalInVol = 0;
         IsotopeID topID{0,0,0};
         G4double topCount = 0;
-        
+    
         for (const auto& [id, rec] : isomap) {
             totalInVol += rec.count;
             if (rec.count > topCount && rec.halfLife_s > 0) {
@@ -0,0 +1,208 @@
+#include "NESSARunMessenger.hh"
+#include "NESSARunConfig.hh"
+#include "NESSACheckpoint.hh"
+#include "NESSADoseConversion.hh"
+#include "NESSAPrecisionMonitor.hh"
+#include "NESSAScoringConfig.hh"
+
+#include "G4RunManager.hh"
+#include "G4Threading.hh"
+
+#include <sstream>
+#include <limits>
+
+NESSARunMessenger::NESSARunMessenger()
+{
+    // /nessa/ itself is created by NESSADetectorMessenger
+    fRunDir = new G4UIdirectory("/nessa/run/", false);
+    fRunDir->SetGuidance("Run control: checkpointing, resume and seeding");
+    
+    fCheckpointEveryCmd = new G4UIcmdWithAnInteger("/nessa/run/checkpointEvery", this);
+    fCheckpointEveryCmd->SetGuidance("Write a checkpoint every N events (0 = off)");
+    fCheckpointEveryCmd->SetParameterName("N", false);
+    fCheckpointEveryCmd->SetRange("N>=0");
+    
+    fCheckpointMinutesCmd = new G4UIcmdWithADouble("/nessa/run/checkpointMinutes", this);
+    fCheckpointMinutesCmd->SetGuidance("Write a checkpoint every T minutes (0 = off)");
+    fCheckpointMinutesCmd->SetParameterName("T", false);
+    fCheckpointMinutesCmd->SetRange("T>=0");
+    
+    fCheckpointFileCmd = new G4UIcmdWithAString("/nessa/run/checkpointFile", this);
+    fCheckpointFileCmd->SetGuidance("Checkpoint file (engine state goes to <file>.rndm)");
+    fCheckpointFileCmd->SetParameterName("file", false);
+    
+    fResumeCmd = new G4UIcmdWithAString("/nessa/run/resume", this);
+    fResumeCmd->SetGuidance("Restore a checkpoint and run the remaining events.");
+    fResumeCmd->SetGuidance("Detector configuration must match the original run.");
+    fResumeCmd->SetParameterName("file", true);
+    fResumeCmd->SetDefaultValue("");
+    
+    fUntilPrecisionCmd = new G4UIcmdWithAString("/nessa/run/untilPrecision", this);
+    fUntilPrecisionCmd->SetGuidance("Run until the detector's tallies reach a relative error:");
+    fUntilPrecisionCmd->SetGuidance("  untilPrecision <detector|all> <relErr> [maxTime s]");
+    fUntilPrecisionCmd->SetGuidance("Watches the neutron and photon track-length (and");
+    fUntilPrecisionCmd->SetGuidance("next-event) tallies; stops when all have scored and");
+    fUntilPrecisionCmd->SetGuidance("reached relErr, or when maxTime is spent (0 = no limit).");
+    fUntilPrecisionCmd->SetParameterName("args", false);
+    
+    fEventSeedCmd = new G4UIcmdWithAnInteger("/nessa/run/eventSeed", this);
+    fEventSeedCmd->SetGuidance("Seed every event from (seed, run ID, event ID).");
+    fEventSeedCmd->SetGuidance("Results then do not depend on thread count, event");
+    fEventSeedCmd->SetGuidance("order or process split. 0 = global engine stream.");
+    fEventSeedCmd->SetParameterName("seed", false);
+    fEventSeedCmd->SetRange("seed>=0");
+    
+    fEventOffsetCmd = new G4UIcmdWithAnInteger("/nessa/run/eventOffset", this);
+    fEventOffsetCmd->SetGuidance("Offset added to event IDs for per-event seeding");
+    fEventOffsetCmd->SetGuidance("(farm process start, or one event to re-run).");
+    fEventOffsetCmd->SetParameterName("N", false);
+    fEventOffsetCmd->SetRange("N>=0");
+    
+    
+    fOutputDir = new G4UIdirectory("/nessa/output/", false);
+    fOutputDir->SetGuidance("Output detail");
+    
+    fScoringNtupleCmd = new G4UIcmdWithAString("/nessa/output/scoringNtuple", this);
+    fScoringNtupleCmd->SetGuidance("Rows of the scoring ntuple:");
+    fScoringNtupleCmd->SetGuidance("  off                 none");
+    fScoringNtupleCmd->SetGuidance("  sampled [fraction]  random steps, rowWeight = 1/fraction"
+                                   " (default 0.01)");
+    fScoringNtupleCmd->SetGuidance("  perTrack            one per track and detector visit");
+    fScoringNtupleCmd->SetGuidance("  full                one per step (default)");
+    fScoringNtupleCmd->SetParameterName("mode", false);
+    
+    
+    fDoseDir = new G4UIdirectory("/nessa/dose/", false);
+    fDoseDir->SetGuidance("Fluence-to-dose conversion of the detector tallies");
+    
+    fDoseQuantityCmd = new G4UIcmdWithAString("/nessa/dose/quantity", this);
+    fDoseQuantityCmd->SetGuidance("Conversion coefficients applied at scoring time, by");
+    fDoseQuantityCmd->SetGuidance("name in data/dose_coefficients.dat (default H10 =");
+    fDoseQuantityCmd->SetGuidance("ICRP 74 ambient dose equivalent H*(10)).");
+    fDoseQuantityCmd->SetGuidance("E_AP, E_ISO = ICRP 116 effective dose, AP or isotropic.");
+    fDoseQuantityCmd->SetParameterName("name", false);
+    
+    fSourceRateCmd = new G4UIcmdWithADouble("/nessa/dose/sourceRate", this);
+    fSourceRateCmd->SetGuidance("Source strength [n/s] for dose rates (uSv/h) and");
+    fSourceRateCmd->SetGuidance("saturation activities (default 1e8)");
+    fSourceRateCmd->SetParameterName("S", false);
+    fSourceRateCmd->SetRange("S>0");
+}
+
+NESSARunMessenger::~NESSARunMessenger()
+{
+    delete fCheckpointEveryCmd; delete fCheckpointMinutesCmd;
+    delete fCheckpointFileCmd; delete fResumeCmd; delete fUntilPrecisionCmd;
+    delete fEventSeedCmd; delete fEventOffsetCmd;
+    delete fScoringNtupleCmd; delete fOutputDir;
+    delete fDoseQuantityCmd; delete fSourceRateCmd; delete fDoseDir;
+    delete fRunDir;
+}
+
+void NESSARunMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
+{
+    auto& config = NESSARunConfig::Instance();
+    
+    if (cmd == fCheckpointEveryCmd) {
+        config.SetCheckpointEvery(fCheckpointEveryCmd->GetNewIntValue(val));
+    }
+    else if (cmd == fCheckpointMinutesCmd) {
+        config.SetCheckpointMinutes(fCheckpointMinutesCmd->GetNewDoubleValue(val));
+    }
+    else if (cmd == fCheckpointFileCmd) {
+        config.SetCheckpointFile(val);
+    }
+    else if (cmd == fEventSeedCmd) {
+        config.SetEventSeed(fEventSeedCmd->GetNewIntValue(val));
+    }
+    else if (cmd == fEventOffsetCmd) {
+        config.SetEventOffset(fEventOffsetCmd->GetNewIntValue(val));
+    }
+    else if (cmd == fScoringNtupleCmd) {
+        std::istringstream iss(val);
+        G4String mode;
+        G4double fraction = config.GetScoringSampleFraction();
+        iss >> mode >> fraction;
+        if (mode == "off")           config.SetScoringNtupleMode(NESSARunConfig::kNtupleOff);
+        else if (mode == "perTrack") config.SetScoringNtupleMode(NESSARunConfig::kNtuplePerTrack);
+        else if (mode == "full")     config.SetScoringNtupleMode(NESSARunConfig::kNtupleFull);
+        else if (mode == "sampled" && fraction > 0 && fraction <= 1) {
+            config.SetScoringNtupleMode(NESSARunConfig::kNtupleSampled);
+            config.SetScoringSampleFraction(fraction);
+        } else {
+            G4Exception("NESSARunMessenger::SetNewValue", "Output001",
+                JustWarning, ("Invalid scoring ntuple mode: " + val).c_str());
+        }
+    }
+    else if (cmd == fDoseQuantityCmd) {
+        auto& dose = NESSADoseConversion::Instance();
+        if (!dose.Select(val)) {
+            G4String known;
+            for (const auto& q : dose.GetQuantities()) known += " " + q;
+            G4Exception("NESSARunMessenger::SetNewValue", "Dose002", JustWarning,
+                ("Unknown dose quantity " + val + " (defined:" + known + ")").c_str());
+        }
+    }
+    else if (cmd == fSourceRateCmd) {
+        config.SetSourceRate(fSourceRateCmd->GetNewDoubleValue(val));
+    }
+    else if (cmd == fResumeCmd) {
+        if (G4Threading::IsMultithreadedApplication()) {
+            G4Exception("NESSARunMessenger::SetNewValue", "Checkpoint001",
+                JustWarning, "Resume is only supported in serial mode");
+            return;
+        }
+        G4String file = val.empty() ? config.GetCheckpointFile() : val;
+        G4int total = 0, runID = 0;
+        NESSACheckpoint::Precision precision;
+        NESSARunSummary state;
+        if (!NESSACheckpoint::Read(file, total, runID, precision, state)) {
+            G4Exception("NESSARunMessenger::SetNewValue", "Checkpoint002",
+                JustWarning, ("Cannot read checkpoint " + file).c_str());
+            return;
+        }
+        
+        // An untilPrecision run has no event count of its own: it only
+        // ends through its target, which must therefore come back too
+        const G4bool openEnded = (total == std::numeric_limits<G4int>::max());
+        if (openEnded && precision.relErr <= 0.) {
+            G4Exception("NESSARunMessenger::SetNewValue", "Checkpoint008", JustWarning,
+                ("Checkpoint " + file + " is of an open-ended run without a stored"
+                 " precision target; not resumed").c_str());
+            return;
+        }
+        G4int remaining = total - (G4int)state.nEvents;
+        G4cout << "Resuming from " << file << ": " << (G4int)state.nEvents;
+        if (openEnded) G4cout << " events done, until R <= " << precision.relErr
+                              << " on " << precision.detector << G4endl;
+        else G4cout << "/" << total << " events done" << G4endl;
+        if (remaining <= 0) return;
+        
+        if (precision.relErr > 0.) {
+            NESSAPrecisionMonitor::Instance().Arm(precision.detector, precision.relErr,
+                                                  precision.maxTime);
+        }
+        config.SetResumeFile(file);
+        G4RunManager::GetRunManager()->BeamOn(remaining);
+    }
+    else if (cmd == fUntilPrecisionCmd) {
+        std::istringstream iss(val);
+        G4String detector;
+        G4double relErr = 0., maxTime = 0.;
+        iss >> detector >> relErr >> maxTime;
+        
+        G4bool known = (detector == "all");
+        for (const auto& p : NESSAScoringConfig::Instance().GetPoints())
+            known = known || (p.active && p.name == detector);
+        if (!known || !(relErr > 0. && relErr < 1.) || maxTime < 0.) {
+            G4Exception("NESSARunMessenger::SetNewValue", "Precision001", JustWarning,
+                ("Usage: untilPrecision <active detector|all> <0<relErr<1> [maxTime s], got: "
+                 + val).c_str());
+            return;
+        }
+        
+        // The monitor ends the run; the event count is only an upper bound
+        NESSAPrecisionMonitor::Instance().Arm(detector, relErr, maxTime);
+        G4RunManager::GetRunManager()->BeamOn(std::numeric_limits<G4int>::max());
+    }
+}
@@ -0,0 +1,282 @@
+#include "NESSARunSummary.hh"
+#include "NESSATallyStats.hh"
+
+#include "G4ios.hh"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+
+G4bool NESSARunSummary::Write(const G4String& filename) const
+{
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        G4cerr << "ERROR: Cannot write run summary: " << filename << G4endl;
+        return false;
+    }
+    out << "# NESSA run summary\n";
+    Write(out);
+    return true;
+}
+
+void NESSARunSummary::Write(std::ostream& out) const
+{
+    auto oldPrec = out.precision();
+    out << std::setprecision(std::numeric_limits<G4double>::max_digits10);
+    out << "# TALLY name particle(0/1=n/g track, 2/3 F5, 4/5 dose, 6/7 F5 dose,"
+           " 8 activation,"
+           " 10/11 surface current, 12/13 surface fluence) sum_x sum_x2 sum_x3 sum_x4\n";
+    out << "# CHART name particle width, per segment: histories sum_x sum_x2"
+           " sum_x3 sum_x4\n";
+    out << "# TAIL name particle largest history scores\n";
+    out << "# ISOTOPE volume(* = global) Z A isomer count halfLife_s\n";
+    out << "EVENTS " << nEvents << "\n";
+    if (runTime > 0) out << "RUN_TIME " << runTime << "\n";
+    if (sourceRate > 0) out << "SOURCE_RATE " << sourceRate << "\n";
+    if (!doseQuantity.empty()) out << "DOSE_QUANTITY " << doseQuantity << "\n";
+    for (const auto& t : tallies) {
+        const auto& m = t.moments;
+        out << "TALLY " << t.name << " " << t.particle << " "
+            << m.s1 << " " << m.s2 << " " << m.s3 << " " << m.s4 << "\n";
+        if (!t.chart.m.empty()) {
+            out << "CHART " << t.name << " " << t.particle << " " << t.chart.width;
+            for (size_t k = 0; k < t.chart.m.size(); k++) {
+                const auto& c = t.chart.m[k];
+                out << " " << (k < t.chart.n.size() ? t.chart.n[k] : 0.)
+                    << " " << c.s1 << " " << c.s2 << " " << c.s3 << " " << c.s4;
+            }
+            out << "\n";
+        }
+        if (!t.tail.empty()) {
+            out << "TAIL " << t.name << " " << t.particle;
+            for (G4double x : t.tail) out << " " << x;
+            out << "\n";
+        }
+    }
+    for (const auto& [id, rec] : globalProd) {
+        out << "ISOTOPE * " << id.Z << " " << id.A << " " << id.isomer << " "
+            << rec.count << " " << rec.halfLife_s << "\n";
+    }
+    for (const auto& [vol, isomap] : volumeProd) {
+        for (const auto& [id, rec] : isomap) {
+            out << "ISOTOPE " << vol << " " << id.Z << " " << id.A << " "
+                << id.isomer << " " << rec.count << " " << rec.halfLife_s << "\n";
+        }
+    }
+    out.precision(oldPrec);
+}
+
+G4bool NESSARunSummary::Read(const G4String& filename)
+{
+    std::ifstream in(filename);
+    if (!in.is_open()) {
+        G4cerr << "ERROR: Cannot open run summary: " << filename << G4endl;
+        return false;
+    }
+    Read(in);
+    return true;
+}
+
+void NESSARunSummary::Read(std::istream& in)
+{
+    *this = NESSARunSummary();
+    
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        
+        std::istringstream iss(line);
+        std::string keyword;
+        iss >> keyword;
+        
+        if (keyword == "EVENTS") {
+            iss >> nEvents;
+        }
+        else if (keyword == "SOURCE_RATE") {
+            iss >> sourceRate;
+        }
+        else if (keyword == "DOSE_QUANTITY") {
+            std::string q;
+            iss >> q;
+            doseQuantity = q;
+        }
+        else if (keyword == "RUN_TIME") {
+            iss >> runTime;
+        }
+        else if (keyword == "TALLY") {
+            TallyEntry t;
+            std::string name;
+            iss >> name >> t.particle >> t.moments.s1 >> t.moments.s2;
+            iss >> t.moments.s3 >> t.moments.s4;  // absent in older summaries
+            t.name = name;
+            tallies.push_back(t);
+        }
+        else if (keyword == "CHART" || keyword == "TAIL") {
+            // Belongs to the TALLY line of the same name and particle
+            std::string name;
+            G4int particle = -1;
+            iss >> name >> particle;
+            TallyEntry* t = nullptr;
+            for (auto it = tallies.rbegin(); it != tallies.rend() && !t; ++it) {
+                if (it->name == name && it->particle == particle) t = &*it;
+            }
+            if (!t) continue;
+            if (keyword == "CHART") {
+                G4double n;
+                TallyMoments c;
+                iss >> t->chart.width;
+                while (iss >> n >> c.s1 >> c.s2 >> c.s3 >> c.s4) {
+                    t->chart.n.push_back(n);
+                    t->chart.m.push_back(c);
+                }
+            } else {
+                G4double x;
+                while (iss >> x) t->tail.push_back(x);
+            }
+        }
+        else if (keyword == "ISOTOPE") {
+            std::string vol;
+            IsotopeID id;
+            IsotopeRecord rec;
+            iss >> vol >> id.Z >> id.A >> id.isomer >> rec.count >> rec.halfLife_s;
+            auto& r = (vol == "*") ? globalProd[id] : volumeProd[vol][id];
+            r.count += rec.count;
+            if (rec.halfLife_s > 0) r.halfLife_s = rec.halfLife_s;
+        }
+    }
+}
+
+void NESSARunSummary::Add(const NESSARunSummary& other)
+{
+    nEvents += other.nEvents;
+    runTime += other.runTime;
+    if (sourceRate <= 0) sourceRate = other.sourceRate;
+    if (doseQuantity.empty()) doseQuantity = other.doseQuantity;
+    
+    for (const auto& t : other.tallies) {
+        G4bool found = false;
+        for (auto& mine : tallies) {
+            if (mine.name == t.name && mine.particle == t.particle) {
+                mine.moments += t.moments;
+                // Each run numbers its histories from 0, so independent
+                // runs are overlaid as if their histories interleaved
+                mine.chart.Add(t.chart);
+                NESSATallyStats::MergeTails(mine.tail, t.tail);
+                found = true;
+                break;
+            }
+        }
+        if (!found) tallies.push_back(t);
+    }
+    
+    auto addRecords = [](IsotopeMap& into, const IsotopeMap& from) {
+        for (const auto& [id, rec] : from) {
+            auto& r = into[id];
+            r.count += rec.count;
+            if (rec.halfLife_s > 0) r.halfLife_s = rec.halfLife_s;
+        }
+    };
+    addRecords(globalProd, other.globalProd);
+    for (const auto& [vol, isomap] : other.volumeProd) {
+        addRecords(volumeProd[vol], isomap);
+    }
+}
+
+TallyStatistics NESSARunSummary::Statistics(const TallyEntry& t) const
+{
+    G4bool pointDetector = (t.particle / 2 == 1 || t.particle / 2 == 3);
+    return NESSATallyStats::Evaluate(t.moments, nEvents, runTime, t.chart,
+                                     t.tail, pointDetector);
+}
+
+void NESSARunSummary::PrintTallies() const
+{
+    if (tallies.empty()) return;
+    
+    // Dose tallies are pSv per source particle; at the source rate
+    // [n/s] that is rate * 3600 s/h * 1e-6 uSv/pSv
+    const G4bool doseRate = sourceRate > 0;
+    const G4double toRate = sourceRate * 3600. * 1e-6;
+    static const char* estimators[7] = {"track", "F5", "dose", "F5 dose", "activ.",
+                                        "F1 cur.", "F2 flux"};
+    const char* units[7] = {"cm", "1/cm2", doseRate ? "uSv/h" : "pSv",
+                            doseRate ? "uSv/h" : "pSv", "atoms", "part.", "1/cm2"};
+    
+    G4cout << "\n  --- Tallies (per source particle) ---" << G4endl;
+    if (!doseQuantity.empty()) {
+        G4cout << "  Dose: " << doseQuantity;
+        if (doseRate) {
+            G4cout << " rate at " << std::scientific << std::setprecision(2)
+                   << sourceRate << " n/s";
+        }
+        G4cout << G4endl;
+    }
+    G4cout << "  FOM = 1/(R^2 T), T = " << std::fixed << std::setprecision(1)
+           << runTime << " s wall clock" << G4endl;
+    G4cout << "  " << G4String(84, '-') << G4endl;
+    G4cout << std::left
+           << "  " << std::setw(18) << "Tally"
+           << std::setw(5) << "part"
+           << std::setw(9) << "estim."
+           << std::right
+           << std::setw(12) << "mean"
+           << std::setw(7) << "unit"
+           << std::setw(8) << "R"
+           << std::setw(8) << "VOV"
+           << std::setw(10) << "FOM"
+           << std::setw(7) << "checks"
+           << G4endl;
+    G4cout << "  " << G4String(84, '-') << G4endl;
+    
+    std::vector<std::pair<const TallyEntry*, TallyStatistics>> failed;
+    for (const auto& t : tallies) {
+        TallyStatistics st = Statistics(t);
+        G4int kind = t.particle / 2;
+        G4double mean = st.mean;
+        if ((kind == 2 || kind == 3) && doseRate) mean *= toRate;
+        G4cout << std::left
+               << "  " << std::setw(18) << t.name
+               << std::setw(5) << (kind == 4 ? "-" : t.particle % 2 == 0 ? "n" : "g")
+               << std::setw(9) << estimators[kind]
+               << std::right << std::scientific << std::setprecision(3)
+               << std::setw(12) << mean
+               << std::setw(7) << units[kind]
+               << std::fixed << std::setprecision(4)
+               << std::setw(8) << st.relErr
+               << std::setw(8) << st.vov
+               << std::scientific << std::setprecision(2)
+               << std::setw(10) << st.fom
+               << std::setw(4) << st.NPassed() << "/10"
+               << G4endl;
+        if (st.NPassed() < 10 && st.relErr > 0) failed.emplace_back(&t, st);
+    }
+    
+    // Which checks failed (numbering as in NESSATallyStats.hh)
+    if (failed.empty()) return;
+    G4cout << "  " << G4String(84, '-') << G4endl;
+    G4cout << "  Failed checks: 1 mean trend, 2 R, 3/4 R decrease, 5 VOV,"
+              " 6/7 VOV decrease," << G4endl;
+    G4cout << "  8/9 FOM constant, 10 PDF slope" << G4endl;
+    for (const auto& [t, st] : failed) {
+        G4int kind = t->particle / 2;
+        G4cout << "    " << std::left << std::setw(18) << t->name
+               << std::setw(4) << (kind == 4 ? "-" : t->particle % 2 == 0 ? "n" : "g")
+               << std::setw(9) << estimators[kind] << ":";
+        for (G4int c = 0; c < 10; c++) {
+            if (!st.checks[c]) G4cout << " " << c + 1;
+        }
+        G4cout << "  (slope " << std::fixed << std::setprecision(1)
+               << st.slope << ")" << std::right << G4endl;
+    }
+}
+
+G4String NESSARunSummary::FileNameFor(const G4String& outputFile)
+{
+    G4String base = outputFile;
+    auto dot = base.rfind('.');
+    auto slash = base.rfind('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        base = base.substr(0, dot);
+    return base + "_summary.dat";
+}
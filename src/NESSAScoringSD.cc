@@ -1,72 +1,209 @@
 #include "NESSAScoringSD.hh"
 #include "NESSAScoringConfig.hh"
+#include "NESSARunConfig.hh"
+#include "NESSAProfiler.hh"
+#include "NESSADoseConversion.hh"
+#include "NESSARunAction.hh"
 
 #include "G4Step.hh"
+#include "G4Event.hh"
+#include "G4EventManager.hh"
+#include "G4RunManager.hh"
 #include "G4Track.hh"
+#include "G4Neutron.hh"
+#include "G4Gamma.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VSolid.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4AnalysisManager.hh"
-#include <map>
 
 NESSAScoringSD::NESSAScoringSD(const G4String& name)
-    : G4VSensitiveDetector(name) {}
+    : G4VSensitiveDetector(name),
+      fNeutron(G4Neutron::Definition()),
+      fGamma(G4Gamma::Definition())
+{
+    Reconfigure();
+    fHits.reserve(1024);
+}
 
 NESSAScoringSD::~NESSAScoringSD() {}
 
-void NESSAScoringSD::Initialize(G4HCofThisEvent*) {}
+void NESSAScoringSD::Reconfigure()
+{
+    // Volumes are attached by ConstructSDandField; the index counts active
+    // detectors only, in configuration order.
+    fIndexByLV.clear();
+    fNActive = NESSAScoringConfig::Instance().GetNActive();
+    fInvVolume.assign(fNActive, 0.);
+    fTimed.assign(fNActive, 0);
+    fTallies.SetNBins(4 * fNActive);
+}
+
+void NESSAScoringSD::AttachVolume(const G4LogicalVolume* lv, G4int index)
+{
+    // Instance IDs are dense (position in the logical volume store), so
+    // the per-step lookup is a vector read
+    G4int id = lv->GetInstanceID();
+    if (id >= (G4int)fIndexByLV.size()) fIndexByLV.resize(id + 1, -1);
+    fIndexByLV[id] = index;
+    
+    // Computed once per geometry (estimated by sampling for booleans)
+    G4double volume = lv->GetSolid()->GetCubicVolume() / cm3;
+    if (index < (G4int)fInvVolume.size() && volume > 0.)
+        fInvVolume[index] = 1. / volume;
+}
+
+void NESSAScoringSD::SetHistogramIDs(const std::vector<G4int>& ids)
+{
+    // Filled by bin through the tools objects, skipping the per-call ID
+    // lookup and activation check of FillH1 (all are active) and the
+    // h1d bin search
+    auto am = G4AnalysisManager::Instance();
+    fSpectra.assign(ids.size(), NESSABinnedH1());
+    fBinning.assign(ids.size() / 2, NESSAEnergyBinning());
+    for (size_t i = 0; i < ids.size(); i++) {
+        auto* h = am->GetH1(ids[i]);
+        fSpectra[i].Attach(h);
+        if (i % 2 == 0 && h) fBinning[i / 2].SetUp(*h);  // n_spec, g_spec
+    }
+}
+
+void NESSAScoringSD::SetTimeHistogramIDs(const std::vector<G4int>& h1Ids,
+                                         const std::vector<G4int>& h2Ids)
+{
+    auto am = G4AnalysisManager::Instance();
+    fTimeSpectra.assign(h1Ids.size(), NESSABinnedH1());
+    fTimeEnergy.assign(h2Ids.size(), NESSABinnedH2());
+    fTimeBinning.assign(h1Ids.size(), NESSAEnergyBinning());
+    fTimeEnergyBinning.assign(h2Ids.size(), NESSAEnergyBinning());
+    fTimed.assign(h1Ids.size() / 2, 0);
+    for (size_t i = 0; i < h1Ids.size(); i++) {
+        if (h1Ids[i] < 0 || h2Ids[i] < 0) continue;
+        auto* h1 = am->GetH1(h1Ids[i]);
+        auto* h2 = am->GetH2(h2Ids[i]);
+        if (!h1 || !h2) continue;
+        fTimeSpectra[i].Attach(h1);
+        fTimeEnergy[i].Attach(h2);
+        fTimeBinning[i].SetUp(*h1);
+        fTimeEnergyBinning[i].SetUp(h2->axis_x().edges());
+        fTimed[i / 2] = 1;
+    }
+}
+
+void NESSAScoringSD::FlushHistograms()
+{
+    for (auto& spectrum : fSpectra) spectrum.Flush();
+    for (auto& spectrum : fTimeSpectra) spectrum.Flush();
+    for (auto& array : fTimeEnergy) array.Flush();
+}
+
+void NESSAScoringSD::Initialize(G4HCofThisEvent*)
+{
+    fHits.clear();  // keeps capacity
+    
+    // Row sampling uses its own stream, keyed on the event, so it does not
+    // consume engine numbers: the histories are the same in every mode.
+    // The key is the run action's (seed, run, history), so farm processes
+    // and resumed sessions do not repeat each other's keep/drop sequence.
+    const auto* event = G4EventManager::GetEventManager()->GetConstCurrentEvent();
+    const G4int eventID = event ? event->GetEventID() : 0;
+    const auto* runAction = dynamic_cast<const NESSARunAction*>(
+        G4RunManager::GetRunManager()->GetUserRunAction());
+    const uint64_t key = runAction ? runAction->EventKey(eventID) : (uint64_t)eventID;
+    fSampler.Seed(0x5DEECE66DULL ^ key);
+}
 
 G4bool NESSAScoringSD::ProcessHits(G4Step* step, G4TouchableHistory*)
 {
+    NESSA_PROFILE(kProcessHits);
+    
     auto* track = step->GetTrack();
-    G4String particleName = track->GetDefinition()->GetParticleName();
+    const auto* def = track->GetDefinition();
+    if (def != fNeutron && def != fGamma) return true;
     
-    if (particleName != "neutron" && particleName != "gamma") return true;
+    const auto* pre = step->GetPreStepPoint();
+    G4int lvID = pre->GetPhysicalVolume()->GetLogicalVolume()->GetInstanceID();
+    if (lvID >= (G4int)fIndexByLV.size()) return true;
+    G4int idx = fIndexByLV[lvID];
+    if (idx < 0) return true;
     
-    G4double kE     = step->GetPreStepPoint()->GetKineticEnergy();
-    G4double sLen   = step->GetStepLength();
-    G4double edep   = step->GetTotalEnergyDeposit();
-    G4double weight = track->GetWeight();
+    fHits.push_back({idx, (def == fNeutron) ? 0 : 1, track->GetTrackID(),
+                     pre->GetKineticEnergy() / MeV,
+                     pre->GetGlobalTime() / s,
+                     step->GetTotalEnergyDeposit() / MeV,
+                     step->GetStepLength() / cm,
+                     track->GetWeight()});
+    return true;
+}
+
+void NESSAScoringSD::EndOfEvent(G4HCofThisEvent*)
+{
+    NESSA_PROFILE(kScoringFlush);
+    FlushHits();
+    fTallies.EndOfHistory();
+}
+
+void NESSAScoringSD::FlushHits()
+{
+    // Histograms: spectrum weighted by track length, dose spectrum by
+    // fluence times the conversion coefficient at the step energy
+    const auto& dose = NESSADoseConversion::Instance();
+    const G4int doseOffset = 2 * fNActive;
+    for (const auto& h : fHits) {
+        auto* spectra = &fSpectra[4*h.det + 2*h.particle];
+        G4int bin = fBinning[2*h.det + h.particle].Bin(h.energy);
+        G4double length = h.weight * h.length;
+        G4double doseScore = length * fInvVolume[h.det]
+                           * dose.Coefficient(h.particle, h.energy);
+        spectra[0].Fill(bin, h.energy, length);
+        spectra[1].Fill(bin, h.energy, doseScore);
+        fTallies.Score(2*h.det + h.particle, length);
+        fTallies.Score(doseOffset + 2*h.det + h.particle, doseScore);
     
-    // Map logical volume name → detector index (built once)
-    static std::map<G4String, G4int> nameMap;
-    if (nameMap.empty()) {
-        const auto& pts = NESSAScoringConfig::Instance().GetPoints();
-        for (G4int i = 0; i < (G4int)pts.size(); i++) {
-            if (!pts[i].active) continue;
-            if (pts[i].mcnpCell > 0)
-                nameMap["logic_c" + std::to_string(pts[i].mcnpCell)] = i;
-            else
-                nameMap["score_" + pts[i].name] = i;
-        }
+        if (!fTimed[h.det]) continue;
+        const G4int k = 2*h.det + h.particle;
+        G4int it = fTimeBinning[k].Bin(h.time);
+        fTimeSpectra[k].Fill(it, h.time, length);
+        fTimeEnergy[k].Fill(fTimeEnergyBinning[k].Bin(h.energy), it, h.energy, h.time,
+                            length);
     }
     
-    G4String lvName = step->GetPreStepPoint()->GetTouchableHandle()
-                          ->GetVolume()->GetLogicalVolume()->GetName();
-    auto it = nameMap.find(lvName);
-    if (it == nameMap.end()) return true;
-    G4int idx = it->second;
+    // Ntuple: one row per step, a sample of them, or one per track and
+    // detector visit (a track is transported to completion before the
+    // next one, so its hits in a detector are consecutive). A visit row
+    // has the entry energy and the summed edep and weighted track length.
+    const auto& config = NESSARunConfig::Instance();
+    const auto mode = config.GetScoringNtupleMode();
+    if (mode == NESSARunConfig::kNtupleOff) return;
     
+    const G4double fraction = config.GetScoringSampleFraction();
+    const G4double rowWeight = (mode == NESSARunConfig::kNtupleSampled)
+                             ? 1. / fraction : 1.;
     auto am = G4AnalysisManager::Instance();
-    
-    if (particleName == "neutron") {
-        // H1 IDs: idx*2 = spectrum, idx*2+1 = dose
-        am->FillH1(idx * 2,     kE / MeV, weight * sLen / cm);
-        am->FillH1(idx * 2 + 1, kE / MeV, edep / MeV * weight);
-    } else {
-        // Photon histograms offset by 2*N
-        G4int N = NESSAScoringConfig::Instance().GetNActive();
-        am->FillH1(2*N + idx*2,     kE / MeV, weight * sLen / cm);
-        am->FillH1(2*N + idx*2 + 1, kE / MeV, edep / MeV * weight);
+    const size_t n = fHits.size();
+    for (size_t i = 0; i < n; ) {
+        const auto& first = fHits[i];
+        G4double edep = first.edep;
+        G4double length = first.weight * first.length;
+        size_t j = i + 1;
+        if (mode == NESSARunConfig::kNtuplePerTrack) {
+            for (; j < n && fHits[j].trackID == first.trackID
+                         && fHits[j].det == first.det; j++) {
+                edep   += fHits[j].edep;
+                length += fHits[j].weight * fHits[j].length;
+            }
+        } else if (mode == NESSARunConfig::kNtupleSampled
+                   && fSampler.Uniform() >= fraction) {
+            i = j;
+            continue;
+        }
+        am->FillNtupleIColumn(0, 0, first.det);
+        am->FillNtupleDColumn(0, 1, first.energy);
+        am->FillNtupleDColumn(0, 2, edep);
+        am->FillNtupleDColumn(0, 3, length);
+        am->FillNtupleIColumn(0, 4, first.particle);
+        am->FillNtupleDColumn(0, 5, rowWeight);
+        am->AddNtupleRow(0);
+        i = j;
     }
-    
-    // Ntuple
-    am->FillNtupleIColumn(0, 0, idx);
-    am->FillNtupleDColumn(0, 1, kE / MeV);
-    am->FillNtupleDColumn(0, 2, edep / MeV);
-    am->FillNtupleDColumn(0, 3, weight * sLen / cm);
-    am->FillNtupleIColumn(0, 4, (particleName == "neutron") ? 0 : 1);
-    am->AddNtupleRow(0);
-    
-    return true;
 }
-
-void NESSAScoringSD::EndOfEvent(G4HCofThisEvent*) {}
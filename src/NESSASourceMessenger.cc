@@ -0,0 +1,123 @@
+#include "NESSASourceMessenger.hh"
+#include "NESSASourceConfig.hh"
+
+#include "globals.hh"
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+NESSASourceMessenger::NESSASourceMessenger()
+{
+    // /nessa/ itself is created by NESSADetectorMessenger
+    fSourceDir = new G4UIdirectory("/nessa/source/", false);
+    fSourceDir->SetGuidance("Direction biasing of the Adelphi source (primaries carry");
+    fSourceDir->SetGuidance("the weight correction; the energy-direction correlation is kept)");
+    
+    fBiasFileCmd = new G4UIcmdWithAString("/nessa/source/biasFile", this);
+    fBiasFileCmd->SetGuidance("Biased direction-bin probabilities from a file: lines");
+    fBiasFileCmd->SetGuidance("'bin p', or the adjoint solver's <base>_bias.dat");
+    fBiasFileCmd->SetGuidance("(p_biased, 5th column); '#' starts a comment.");
+    fBiasFileCmd->SetGuidance("Bins the source emits into need p > 0.");
+    fBiasFileCmd->SetParameterName("file", false);
+    
+    fBiasCosineCmd = new G4UIcmdWithAString("/nessa/source/biasCosine", this);
+    fBiasCosineCmd->SetGuidance("Multiply the probability of the bins with cos(theta) to");
+    fBiasCosineCmd->SetGuidance("the source axis in [muLo, muHi] by factor > 0:");
+    fBiasCosineCmd->SetGuidance("muLo muHi factor (repeat for several ranges)");
+    fBiasCosineCmd->SetParameterName("params", false);
+    
+    fConeCmd = new G4UIcmdWithAString("/nessa/source/cone", this);
+    fConeCmd->SetGuidance("Azimuthal cone toward a target point: x y z halfWidth [fraction]");
+    fConeCmd->SetGuidance("Point in global coordinates [cm]; a fraction (default 0.5) of");
+    fConeCmd->SetGuidance("the emissions get an azimuth within halfWidth [deg] of the");
+    fConeCmd->SetGuidance("target's. halfWidth 0 switches the cone off.");
+    fConeCmd->SetParameterName("params", false);
+    
+    fAnalogCmd = new G4UIcmdWithoutParameter("/nessa/source/analog", this);
+    fAnalogCmd->SetGuidance("Drop all source biasing");
+}
+
+NESSASourceMessenger::~NESSASourceMessenger()
+{
+    delete fBiasFileCmd; delete fBiasCosineCmd; delete fConeCmd; delete fAnalogCmd;
+    delete fSourceDir;
+}
+
+void NESSASourceMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
+{
+    auto& config = NESSASourceConfig::Instance();
+    
+    if (cmd == fBiasFileCmd) {
+        std::ifstream in(val);
+        if (!in.is_open()) {
+            G4Exception("NESSASourceMessenger::SetNewValue", "Source004", JustWarning,
+                ("Cannot open source bias file " + val).c_str());
+            return;
+        }
+        std::vector<G4double> probs;
+        std::string line;
+        G4int lineNo = 0;
+        while (std::getline(in, line)) {
+            lineNo++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream iss(line);
+            std::vector<G4double> cols;
+            G4double x;
+            while (iss >> x) cols.push_back(x);
+            if (cols.empty()) continue;
+            // bin p, or bin mu_lo mu_hi p_analog p_biased [...]
+            const G4int bin = (G4int)cols[0];
+            const G4double p = (cols.size() >= 5) ? cols[4] : (cols.size() >= 2) ? cols[1] : -1.;
+            if (!iss.eof() || cols.size() == 3 || cols.size() == 4 || bin < 0 || p < 0.) {
+                G4Exception("NESSASourceMessenger::SetNewValue", "Source004", JustWarning,
+                    ("Bad line " + std::to_string(lineNo) + " in " + val
+                     + ": expected 'bin p' or 'bin mu_lo mu_hi p_analog p_biased'").c_str());
+                return;
+            }
+            if (bin >= (G4int)probs.size()) probs.resize(bin + 1, 0.);
+            probs[bin] = p;
+        }
+        if (probs.empty()) {
+            G4Exception("NESSASourceMessenger::SetNewValue", "Source004", JustWarning,
+                ("No bins in source bias file " + val).c_str());
+            return;
+        }
+        config.SetBinProbabilities(probs);
+        G4cout << "Read biased probabilities of " << probs.size() << " direction bins from "
+               << val << G4endl;
+    }
+    else if (cmd == fBiasCosineCmd) {
+        std::istringstream iss(val);
+        G4double muLo = 0., muHi = 0., factor = 0.;
+        iss >> muLo >> muHi >> factor;
+        if (iss.fail() || muLo > muHi || !(factor > 0.)) {
+            G4Exception("NESSASourceMessenger::SetNewValue", "Source005", JustWarning,
+                ("Usage: biasCosine muLo muHi factor (muLo <= muHi, factor > 0), got: "
+                 + val).c_str());
+            return;
+        }
+        config.AddCosineFactor(muLo, muHi, factor);
+    }
+    else if (cmd == fConeCmd) {
+        std::istringstream iss(val);
+        G4double x = 0., y = 0., z = 0., halfWidth = -1., fraction = 0.5;
+        iss >> x >> y >> z >> halfWidth;
+        const G4bool ok = !iss.fail();
+        G4String rest;
+        if (ok && (iss >> rest)) {
+            std::istringstream f(rest);
+            if (!(f >> fraction)) fraction = -1.;
+        }
+        if (!ok || !(halfWidth >= 0. && halfWidth < 180.)
+            || !(fraction > 0. && fraction < 1.)) {
+            G4Exception("NESSASourceMessenger::SetNewValue", "Source005", JustWarning,
+                ("Usage: cone x y z halfWidth [fraction] (0 <= halfWidth < 180 deg, "
+                 "0 < fraction < 1), got: " + val).c_str());
+            return;
+        }
+        config.SetCone(G4ThreeVector(x, y, z), halfWidth, fraction);
+    }
+    else if (cmd == fAnalogCmd) {
+        config.Clear();
+    }
+}
@@ -1,37 +1,81 @@
 #include "NESSASteppingAction.hh"
+#include "NESSAProfiler.hh"
+#include "NESSANextEventEstimator.hh"
 
 #include "G4Step.hh"
 #include "G4Track.hh"
 #include "G4VProcess.hh"
 #include "G4ParticleDefinition.hh"
 #include "G4Ions.hh"
+#include "G4Neutron.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4AnalysisManager.hh"
+#include "G4SteppingManager.hh"
 
 #include <algorithm>
+#include <cstdio>
+
+NESSASteppingAction::NESSASteppingAction()
+    : fNeutron(G4Neutron::Definition()),
+      fNextEvent(&NESSANextEventEstimator::Instance()),
+      fActivationTallies("activationTallies"),
+      fMeshTallies("meshTallies"),
+      fCellTallies("cellTallies"),
+      fCellImportance("cellImportance"),
+      fWeightWindow("weightWindows"),
+      fWindowGenerator("weightWindowGenerator")
+{
+    fActivationTallies.SetNBins(kNActivationTallies);
+}
 
-NESSASteppingAction::NESSASteppingAction() {}
 NESSASteppingAction::~NESSASteppingAction() {}
 
 void NESSASteppingAction::Reset()
 {
     fGlobalProd.clear();
     fVolumeProd.clear();
+    fActivationTallies.Reset();
 }
 
 void NESSASteppingAction::UserSteppingAction(const G4Step* step)
 {
-    // Only track secondaries from neutron interactions
+    NESSA_PROFILE(kSteppingAction);
+    
+    if (fNextEvent->IsEnabled()) fNextEvent->ScoreCollision(step);
+    if (!fMeshTallies.IsEmpty()) fMeshTallies.ScoreStep(step);
+    if (!fSurfaceTallies.IsEmpty()) fSurfaceTallies.ScoreStep(step);
+    if (!fCellTallies.IsEmpty()) fCellTallies.ScoreStep(step);
+    
+    // Past the last time bin nothing more is scored: stop transporting
+    // (secondaries of this step start late and stop at their first step)
     auto* track = step->GetTrack();
-    if (track->GetDefinition()->GetParticleName() != "neutron") return;
+    if (fTimeCutoff > 0. && step->GetPostStepPoint()->GetGlobalTime() > fTimeCutoff)
+        track->SetTrackStatus(fStopAndKill);
     
+    // Only track secondaries from neutron interactions
+    if (track->GetDefinition() == fNeutron) RecordActivation(step);
+    
+    // Last: clones go to the end of the secondaries, and this step's own
+    // secondaries are read from the end of that list above. The generator
+    // sees the weight the track entered with, before it is split. Cell
+    // importances only kill (importance 0) particles that have windows.
+    if (!fWindowGenerator.IsEmpty()) fWindowGenerator.RecordStep(step);
+    if (!fCellImportance.IsEmpty())
+        fCellImportance.ApplyAtBoundary(step, fpSteppingManager->GetfSecondary());
+    if (!fWeightWindow.IsEmpty())
+        fWeightWindow.Apply(step, fpSteppingManager->GetfSecondary());
+}
+
+void NESSASteppingAction::RecordActivation(const G4Step* step)
+{
+    const auto* track = step->GetTrack();
     const auto* secondaries = step->GetSecondaryInCurrentStep();
     if (!secondaries || secondaries->empty()) return;
     
     // Check the process that created the secondaries
     const G4VProcess* proc = step->GetPostStepPoint()->GetProcessDefinedStep();
     if (!proc) return;
-    G4String procName = proc->GetProcessName();
+    const G4String& procName = proc->GetProcessName();
     
     // We want hadronic processes: nCapture, neutronInelastic, hadElastic won't
     // produce new isotopes but (n,2n) is part of neutronInelastic
@@ -39,7 +83,7 @@ void NESSASteppingAction::UserSteppingAction(const G4Step* step)
     // Simply: check all secondaries for ions/nuclei with Z>0
     
     G4double weight = track->GetWeight();
-    G4String volName = step->GetPreStepPoint()->GetTouchableHandle()
+    const G4String& volName = step->GetPreStepPoint()->GetTouchableHandle()
                            ->GetVolume()->GetLogicalVolume()->GetName();
     G4double neutronE = step->GetPreStepPoint()->GetKineticEnergy();
     auto pos = step->GetPreStepPoint()->GetPosition();
@@ -86,6 +130,9 @@ void NESSASteppingAction::UserSteppingAction(const G4Step* step)
         fVolumeProd[volName][id].count += weight;
         if (halfLife_s > 0) fVolumeProd[volName][id].halfLife_s = halfLife_s;
         
+        if (halfLife_s > 0) fActivationTallies.Score(kRadioactiveTally, weight);
+        if (Z == 18 && A == 41 && isomer == 0) fActivationTallies.Score(kAr41Tally, weight);
+        
         // Fill activation ntuple (ntuple ID 1)
         auto am = G4AnalysisManager::Instance();
         am->FillNtupleIColumn(1, 0, Z);
@@ -118,9 +165,9 @@ const char* NESSASteppingAction::ElementSymbol(G4int Z)
         "Pa","U","Np","Pu","Am","Cm","Bk","Cf","Es","Fm"
     };
     if (Z >= 0 && Z < 100) return sym[Z];
-    static std::string fallback;
-fallback = "X" + std::to_string(Z);
-return fallback.c_str();
+    static G4ThreadLocal char fallback[16];
+    std::snprintf(fallback, sizeof(fallback), "X%d", Z);
+    return fallback;
 }
 
 std::string NESSASteppingAction::IsotopeName(const IsotopeID& id)
@@ -0,0 +1,71 @@
+#include "NESSASurfaceMessenger.hh"
+#include "NESSASurfaceConfig.hh"
+
+#include "globals.hh"
+#include <cmath>
+#include <sstream>
+
+NESSASurfaceMessenger::NESSASurfaceMessenger()
+{
+    // /nessa/ itself is created by NESSADetectorMessenger
+    fSurfaceDir = new G4UIdirectory("/nessa/surface/", false);
+    fSurfaceDir->SetGuidance("Surface current (F1) and fluence (F2) tallies");
+    
+    fAddCmd = new G4UIcmdWithAString("/nessa/surface/add", this);
+    fAddCmd->SetGuidance("Add (or replace) a surface: name x y z nx ny nz [radius]");
+    fAddCmd->SetGuidance("Plane through (x, y, z) [cm] with normal (nx, ny, nz); with");
+    fAddCmd->SetGuidance("a radius [cm], the disc around the point. The current counts");
+    fAddCmd->SetGuidance("crossings along the normal; fluence needs a disc.");
+    fAddCmd->SetParameterName("params", false);
+    
+    fRemoveCmd = new G4UIcmdWithAString("/nessa/surface/remove", this);
+    fRemoveCmd->SetGuidance("Remove a surface by name");
+    fRemoveCmd->SetParameterName("name", false);
+    
+    fListCmd = new G4UIcmdWithoutParameter("/nessa/surface/list", this);
+    fListCmd->SetGuidance("List the tally surfaces");
+}
+
+NESSASurfaceMessenger::~NESSASurfaceMessenger()
+{
+    delete fAddCmd; delete fRemoveCmd; delete fListCmd; delete fSurfaceDir;
+}
+
+void NESSASurfaceMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
+{
+    auto& config = NESSASurfaceConfig::Instance();
+    
+    if (cmd == fAddCmd) {
+        std::istringstream iss(val);
+        SurfaceSpec spec;
+        iss >> spec.name >> spec.point[0] >> spec.point[1] >> spec.point[2]
+            >> spec.normal[0] >> spec.normal[1] >> spec.normal[2];
+        G4bool ok = !iss.fail();
+        iss >> spec.radius;
+        G4double norm = std::sqrt(spec.normal[0] * spec.normal[0] +
+                                  spec.normal[1] * spec.normal[1] +
+                                  spec.normal[2] * spec.normal[2]);
+        if (!ok || norm <= 0. || spec.radius < 0.) {
+            G4Exception("NESSASurfaceMessenger::SetNewValue", "Surface001", JustWarning,
+                ("Usage: add name x y z nx ny nz [radius], got: " + val).c_str());
+            return;
+        }
+        for (G4int k = 0; k < 3; k++) spec.normal[k] /= norm;
+        config.AddSurface(spec);
+        G4cout << "Added surface: " << spec.name
+               << (spec.radius > 0. ? " (disc)" : " (plane)") << G4endl;
+    }
+    else if (cmd == fRemoveCmd) {
+        config.RemoveSurface(val);
+    }
+    else if (cmd == fListCmd) {
+        G4cout << "\n=== NESSA Tally Surfaces ===" << G4endl;
+        for (const auto& s : config.GetSurfaces()) {
+            G4cout << "  " << s.name << "  at (" << s.point[0] << ", " << s.point[1]
+                   << ", " << s.point[2] << ") cm  normal (" << s.normal[0] << ", "
+                   << s.normal[1] << ", " << s.normal[2] << ")";
+            if (s.radius > 0.) G4cout << "  r=" << s.radius << " cm";
+            G4cout << G4endl;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#include "NESSASurfaceTally.hh"
+#include "NESSAProfiler.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4Neutron.hh"
+#include "G4Gamma.hh"
+#include "G4AnalysisManager.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+
+#include <cmath>
+
+NESSASurfaceTally::NESSASurfaceTally()
+    : fNeutron(G4Neutron::Definition()),
+      fGamma(G4Gamma::Definition()),
+      fTallies("surfaceTallies") {}
+
+void NESSASurfaceTally::SetUp(const std::vector<SurfaceSpec>& specs)
+{
+    fSurfaces.clear();
+    for (const auto& spec : specs) {
+        Surface s;
+        s.point = G4ThreeVector(spec.point[0], spec.point[1], spec.point[2]) * cm;
+        s.normal = G4ThreeVector(spec.normal[0], spec.normal[1], spec.normal[2]).unit();
+        s.radius2 = spec.radius * cm * spec.radius * cm;
+        s.invArea = (spec.radius > 0.) ? 1. / (pi * spec.radius * spec.radius) : 0.;
+        fSurfaces.push_back(s);
+    }
+    fFluenceOffset = 2 * (G4int)fSurfaces.size();
+    fTallies.SetNBins(4 * (G4int)fSurfaces.size());
+    fH2.clear();
+}
+
+void NESSASurfaceTally::SetHistogramIDs(const std::vector<G4int>& ids)
+{
+    // Filled through the tools objects, as the scoring SD does
+    auto am = G4AnalysisManager::Instance();
+    fH2.clear();
+    for (G4int id : ids) fH2.push_back(am->GetH2(id));
+}
+
+void NESSASurfaceTally::ScoreStep(const G4Step* step)
+{
+    NESSA_PROFILE(kSurfaceTally);
+    
+    const auto* def = step->GetTrack()->GetDefinition();
+    const G4int particle = (def == fNeutron) ? 0 : (def == fGamma) ? 1 : -1;
+    if (particle < 0) return;
+    
+    const auto* pre = step->GetPreStepPoint();
+    const G4ThreeVector& a = pre->GetPosition();
+    const G4ThreeVector& b = step->GetPostStepPoint()->GetPosition();
+    
+    const G4int n = (G4int)fSurfaces.size();
+    for (G4int i = 0; i < n; i++) {
+        const auto& s = fSurfaces[i];
+        G4double da = (a - s.point).dot(s.normal);
+        G4double db = (b - s.point).dot(s.normal);
+        if ((da < 0.) == (db < 0.)) continue;
+        if (s.radius2 > 0.) {
+            G4ThreeVector x = a + (da / (da - db)) * (b - a);
+            if ((x - s.point).mag2() > s.radius2) continue;
+        }
+    
+        // Neutral: the direction is the same along the whole step
+        const G4double mu = pre->GetMomentumDirection().dot(s.normal);
+        const G4double w = pre->GetWeight();
+        if (mu > 0.) fTallies.Score(2*i + particle, w);
+        if (s.invArea > 0.) {
+            G4double absMu = std::abs(mu);
+            if (absMu < 0.1) absMu = 0.05;
+            fTallies.Score(fFluenceOffset + 2*i + particle, w * s.invArea / absMu);
+        }
+        if (!fH2.empty()) fH2[2*i + particle]->fill(pre->GetKineticEnergy() / MeV, mu, w);
+    }
+}
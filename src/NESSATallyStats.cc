@@ -0,0 +1,312 @@
+#include "NESSATallyStats.hh"
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+namespace {
+    
+// Number of the current history, for the fluctuation chart
+G4ThreadLocal G4long gChartHistory = 0;
+    
+// Tails are min-heaps: the smallest kept score is at the front
+const std::greater<G4double> kMinHeap;
+    
+/// R and VOV from the moments of n histories (MCNP definitions)
+void RelErrAndVOV(const TallyMoments& m, G4double n, G4double& relErr,
+                  G4double& vov)
+{
+    relErr = vov = 0.;
+    if (n <= 0 || m.s1 <= 0) return;
+    G4double r2 = m.s2 / (m.s1 * m.s1) - 1.0 / n;
+    relErr = (r2 > 0) ? std::sqrt(r2) : 0.;
+    
+    // sum (x - mean)^4 / (sum (x - mean)^2)^2 - 1/N
+    G4double xm = m.s1 / n;
+    G4double d2 = m.s2 - n * xm * xm;
+    G4double d4 = m.s4 - 4. * xm * m.s3 + 6. * xm * xm * m.s2
+                - 3. * n * xm * xm * xm * xm;
+    vov = (d2 > 0) ? std::max(0., d4 / (d2 * d2) - 1.0 / n) : 0.;
+}
+    
+/// Every value below or equal to the previous one
+G4bool NonIncreasing(const std::vector<G4double>& v)
+{
+    for (size_t i = 1; i < v.size(); i++) {
+        if (v[i] > v[i-1]) return false;
+    }
+    return v.size() >= 2;
+}
+    
+/// Strictly increasing or strictly decreasing throughout
+G4bool MonotonicTrend(const std::vector<G4double>& v)
+{
+    G4bool up = true, down = true;
+    for (size_t i = 1; i < v.size(); i++) {
+        up   = up   && v[i] > v[i-1];
+        down = down && v[i] < v[i-1];
+    }
+    return v.size() >= 2 && (up || down);
+}
+    
+/// Least-squares exponent p of y ~ n^p; false if any y <= 0
+G4bool PowerLawExponent(const std::vector<G4double>& n,
+                        const std::vector<G4double>& y, G4double& p)
+{
+    if (n.size() < 2) return false;
+    G4double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    const G4double k = n.size();
+    for (size_t i = 0; i < n.size(); i++) {
+        if (y[i] <= 0) return false;
+        G4double lx = std::log(n[i]), ly = std::log(y[i]);
+        sx += lx; sy += ly; sxx += lx * lx; sxy += lx * ly;
+    }
+    G4double det = k * sxx - sx * sx;
+    if (det <= 0) return false;
+    p = (k * sxy - sx * sy) / det;
+    return true;
+}
+    
+}  // namespace
+
+void TallyChart::CoarsenTo(G4double w)
+{
+    const G4int nPoints = (G4int)m.size();
+    n.resize(nPoints, 0.);
+    while (width < w) {
+        for (G4int k = 0; k < nPoints; k++) {
+            G4bool inRange = 2*k + 1 < nPoints;
+            TallyMoments sum;
+            if (inRange) { sum = m[2*k]; sum += m[2*k + 1]; }
+            m[k] = sum;
+            n[k] = inRange ? n[2*k] + n[2*k + 1] : 0.;
+        }
+        width *= 2.;
+    }
+}
+
+void TallyChart::Add(const TallyChart& other)
+{
+    if (m.size() < other.m.size()) {
+        m.resize(other.m.size());
+        n.resize(other.m.size(), 0.);
+    }
+    CoarsenTo(other.width);
+    for (size_t k = 0; k < other.m.size(); k++) {
+        size_t seg = (size_t)(k * other.width / width);
+        m[seg] += other.m[k];
+        if (k < other.n.size()) n[seg] += other.n[k];
+    }
+}
+
+void NESSATallyStats::SetChartHistory(G4long index)
+{
+    gChartHistory = std::max(index, (G4long)0);
+}
+
+void NESSATallyStats::SetNBins(G4int n)
+{
+    fMoments.assign(n, TallyMoments());
+    fChart.assign((size_t)n * kChartPoints, TallyMoments());
+    fChartN.assign(kChartPoints, 0.);
+    fChartWidth = 1.;
+    fTails.assign(n, std::vector<G4double>());
+    fHistory.assign(n, 0.);
+    fIsTouched.assign(n, 0);
+    fTouched.clear();
+}
+
+void NESSATallyStats::EndOfHistory()
+{
+    const G4double index = (G4double)gChartHistory;
+    while (index >= fChartWidth * kChartPoints) CoarsenChart();
+    const G4int seg = (G4int)(index / fChartWidth);
+    fChartN[seg] += 1.;
+    for (G4int bin : fTouched) {
+        G4double x = fHistory[bin];
+        fMoments[bin].Add(x);
+        fChart[(size_t)bin * kChartPoints + seg].Add(x);
+    
+        auto& tail = fTails[bin];
+        if ((G4int)tail.size() < kTailSize) {
+            tail.push_back(x);
+            std::push_heap(tail.begin(), tail.end(), kMinHeap);
+        } else if (x > tail.front()) {
+            std::pop_heap(tail.begin(), tail.end(), kMinHeap);
+            tail.back() = x;
+            std::push_heap(tail.begin(), tail.end(), kMinHeap);
+        }
+    
+        fHistory[bin]   = 0.;
+        fIsTouched[bin] = 0;
+    }
+    fTouched.clear();
+}
+
+void NESSATallyStats::CoarsenChart()
+{
+    // Segment k takes over segments 2k and 2k+1
+    for (G4int bin = 0; bin < GetNBins(); bin++) {
+        TallyMoments* c = &fChart[(size_t)bin * kChartPoints];
+        for (G4int k = 0; k < kChartPoints; k++) {
+            TallyMoments sum;
+            if (2*k + 1 < kChartPoints) { sum = c[2*k]; sum += c[2*k + 1]; }
+            c[k] = sum;
+        }
+    }
+    for (G4int k = 0; k < kChartPoints; k++) {
+        fChartN[k] = (2*k + 1 < kChartPoints) ? fChartN[2*k] + fChartN[2*k + 1] : 0.;
+    }
+    fChartWidth *= 2.;
+}
+
+void NESSATallyStats::Merge(const G4VAccumulable& other)
+{
+    const auto& o = static_cast<const NESSATallyStats&>(other);
+    if (o.GetNBins() > GetNBins()) {
+        fMoments.resize(o.GetNBins());
+        fChart.resize((size_t)o.GetNBins() * kChartPoints);
+        fTails.resize(o.GetNBins());
+        fHistory.resize(o.GetNBins(), 0.);
+        fIsTouched.resize(o.GetNBins(), 0);
+    }
+    fChartN.resize(kChartPoints, 0.);
+    
+    // Both charts number histories the same way: bring this one to the
+    // coarser width, then add the other's segments where they fall
+    while (fChartWidth < o.fChartWidth) CoarsenChart();
+    std::vector<G4int> seg(kChartPoints);
+    for (G4int k = 0; k < kChartPoints; k++) {
+        seg[k] = (G4int)(k * o.fChartWidth / fChartWidth);
+        if (k < (G4int)o.fChartN.size()) fChartN[seg[k]] += o.fChartN[k];
+    }
+    for (G4int i = 0; i < o.GetNBins(); i++) {
+        fMoments[i] += o.fMoments[i];
+        for (G4int k = 0; k < kChartPoints; k++) {
+            fChart[(size_t)i * kChartPoints + seg[k]] +=
+                o.fChart[(size_t)i * kChartPoints + k];
+        }
+        MergeTails(fTails[i], o.fTails[i]);
+        std::make_heap(fTails[i].begin(), fTails[i].end(), kMinHeap);
+    }
+}
+
+void NESSATallyStats::Reset()
+{
+    std::fill(fMoments.begin(), fMoments.end(), TallyMoments());
+    std::fill(fChart.begin(), fChart.end(), TallyMoments());
+    std::fill(fChartN.begin(), fChartN.end(), 0.);
+    fChartWidth = 1.;
+    for (auto& tail : fTails) tail.clear();
+    std::fill(fHistory.begin(), fHistory.end(), 0.);
+    std::fill(fIsTouched.begin(), fIsTouched.end(), 0);
+    fTouched.clear();
+}
+
+TallyChart NESSATallyStats::GetChart(G4int bin) const
+{
+    auto first = fChart.begin() + (size_t)bin * kChartPoints;
+    TallyChart chart;
+    chart.width = fChartWidth;
+    chart.n = fChartN;
+    chart.m.assign(first, first + kChartPoints);
+    return chart;
+}
+
+std::vector<G4double> NESSATallyStats::GetTail(G4int bin) const
+{
+    std::vector<G4double> tail = fTails[bin];
+    std::sort(tail.begin(), tail.end(), std::greater<G4double>());
+    return tail;
+}
+
+void NESSATallyStats::SetState(G4int bin, const TallyMoments& moments,
+    const TallyChart& chart, const std::vector<G4double>& tail)
+{
+    fMoments[bin] = moments;
+    fChartWidth = chart.width;
+    for (G4int k = 0; k < kChartPoints; k++) {
+        fChart[(size_t)bin * kChartPoints + k] =
+            (k < (G4int)chart.m.size()) ? chart.m[k] : TallyMoments();
+        fChartN[k] = (k < (G4int)chart.n.size()) ? chart.n[k] : 0.;
+    }
+    fTails[bin].clear();
+    MergeTails(fTails[bin], tail);
+    std::make_heap(fTails[bin].begin(), fTails[bin].end(), kMinHeap);
+}
+
+void NESSATallyStats::MergeTails(std::vector<G4double>& tail,
+                                 const std::vector<G4double>& more)
+{
+    tail.insert(tail.end(), more.begin(), more.end());
+    std::sort(tail.begin(), tail.end(), std::greater<G4double>());
+    if ((G4int)tail.size() > kTailSize) tail.resize(kTailSize);
+}
+
+void NESSATallyStats::MeanAndError(G4double s1, G4double s2, G4double nHistories,
+                                   G4double& mean, G4double& relErr)
+{
+    mean = relErr = 0.;
+    if (nHistories <= 0) return;
+    mean = s1 / nHistories;
+    if (s1 <= 0) return;
+    G4double r2 = s2 / (s1 * s1) - 1.0 / nHistories;
+    relErr = (r2 > 0) ? std::sqrt(r2) : 0.;
+}
+
+TallyStatistics NESSATallyStats::Evaluate(const TallyMoments& moments,
+    G4double nHistories, G4double time, const TallyChart& chart,
+    const std::vector<G4double>& tail, G4bool pointDetector)
+{
+    TallyStatistics st;
+    if (nHistories <= 0) return st;
+    st.mean = moments.s1 / nHistories;
+    RelErrAndVOV(moments, nHistories, st.relErr, st.vov);
+    if (st.relErr <= 0) return st;  // no scores (or one): nothing to check
+    if (time > 0) st.fom = 1. / (st.relErr * st.relErr * time);
+    
+    // Tail slope: Hill estimate of the Pareto index alpha of the largest
+    // history scores; the score PDF then falls as x^-(alpha+1)
+    if (tail.size() >= 25) {
+        const size_t k = tail.size() - 1;
+        G4double sumLog = 0.;
+        for (size_t i = 0; i < k; i++) sumLog += std::log(tail[i] / tail[k]);
+        st.slope = (sumLog > 0) ? std::min(10., 1. + k / sumLog) : 10.;
+    }
+    
+    // Fluctuation chart over the last half of the filled segments, time
+    // taken as proportional to the histories done
+    G4int nPoints = (G4int)std::min(chart.m.size(), chart.n.size());
+    while (nPoints > 0 && chart.n[nPoints - 1] <= 0) nPoints--;
+    std::vector<G4double> n, mean, relErr, vov, fom;
+    TallyMoments cum;
+    G4double cumN = 0.;
+    for (G4int k = 0; k < nPoints; k++) {
+        cum += chart.m[k];
+        cumN += chart.n[k];
+        if (k < nPoints / 2 || cumN <= 0) continue;
+        G4double r, v;
+        RelErrAndVOV(cum, cumN, r, v);
+        n.push_back(cumN);
+        mean.push_back(cum.s1 / cumN);
+        relErr.push_back(r);
+        vov.push_back(v);
+        fom.push_back((r > 0 && time > 0) ? nHistories / (r * r * time * cumN) : 0.);
+    }
+    
+    G4double pR = 0., pVOV = 0.;
+    st.checks[0] = n.size() >= 2 && !MonotonicTrend(mean);
+    st.checks[1] = st.relErr < (pointDetector ? 0.05 : 0.10);
+    st.checks[2] = NonIncreasing(relErr);
+    st.checks[3] = PowerLawExponent(n, relErr, pR) && pR <= -0.25 && pR >= -0.75;
+    st.checks[4] = st.vov < 0.10;
+    st.checks[5] = NonIncreasing(vov);
+    st.checks[6] = PowerLawExponent(n, vov, pVOV) && pVOV <= -0.5 && pVOV >= -1.5;
+    st.checks[7] = !fom.empty() && st.fom > 0;
+    for (G4double f : fom) {
+        st.checks[7] = st.checks[7] && std::abs(f / st.fom - 1.) <= 0.10;
+    }
+    st.checks[8] = fom.size() >= 2 && !MonotonicTrend(fom);
+    st.checks[9] = st.slope >= 3.;
+    return st;
+}
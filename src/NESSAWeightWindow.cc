@@ -0,0 +1,119 @@
+#include "NESSAWeightWindow.hh"
+#include "NESSAWeightWindowConfig.hh"
+#include "NESSACellImportance.hh"
+#include "NESSAProfiler.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4Neutron.hh"
+#include "G4Gamma.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+#include "G4ios.hh"
+
+#include <iomanip>
+#include <algorithm>
+
+NESSAWeightWindow::NESSAWeightWindow(const G4String& name)
+    : G4VAccumulable(name),
+      fNeutron(G4Neutron::Definition()),
+      fGamma(G4Gamma::Definition()) {}
+
+void NESSAWeightWindow::SetUp()
+{
+    const auto& config = NESSAWeightWindowConfig::Instance();
+    fMesh = config.GetMesh();
+    fScale = config.GetScale();
+    fUpperRatio = config.GetUpperRatio();
+    fSurvivalRatio = config.GetSurvivalRatio();
+    fMaxSplit = config.GetMaxSplit();
+    Reset();
+}
+
+void NESSAWeightWindow::Apply(const G4Step* step, G4TrackVector* secondaries)
+{
+    NESSA_PROFILE(kWeightWindow);
+    
+    G4Track* track = step->GetTrack();
+    if (track->GetTrackStatus() != fAlive) return;
+    const auto* def = track->GetDefinition();
+    const G4int particle = (def == fNeutron) ? 0 : (def == fGamma) ? 1 : -1;
+    if (particle < 0 || !fMesh->HasWindows(particle)) return;
+    
+    G4double* counts = fCounts[particle];
+    counts[kChecks]++;
+    const auto* post = step->GetPostStepPoint();
+    const G4long voxel = fMesh->Voxel(post->GetPosition());
+    const G4double lower = (voxel < 0) ? 0.
+        : fScale * fMesh->Lower(particle, voxel,
+                                fMesh->EnergyGroup(particle, post->GetKineticEnergy() / MeV));
+    if (lower <= 0.) {
+        counts[kNoWindow]++;
+        return;
+    }
+    
+    const G4double w = track->GetWeight();
+    const G4double survival = fSurvivalRatio * lower;
+    if (w < lower) {
+        counts[kBelow]++;
+        if (G4UniformRand() * survival < w) {
+            track->SetWeight(survival);
+        } else {
+            track->SetTrackStatus(fStopAndKill);
+            counts[kRouletted]++;
+        }
+    }
+    else if (w > fUpperRatio * lower) {
+        counts[kAbove]++;
+        G4double r = w / survival;
+        if (r > fMaxSplit) {
+            r = fMaxSplit;
+            counts[kCapped]++;
+        }
+        G4int n = (G4int)r;
+        if (G4UniformRand() < r - n) n++;
+        track->SetWeight(w / r);
+        counts[kClones] += n - 1;
+        NESSACellImportance::AddClones(track, post, w / r, n - 1, secondaries);
+    }
+    else {
+        counts[kInWindow]++;
+    }
+}
+
+void NESSAWeightWindow::Merge(const G4VAccumulable& other)
+{
+    const auto& o = static_cast<const NESSAWeightWindow&>(other);
+    for (G4int p = 0; p < 2; p++)
+        for (G4int c = 0; c < kNCounts; c++) fCounts[p][c] += o.fCounts[p][c];
+}
+
+void NESSAWeightWindow::Reset()
+{
+    for (auto& counts : fCounts)
+        for (auto& c : counts) c = 0.;
+}
+
+void NESSAWeightWindow::Print(G4double nEvents) const
+{
+    if (IsEmpty() || nEvents <= 0) return;
+    G4cout << "  Weight windows (checks per source particle, share by outcome):" << G4endl;
+    G4cout << "    " << std::left << std::setw(10) << "particle" << std::right
+           << std::setw(12) << "checks" << std::setw(10) << "no wl"
+           << std::setw(10) << "inside" << std::setw(10) << "below"
+           << std::setw(10) << "killed" << std::setw(10) << "above"
+           << std::setw(12) << "clones" << std::setw(10) << "capped" << G4endl;
+    static const char* names[2] = {"neutron", "gamma"};
+    for (G4int p = 0; p < 2; p++) {
+        const G4double* c = fCounts[p];
+        if (c[kChecks] == 0.) continue;
+        G4cout << "    " << std::left << std::setw(10) << names[p] << std::right
+               << std::scientific << std::setprecision(3)
+               << std::setw(12) << c[kChecks] / nEvents << std::fixed << std::setprecision(4);
+        for (G4int k : {kNoWindow, kInWindow, kBelow, kRouletted, kAbove})
+            G4cout << std::setw(10) << c[k] / c[kChecks];
+        G4cout << std::scientific << std::setprecision(3) << std::setw(12)
+               << c[kClones] / nEvents << std::fixed << std::setprecision(4)
+               << std::setw(10) << c[kCapped] / c[kChecks] << G4endl;
+    }
+}
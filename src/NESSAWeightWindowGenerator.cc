@@ -0,0 +1,254 @@
+#include "NESSAWeightWindowGenerator.hh"
+#include "NESSAWeightWindowConfig.hh"
+#include "NESSAScoringConfig.hh"
+#include "NESSAProfiler.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4Neutron.hh"
+#include "G4Gamma.hh"
+#include "G4LogicalVolume.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4VSolid.hh"
+#include "G4SystemOfUnits.hh"
+#include "globals.hh"
+
+#include <algorithm>
+#include <cmath>
+
+NESSAWeightWindowGenerator::NESSAWeightWindowGenerator(const G4String& name)
+    : G4VAccumulable(name),
+      fNeutron(G4Neutron::Definition()),
+      fGamma(G4Gamma::Definition()) {}
+
+G4bool NESSAWeightWindowGenerator::SetUp()
+{
+    const auto& config = NESSAWeightWindowConfig::Instance();
+    fMesh = config.GetGeneratorMesh();
+    fTargetParticle = config.GetTargetParticle();
+    
+    // Targets by logical volume, as ConstructSDandField attaches them
+    fTargetByLV.clear();
+    fNTargets = 0;
+    auto* lvStore = G4LogicalVolumeStore::GetInstance();
+    const auto& targets = config.GetTargets();
+    for (const auto& pt : NESSAScoringConfig::Instance().GetPoints()) {
+        if (!pt.active
+            || std::find(targets.begin(), targets.end(), pt.name) == targets.end()) continue;
+        G4String logName = (pt.mcnpCell > 0)
+            ? G4String("logic_c" + std::to_string(pt.mcnpCell))
+            : G4String("score_" + pt.name);
+        auto* lv = lvStore->GetVolume(logName, false);
+        if (!lv) continue;
+        G4double volume = lv->GetSolid()->GetCubicVolume() / cm3;
+        if (volume <= 0.) continue;
+        G4int id = lv->GetInstanceID();
+        if (id >= (G4int)fTargetByLV.size()) fTargetByLV.resize(id + 1, 0.);
+        fTargetByLV[id] = 1. / volume;
+        fNTargets++;
+    }
+    if (fNTargets == 0) fMesh.reset();
+    
+    const G4long nBins = fMesh ? fMesh->NVoxels() : 0;
+    for (G4int p = 0; p < 2; p++) {
+        const G4long n = fMesh ? nBins * (G4long)fMesh->energies[p].size() : 0;
+        fScore[p].assign(n, 0.);
+        fWeight[p].assign(n, 0.);
+        fHits[p].assign(n, 0.);
+    }
+    Reset();
+    return !IsEmpty();
+}
+
+G4long NESSAWeightWindowGenerator::Bin(const G4ThreeVector& x, G4int particle,
+                                       G4double e) const
+{
+    const G4long voxel = fMesh->Voxel(x);
+    if (voxel < 0) return -1;
+    return fMesh->LowerIndex(voxel, fMesh->EnergyGroup(particle, e));
+}
+
+void NESSAWeightWindowGenerator::RecordStep(const G4Step* step)
+{
+    NESSA_PROFILE(kWindowGenerator);
+    
+    const G4Track* track = step->GetTrack();
+    const G4int id = track->GetTrackID();
+    if (id >= (G4int)fTracks.size()) fTracks.resize(2 * id + 16);
+    auto& rec = fTracks[id];
+    const auto* pre = step->GetPreStepPoint();
+    const auto* def = track->GetDefinition();
+    const G4int particle = (def == fNeutron) ? 0 : (def == fGamma) ? 1 : -1;
+    
+    // Every track is registered, so that photons from electrons or
+    // decays are still credited to the neutron that started the chain
+    if (!rec.used) {
+        rec.used = true;
+        rec.parent = track->GetParentID();
+        rec.birth = pre->GetGlobalTime();
+        rec.lastBin = -1;
+        fMaxTrackID = std::max(fMaxTrackID, id);
+        if (rec.parent == 0) fSourceWeight += track->GetWeight();
+        if (particle >= 0) {
+            rec.lastBin = Bin(pre->GetPosition(), particle, pre->GetKineticEnergy() / MeV);
+            if (rec.lastBin >= 0)
+                rec.entries.push_back({rec.birth, track->GetWeight(), rec.lastBin, particle});
+        }
+    }
+    if (particle < 0) return;
+    
+    // Target flux of this step, at the time it starts
+    const G4int lvID = pre->GetPhysicalVolume()->GetLogicalVolume()->GetInstanceID();
+    if (lvID < (G4int)fTargetByLV.size() && fTargetByLV[lvID] > 0.
+        && (fTargetParticle == 2 || fTargetParticle == particle)) {
+        const G4double score = track->GetWeight() * step->GetStepLength() / cm
+                             * fTargetByLV[lvID];
+        rec.scores.push_back({pre->GetGlobalTime(), score});
+        rec.scored = true;
+        fHistoryScore += score;
+    }
+    
+    // Entry into another bin at the end of the step
+    if (track->GetTrackStatus() != fAlive) return;
+    const auto* post = step->GetPostStepPoint();
+    const G4long bin = Bin(post->GetPosition(), particle, post->GetKineticEnergy() / MeV);
+    if (bin != rec.lastBin && bin >= 0)
+        rec.entries.push_back({post->GetGlobalTime(), track->GetWeight(), bin, particle});
+    rec.lastBin = bin;
+}
+
+void NESSAWeightWindowGenerator::EndOfHistory()
+{
+    // Daughters have larger track IDs than their parents, so going down
+    // the IDs every subtree is complete before its root is credited
+    for (G4int id = fMaxTrackID; id >= 1; id--) {
+        auto& rec = fTracks[id];
+        if (!rec.used) continue;
+        if (rec.scored) fPopulation++;
+        
+        auto& scores = rec.scores;
+        std::sort(scores.begin(), scores.end());
+        G4double after = 0.;
+        auto s = scores.rbegin();
+        for (auto e = rec.entries.rbegin(); e != rec.entries.rend(); ++e) {
+            for (; s != scores.rend() && s->time >= e->time; ++s) after += s->value;
+            fScore[e->particle][e->bin] += after;
+            fWeight[e->particle][e->bin] += e->weight;
+            if (after > 0.) fHits[e->particle][e->bin]++;
+        }
+        G4double total = after;
+        for (; s != scores.rend(); ++s) total += s->value;
+        
+        if (rec.parent > 0) {
+            if (total > 0.) fTracks[rec.parent].scores.push_back({rec.birth, total});
+        } else {
+            fSourceScore += total;
+        }
+        rec.used = false;
+        rec.scored = false;
+        rec.entries.clear();
+        rec.scores.clear();
+    }
+    fMaxTrackID = 0;
+    fSum1 += fHistoryScore;
+    fSum2 += fHistoryScore * fHistoryScore;
+    fHistoryScore = 0.;
+}
+
+void NESSAWeightWindowGenerator::Merge(const G4VAccumulable& other)
+{
+    const auto& o = static_cast<const NESSAWeightWindowGenerator&>(other);
+    for (G4int p = 0; p < 2; p++) {
+        if (o.fScore[p].size() != fScore[p].size()) continue;
+        for (std::size_t i = 0; i < fScore[p].size(); i++) {
+            fScore[p][i] += o.fScore[p][i];
+            fWeight[p][i] += o.fWeight[p][i];
+            fHits[p][i] += o.fHits[p][i];
+        }
+    }
+    fSourceScore += o.fSourceScore;
+    fSourceWeight += o.fSourceWeight;
+    fPopulation += o.fPopulation;
+    fSum1 += o.fSum1;
+    fSum2 += o.fSum2;
+}
+
+void NESSAWeightWindowGenerator::Reset()
+{
+    for (G4int p = 0; p < 2; p++) {
+        std::fill(fScore[p].begin(), fScore[p].end(), 0.);
+        std::fill(fWeight[p].begin(), fWeight[p].end(), 0.);
+        std::fill(fHits[p].begin(), fHits[p].end(), 0.);
+    }
+    fSourceScore = fSourceWeight = 0.;
+    fPopulation = fSum1 = fSum2 = 0.;
+}
+
+WeightWindowPass NESSAWeightWindowGenerator::Update(
+    WeightWindowEstimates& estimates, G4double upperRatio, G4int minHits,
+    G4int nEvents, G4double seconds, const G4String& file) const
+{
+    WeightWindowPass pass{nEvents, 0., 0., 1., seconds, {0, 0}};
+    if (IsEmpty() || nEvents <= 0) return pass;
+    
+    for (G4int p = 0; p < 2; p++) {
+        if (estimates.score[p].size() != fScore[p].size()) {
+            estimates.score[p].assign(fScore[p].size(), 0.);
+            estimates.weight[p].assign(fScore[p].size(), 0.);
+            estimates.hits[p].assign(fScore[p].size(), 0.);
+        }
+        for (std::size_t i = 0; i < fScore[p].size(); i++) {
+            estimates.score[p][i] += fScore[p][i];
+            estimates.weight[p][i] += fWeight[p][i];
+            estimates.hits[p][i] += fHits[p][i];
+        }
+    }
+    estimates.sourceScore += fSourceScore;
+    estimates.sourceWeight += fSourceWeight;
+    
+    pass.population = fPopulation / nEvents;
+    pass.mean = fSum1 / nEvents;
+    if (fSum1 > 0.) pass.relError = std::sqrt(std::max(0., fSum2 / (fSum1 * fSum1) - 1. / nEvents));
+    
+    auto windows = MakeWindows(*fMesh, estimates, upperRatio, minHits);
+    if (!windows) return pass;
+    for (G4int p = 0; p < 2; p++) {
+        pass.nSet[p] = std::count_if(windows->lower[p].begin(), windows->lower[p].end(),
+                                     [](G4double w) { return w > 0.; });
+    }
+    G4String error;
+    if (!windows->Write(file, error)) {
+        G4Exception("NESSAWeightWindowGenerator::Update", "WW004", JustWarning,
+            error.c_str());
+    }
+    NESSAWeightWindowConfig::Instance().SetMesh(windows);
+    return pass;
+}
+
+std::shared_ptr<NESSAWeightWindowMesh> NESSAWeightWindowGenerator::MakeWindows(
+    const NESSAWeightWindowMesh& mesh, const WeightWindowEstimates& estimates,
+    G4double upperRatio, G4int minHits)
+{
+    if (estimates.sourceScore <= 0. || estimates.sourceWeight <= 0.) return nullptr;
+    const G4double sourceImportance = estimates.sourceScore / estimates.sourceWeight;
+    const G4double norm = 2. / (1. + upperRatio) * sourceImportance;
+    
+    auto windows = std::make_shared<NESSAWeightWindowMesh>(mesh);
+    for (G4int p = 0; p < 2; p++) {
+        const std::size_t n = estimates.score[p].size();
+        windows->lower[p].assign(n, 0.);
+        for (std::size_t i = 0; i < n; i++) {
+            const G4double score = estimates.score[p][i];
+            if (score <= 0. || estimates.hits[p][i] < minHits) continue;
+            windows->lower[p][i] = norm * estimates.weight[p][i] / score;
+        }
+        // No estimate anywhere: no windows for this particle
+        if (std::none_of(windows->lower[p].begin(), windows->lower[p].end(),
+                         [](G4double w) { return w > 0.; })) {
+            windows->energies[p].clear();
+            windows->lower[p].clear();
+        }
+    }
+    if (!windows->HasWindows(0) && !windows->HasWindows(1)) return nullptr;
+    return windows;
+}
@@ -0,0 +1,332 @@
+#include "NESSAWeightWindowMesh.hh"
+
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+G4long NESSAWeightWindowMesh::Voxel(const G4ThreeVector& x) const
+{
+    G4double u[3] = {x.x() / cm, x.y() / cm, x.z() / cm};
+    if (geometry == kCylindrical) {
+        // (r, z along the axis, theta from vec in revolutions)
+        const G4double p[3] = {u[0] - origin[0], u[1] - origin[1], u[2] - origin[2]};
+        const G4double z = p[0] * axis[0] + p[1] * axis[1] + p[2] * axis[2];
+        const G4double q[3] = {p[0] - z * axis[0], p[1] - z * axis[1], p[2] - z * axis[2]};
+        const G4double w[3] = {axis[1] * vec[2] - axis[2] * vec[1],
+                               axis[2] * vec[0] - axis[0] * vec[2],
+                               axis[0] * vec[1] - axis[1] * vec[0]};
+        G4double theta = std::atan2(q[0] * w[0] + q[1] * w[1] + q[2] * w[2],
+                                    q[0] * vec[0] + q[1] * vec[1] + q[2] * vec[2]) / twopi;
+        if (theta < 0.) theta += 1.;
+        u[0] = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+        u[1] = z;
+        u[2] = theta;
+    }
+    
+    G4long index = 0, stride = 1;
+    for (G4int k = 0; k < 3; k++) {
+        const auto& e = edges[k];
+        if (!(u[k] >= e.front() && u[k] < e.back())) {
+            // The last theta edge closes the circle
+            if (!(geometry == kCylindrical && k == 2 && u[k] >= e.back() && u[k] <= 1.))
+                return -1;
+        }
+        G4long i = std::upper_bound(e.begin(), e.end(), u[k]) - e.begin() - 1;
+        i = std::min<G4long>(std::max<G4long>(i, 0), NBins(k) - 1);
+        index += i * stride;
+        stride *= NBins(k);
+    }
+    return index;
+}
+
+G4int NESSAWeightWindowMesh::EnergyGroup(G4int particle, G4double e) const
+{
+    const auto& b = energies[particle];
+    G4int g = (G4int)(std::lower_bound(b.begin(), b.end(), e) - b.begin());
+    return std::min(g, (G4int)b.size() - 1);
+}
+
+G4ThreeVector NESSAWeightWindowMesh::VoxelCentre(G4long voxel) const
+{
+    G4double c[3];
+    for (G4int k = 0; k < 3; k++) {
+        G4long i = voxel % NBins(k);
+        voxel /= NBins(k);
+        c[k] = 0.5 * (edges[k][i] + edges[k][i + 1]);
+    }
+    if (geometry == kCartesian) return G4ThreeVector(c[0], c[1], c[2]);
+    
+    const G4ThreeVector a(axis[0], axis[1], axis[2]), v(vec[0], vec[1], vec[2]);
+    const G4double theta = twopi * c[2];
+    return G4ThreeVector(origin[0], origin[1], origin[2]) + c[1] * a
+         + c[0] * (std::cos(theta) * v + std::sin(theta) * a.cross(v));
+}
+
+G4bool NESSAWeightWindowMesh::Validate(G4String& error)
+{
+    for (G4int k = 0; k < 3; k++) {
+        if (edges[k].size() < 2 || !std::is_sorted(edges[k].begin(), edges[k].end())) {
+            error = "mesh edges along axis " + std::to_string(k) + " are not increasing";
+            return false;
+        }
+    }
+    if (geometry == kCylindrical) {
+        G4ThreeVector a(axis[0], axis[1], axis[2]), v(vec[0], vec[1], vec[2]);
+        v -= v.dot(a.unit()) * a.unit();
+        if (a.mag2() == 0. || v.mag2() == 0.) {
+            error = "cylinder axis and theta = 0 direction must be independent";
+            return false;
+        }
+        a = a.unit(); v = v.unit();
+        for (G4int k = 0; k < 3; k++) { axis[k] = a[k]; vec[k] = v[k]; }
+    }
+    G4bool any = false;
+    for (G4int p = 0; p < 2; p++) {
+        if (lower[p].size() != energies[p].size() * NVoxels()) {
+            error = "lower bounds do not match the mesh and energy groups";
+            return false;
+        }
+        any = any || HasWindows(p);
+    }
+    if (!any) {
+        error = "no neutron or photon windows";
+        return false;
+    }
+    return true;
+}
+
+G4bool NESSAWeightWindowMesh::Read(const G4String& file, G4String& error)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) {
+        error = "cannot open " + file;
+        return false;
+    }
+    char magic[8] = {};
+    in.read(magic, 8);
+    in.clear();
+    in.seekg(0);
+    G4bool ok = (std::memcmp(magic, "NESSAWWB", 8) == 0) ? ReadBinary(in, error)
+                                                        : ReadWWINP(in, error);
+    if (ok) ok = Validate(error);
+    if (!ok) error = file + ": " + error;
+    return ok;
+}
+
+G4bool NESSAWeightWindowMesh::ReadWWINP(std::istream& in, G4String& error)
+{
+    // Block 1: if iv ni nr probid
+    std::string line;
+    std::getline(in, line);
+    std::istringstream head(line);
+    G4int fileType = 0, iv = 0, ni = 0, nr = 0;
+    head >> fileType >> iv >> ni >> nr;
+    if (head.fail() || ni < 1 || (nr != 10 && nr != 16)) {
+        error = "not a wwinp file (expected 'if iv ni nr' on the first line)";
+        return false;
+    }
+    if (iv == 2) {
+        error = "time-dependent windows are not supported";
+        return false;
+    }
+    
+    // The rest is whitespace-separated numbers (fixed-width fields that
+    // always carry a leading blank)
+    std::vector<G4double> v;
+    G4double x;
+    while (in >> x) v.push_back(x);
+    std::size_t at = 0;
+    auto take = [&](std::size_t n) {
+        if (at + n > v.size()) throw std::runtime_error("wwinp file is truncated");
+        at += n;
+        return &v[at - n];
+    };
+    
+    try {
+        const G4double* ne = take(ni);
+        std::vector<G4int> nGroups(ne, ne + ni);
+        const G4double* b1 = take(6);
+        const G4int nf[3] = {(G4int)b1[0], (G4int)b1[1], (G4int)b1[2]};
+        for (G4int k = 0; k < 3; k++) origin[k] = b1[3 + k];
+        G4int nc[3], nwg;
+        if (nr == 10) {
+            const G4double* b = take(4);
+            for (G4int k = 0; k < 3; k++) nc[k] = (G4int)b[k];
+            nwg = (G4int)b[3];
+        } else {
+            // Cylinder: points at the top of the axis and along theta = 0
+            const G4double* b = take(10);
+            for (G4int k = 0; k < 3; k++) {
+                nc[k] = (G4int)b[k];
+                axis[k] = b[3 + k] - origin[k];
+                vec[k] = b[6 + k] - origin[k];
+            }
+            nwg = (G4int)b[9];
+        }
+        if (nwg != kCartesian && nwg != kCylindrical) {
+            error = "only rectangular and cylindrical meshes are supported";
+            return false;
+        }
+        geometry = (Geometry)nwg;
+        
+        // Block 2: per axis, the start and (ratio, end, fine meshes) of
+        // every coarse mesh; fine meshes are equal within a coarse mesh
+        for (G4int k = 0; k < 3; k++) {
+            edges[k].assign(1, *take(1));
+            for (G4int c = 0; c < nc[k]; c++) {
+                const G4double* t = take(3);
+                const G4double lo = edges[k].back(), hi = t[1];
+                const G4int nFine = (G4int)t[2];
+                for (G4int i = 1; i <= nFine; i++) edges[k].push_back(lo + (hi - lo) * i / nFine);
+            }
+            if (NBins(k) != nf[k]) {
+                error = "fine mesh count does not match the coarse meshes";
+                return false;
+            }
+        }
+        
+        // Block 3: per particle type, energies then lower bounds, x fastest;
+        // types beyond the second (MCNP6) are skipped
+        for (G4int p = 0; p < ni; p++) {
+            const G4int n = nGroups[p];
+            const G4double* e = take(n);
+            const G4double* w = take(n * NVoxels());
+            if (p >= 2) continue;
+            energies[p].assign(e, e + n);
+            lower[p].assign(w, w + n * NVoxels());
+        }
+    } catch (const std::exception& ex) {
+        error = ex.what();
+        return false;
+    }
+    return true;
+}
+
+G4bool NESSAWeightWindowMesh::ReadBinary(std::istream& in, G4String& error)
+{
+    WeightWindowFileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || header.version != kWeightWindowFileVersion) {
+        error = "unsupported binary weight-window file version";
+        return false;
+    }
+    geometry = (Geometry)header.geometry;
+    for (G4int k = 0; k < 3; k++) {
+        origin[k] = header.origin[k];
+        axis[k] = header.axis[k];
+        vec[k] = header.vec[k];
+    }
+    auto readDoubles = [&](std::vector<G4double>& to, std::size_t n) {
+        to.resize(n);
+        in.read(reinterpret_cast<char*>(to.data()), n * sizeof(G4double));
+    };
+    for (G4int k = 0; k < 3; k++) readDoubles(edges[k], header.n[k] + 1);
+    for (G4int p = 0; p < 2; p++) {
+        readDoubles(energies[p], header.nEnergy[p]);
+        readDoubles(lower[p], (std::size_t)header.nEnergy[p] * NVoxels());
+    }
+    if (!in) {
+        error = "binary weight-window file is truncated";
+        return false;
+    }
+    return true;
+}
+
+G4bool NESSAWeightWindowMesh::Write(const G4String& file, G4String& error) const
+{
+    const G4bool binary = file.size() > 4 && file.substr(file.size() - 4) == ".bin";
+    std::ofstream out(file, binary ? std::ios::binary : std::ios::out);
+    if (!out.is_open() || !(binary ? WriteBinary(out) : WriteWWINP(out))) {
+        error = "cannot write " + file;
+        return false;
+    }
+    return true;
+}
+
+G4bool NESSAWeightWindowMesh::WriteWWINP(std::ostream& out) const
+{
+    // Both particle types are written (ne = 0 for one without windows);
+    // every fine mesh is its own coarse mesh
+    const G4int nr = (geometry == kCartesian) ? 10 : 16;
+    out << std::setw(10) << 1 << std::setw(10) << 1 << std::setw(10) << 2
+        << std::setw(10) << nr << std::string(20, ' ') << "NESSA weight windows\n";
+    out << std::setw(10) << energies[0].size() << std::setw(10) << energies[1].size() << "\n";
+    
+    out << std::uppercase << std::scientific << std::setprecision(5);
+    G4int column = 0;
+    auto put = [&](G4double x) {
+        out << std::setw(13) << x;
+        if (++column == 6) { out << "\n"; column = 0; }
+    };
+    auto endLine = [&]() {
+        if (column != 0) out << "\n";
+        column = 0;
+    };
+    
+    for (G4int k = 0; k < 3; k++) put(NBins(k));
+    for (G4int k = 0; k < 3; k++) put(origin[k]);
+    endLine();
+    for (G4int k = 0; k < 3; k++) put(NBins(k));
+    if (geometry == kCartesian) {
+        put(1);
+    } else {
+        // Top of the axis (at the last z edge) and a point along theta = 0
+        for (G4int k = 0; k < 3; k++) put(origin[k] + edges[1].back() * axis[k]);
+        endLine();
+        for (G4int k = 0; k < 3; k++) put(origin[k] + edges[0].back() * vec[k]);
+        put(2);
+    }
+    endLine();
+    
+    for (G4int k = 0; k < 3; k++) {
+        put(edges[k][0]);
+        for (G4int i = 1; i <= NBins(k); i++) {
+            put(1.);
+            put(edges[k][i]);
+            put(1.);
+        }
+        endLine();
+    }
+    
+    for (G4int p = 0; p < 2; p++) {
+        if (!HasWindows(p)) continue;
+        for (G4double e : energies[p]) put(e);
+        endLine();
+        for (G4double w : lower[p]) put(w);
+        endLine();
+    }
+    return (bool)out;
+}
+
+G4bool NESSAWeightWindowMesh::WriteBinary(std::ostream& out) const
+{
+    WeightWindowFileHeader header{};
+    std::memcpy(header.magic, "NESSAWWB", 8);
+    header.version = kWeightWindowFileVersion;
+    header.geometry = geometry;
+    for (G4int k = 0; k < 3; k++) {
+        header.n[k] = NBins(k);
+        header.origin[k] = origin[k];
+        header.axis[k] = axis[k];
+        header.vec[k] = vec[k];
+    }
+    for (G4int p = 0; p < 2; p++) header.nEnergy[p] = (int32_t)energies[p].size();
+    
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    auto writeDoubles = [&](const std::vector<G4double>& from) {
+        out.write(reinterpret_cast<const char*>(from.data()), from.size() * sizeof(G4double));
+    };
+    for (G4int k = 0; k < 3; k++) writeDoubles(edges[k]);
+    for (G4int p = 0; p < 2; p++) {
+        writeDoubles(energies[p]);
+        writeDoubles(lower[p]);
+    }
+    return (bool)out;
+}
@@ -0,0 +1,281 @@
+#include "NESSAWeightWindowMessenger.hh"
+#include "NESSAWeightWindowConfig.hh"
+
+#include "G4UImanager.hh"
+#include "globals.hh"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+
+NESSAWeightWindowMessenger::NESSAWeightWindowMessenger()
+{
+    // /nessa/ itself is created by NESSADetectorMessenger
+    fWWDir = new G4UIdirectory("/nessa/ww/", false);
+    fWWDir->SetGuidance("Mesh weight windows (splitting and roulette on weight)");
+    
+    fReadCmd = new G4UIcmdWithAString("/nessa/ww/read", this);
+    fReadCmd->SetGuidance("Read weight windows: an MCNP wwinp file (rectangular or");
+    fReadCmd->SetGuidance("cylindrical mesh, n and p) or a NESSA binary window file.");
+    fReadCmd->SetGuidance("The windows are applied from the next run.");
+    fReadCmd->SetParameterName("file", false);
+    
+    fWriteCmd = new G4UIcmdWithAString("/nessa/ww/write", this);
+    fWriteCmd->SetGuidance("Write the current windows (.bin = binary, else wwinp)");
+    fWriteCmd->SetParameterName("file", false);
+    
+    fBoundsCmd = new G4UIcmdWithAString("/nessa/ww/bounds", this);
+    fBoundsCmd->SetGuidance("Window parameters as MCNP WWP: wupn wsurvn mxspln");
+    fBoundsCmd->SetGuidance("  upper bound = wupn x lower (default 5)");
+    fBoundsCmd->SetGuidance("  roulette survival weight = wsurvn x lower (default 3)");
+    fBoundsCmd->SetGuidance("  most tracks made by one split (default 5)");
+    fBoundsCmd->SetParameterName("params", false);
+    
+    fScaleCmd = new G4UIcmdWithADouble("/nessa/ww/scale", this);
+    fScaleCmd->SetGuidance("Multiply all lower bounds (source weight normalisation)");
+    fScaleCmd->SetParameterName("factor", false);
+    fScaleCmd->SetRange("factor>0");
+    
+    fOffCmd = new G4UIcmdWithoutParameter("/nessa/ww/off", this);
+    fOffCmd->SetGuidance("Drop the weight windows");
+    
+    fInfoCmd = new G4UIcmdWithoutParameter("/nessa/ww/info", this);
+    fInfoCmd->SetGuidance("Describe the current weight windows");
+    
+    fGenDir = new G4UIdirectory("/nessa/ww/gen/", false);
+    fGenDir->SetGuidance("Weight-window generator: importance toward target detectors");
+    fGenDir->SetGuidance("from forward runs; every run writes and loads new windows");
+    
+    fGenMeshCmd = new G4UIcmdWithAString("/nessa/ww/gen/mesh", this);
+    fGenMeshCmd->SetGuidance("Generator mesh: x0 y0 z0 x1 y1 z1 nx ny nz");
+    fGenMeshCmd->SetGuidance("Box corners in global coordinates [cm], voxels per axis.");
+    fGenMeshCmd->SetGuidance("Drops the estimates of earlier passes.");
+    fGenMeshCmd->SetParameterName("params", false);
+    
+    fGenEnergiesCmd = new G4UIcmdWithAString("/nessa/ww/gen/energies", this);
+    fGenEnergiesCmd->SetGuidance("Energy groups: n|g e1 e2 ... (upper bounds, MeV, rising;");
+    fGenEnergiesCmd->SetGuidance("default one group to 20 MeV). Drops earlier estimates.");
+    fGenEnergiesCmd->SetParameterName("params", false);
+    
+    fGenTargetCmd = new G4UIcmdWithAString("/nessa/ww/gen/target", this);
+    fGenTargetCmd->SetGuidance("Detectors whose flux the windows optimise, by name");
+    fGenTargetCmd->SetGuidance("(e.g. OutsideFront AboveRoof)");
+    fGenTargetCmd->SetParameterName("names", false);
+    
+    fGenParticleCmd = new G4UIcmdWithAString("/nessa/ww/gen/particle", this);
+    fGenParticleCmd->SetGuidance("Target flux scored: n | g | both (default both)");
+    fGenParticleCmd->SetParameterName("particle", false);
+    
+    fGenMinHitsCmd = new G4UIcmdWithAnInteger("/nessa/ww/gen/minHits", this);
+    fGenMinHitsCmd->SetGuidance("Entries leading to a target score a bin needs before it");
+    fGenMinHitsCmd->SetGuidance("gets a window (default 10)");
+    fGenMinHitsCmd->SetParameterName("n", false);
+    fGenMinHitsCmd->SetRange("n>=1");
+    
+    fGenFileCmd = new G4UIcmdWithAString("/nessa/ww/gen/file", this);
+    fGenFileCmd->SetGuidance("Window file written after each pass (.bin = binary, else");
+    fGenFileCmd->SetGuidance("wwinp; default <output>_ww.bin)");
+    fGenFileCmd->SetParameterName("file", false);
+    
+    fGenIterateCmd = new G4UIcmdWithAString("/nessa/ww/gen/iterate", this);
+    fGenIterateCmd->SetGuidance("Run up to 'passes' runs of 'events' each, until the number");
+    fGenIterateCmd->SetGuidance("of tracks scoring in the targets per source particle");
+    fGenIterateCmd->SetGuidance("changes by less than tolerance (default 0.1) between passes");
+    fGenIterateCmd->SetParameterName("params", false);
+    
+    fGenResetCmd = new G4UIcmdWithoutParameter("/nessa/ww/gen/reset", this);
+    fGenResetCmd->SetGuidance("Drop the estimates of earlier passes");
+    
+    fGenOffCmd = new G4UIcmdWithoutParameter("/nessa/ww/gen/off", this);
+    fGenOffCmd->SetGuidance("Stop generating (the last windows stay loaded)");
+}
+
+NESSAWeightWindowMessenger::~NESSAWeightWindowMessenger()
+{
+    delete fReadCmd; delete fWriteCmd; delete fBoundsCmd; delete fScaleCmd;
+    delete fOffCmd; delete fInfoCmd; delete fWWDir;
+    delete fGenMeshCmd; delete fGenEnergiesCmd; delete fGenTargetCmd; delete fGenParticleCmd;
+    delete fGenMinHitsCmd; delete fGenFileCmd; delete fGenIterateCmd; delete fGenResetCmd;
+    delete fGenOffCmd; delete fGenDir;
+}
+
+void NESSAWeightWindowMessenger::SetNewValue(G4UIcommand* cmd, G4String val)
+{
+    auto& config = NESSAWeightWindowConfig::Instance();
+    
+    if (cmd == fReadCmd) {
+        auto mesh = std::make_shared<NESSAWeightWindowMesh>();
+        G4String error;
+        if (!mesh->Read(val, error)) {
+            G4Exception("NESSAWeightWindowMessenger::SetNewValue", "WW001", JustWarning,
+                ("Cannot read weight windows: " + error).c_str());
+            return;
+        }
+        config.SetMesh(mesh);
+        G4cout << "Read weight windows from " << val << G4endl;
+    }
+    else if (cmd == fWriteCmd) {
+        auto mesh = config.GetMesh();
+        G4String error;
+        if (!mesh) {
+            G4Exception("NESSAWeightWindowMessenger::SetNewValue", "WW002", JustWarning,
+                "No weight windows to write");
+        } else if (!mesh->Write(val, error)) {
+            G4Exception("NESSAWeightWindowMessenger::SetNewValue", "WW002", JustWarning,
+                error.c_str());
+        }
+    }
+    else if (cmd == fBoundsCmd) {
+        std::istringstream iss(val);
+        G4double upper = 0., survival = 0.;
+        G4int maxSplit = 0;
+        iss >> upper >> survival >> maxSplit;
+        if (iss.fail() || !(survival > 1. && upper >= survival) || maxSplit < 1) {
+            G4Exception("NESSAWeightWindowMessenger::SetNewValue", "WW003", JustWarning,
+                ("Usage: bounds wupn wsurvn mxspln (1 < wsurvn <= wupn, mxspln >= 1), got: "
+                 + val).c_str());
+            return;
+        }
+        config.SetBounds(upper, survival, maxSplit);
+    }
+    else if (cmd == fScaleCmd) {
+        config.SetScale(fScaleCmd->GetNewDoubleValue(val));
+    }
+    else if (cmd == fOffCmd) {
+        config.SetMesh(nullptr);
+    }
+    else if (cmd == fInfoCmd) {
+        auto mesh = config.GetMesh();
+        G4cout << "\n=== NESSA Weight Windows ===" << G4endl;
+        if (!mesh) {
+            G4cout << "  none" << G4endl;
+            return;
+        }
+        static const char* axes[2][3] = {{"x", "y", "z"}, {"r", "z", "theta"}};
+        const G4int g = (mesh->geometry == NESSAWeightWindowMesh::kCartesian) ? 0 : 1;
+        for (G4int k = 0; k < 3; k++) {
+            G4cout << "  " << axes[g][k] << ": " << mesh->NBins(k) << " bins, "
+                   << mesh->edges[k].front() << " .. " << mesh->edges[k].back()
+                   << (g == 1 && k == 2 ? " rev" : " cm") << G4endl;
+        }
+        static const char* names[2] = {"neutron", "gamma"};
+        for (G4int p = 0; p < 2; p++) {
+            if (!mesh->HasWindows(p)) continue;
+            const auto& wl = mesh->lower[p];
+            G4long nSet = std::count_if(wl.begin(), wl.end(), [](G4double w) { return w > 0.; });
+            G4cout << "  " << names[p] << ": " << mesh->energies[p].size() << " groups to "
+                   << mesh->energies[p].back() << " MeV, " << nSet << "/" << wl.size()
+                   << " bounds set" << G4endl;
+        }
+        G4cout << "  wupn " << config.GetUpperRatio() << ", wsurvn " << config.GetSurvivalRatio()
+               << ", mxspln " << config.GetMaxSplit() << ", scale " << config.GetScale()
+               << G4endl;
+    }
+    else if (cmd == fGenMeshCmd) {
+        std::istringstream iss(val);
+        G4double lo[3], hi[3];
+        G4int n[3];
+        iss >> lo[0] >> lo[1] >> lo[2] >> hi[0] >> hi[1] >> hi[2] >> n[0] >> n[1] >> n[2];
+        G4bool ok = !iss.fail();
+        for (G4int k = 0; ok && k < 3; k++) {
+            if (lo[k] > hi[k]) std::swap(lo[k], hi[k]);
+            ok = n[k] > 0 && hi[k] > lo[k];
+        }
+        if (!ok) {
+            G4Exception("NESSAWeightWindowMessenger::SetNewValue", "WW006", JustWarning,
+                ("Usage: mesh x0 y0 z0 x1 y1 z1 nx ny nz, got: " + val).c_str());
+            return;
+        }
+        auto previous = config.GetGeneratorMesh();
+        auto mesh = std::make_shared<NESSAWeightWindowMesh>();
+        for (G4int k = 0; k < 3; k++) {
+            for (G4int i = 0; i <= n[k]; i++)
+                mesh->edges[k].push_back(lo[k] + (hi[k] - lo[k]) * i / n[k]);
+        }
+        for (G4int p = 0; p < 2; p++) {
+            mesh->energies[p] = previous ? previous->energies[p] : std::vector<G4double>{20.};
+        }
+        config.SetGeneratorMesh(mesh);
+    }
+    else if (cmd == fGenEnergiesCmd) {
+        std::istringstream iss(val);
+        G4String part;
+        iss >> part;
+        std::vector<G4double> bounds;
+        G4double e;
+        while (iss >> e) bounds.push_back(e);
+        G4bool ok = (part == "n" || part == "g") && !bounds.empty() && bounds.front() > 0.
+                    && std::is_sorted(bounds.begin(), bounds.end(), std::less_equal<G4double>());
+        auto previous = config.GetGeneratorMesh();
+        if (!ok || !previous) {
+            G4Exception("NESSAWeightWindowMessenger::SetNewValue", "WW006", JustWarning,
+                (previous ? "Usage: energies n|g e1 e2 ... (rising, MeV), got: " + val
+                          : G4String("Define the generator mesh first")).c_str());
+            return;
+        }
+        auto mesh = std::make_shared<NESSAWeightWindowMesh>(*previous);
+        mesh->energies[part == "n" ? 0 : 1] = bounds;
+        config.SetGeneratorMesh(mesh);
+    }
+    else if (cmd == fGenTargetCmd) {
+        std::istringstream iss(val);
+        std::vector<G4String> names;
+        G4String name;
+        while (iss >> name) names.push_back(name);
+        config.SetTargets(names);
+    }
+    else if (cmd == fGenParticleCmd) {
+        if (val == "n") config.SetTargetParticle(0);
+        else if (val == "g") config.SetTargetParticle(1);
+        else if (val == "both") config.SetTargetParticle(2);
+        else {
+            G4Exception("NESSAWeightWindowMessenger::SetNewValue", "WW006", JustWarning,
+                ("Usage: particle n|g|both, got: " + val).c_str());
+        }
+    }
+    else if (cmd == fGenMinHitsCmd) {
+        config.SetMinHits(fGenMinHitsCmd->GetNewIntValue(val));
+    }
+    else if (cmd == fGenFileCmd) {
+        config.SetGeneratorFile(val);
+    }
+    else if (cmd == fGenResetCmd) {
+        config.ResetEstimates();
+    }
+    else if (cmd == fGenOffCmd) {
+        config.SetGeneratorMesh(nullptr);
+    }
+    else if (cmd == fGenIterateCmd) {
+        std::istringstream iss(val);
+        G4int nPasses = 0, nEvents = 0;
+        G4double tolerance = 0.1;
+        iss >> nPasses >> nEvents;
+        G4String rest;
+        if (!iss.fail() && (iss >> rest)) {
+            std::istringstream tol(rest);
+            if (!(tol >> tolerance)) tolerance = -1.;
+        }
+        if (nPasses < 1 || nEvents < 1 || !(tolerance > 0.) || !config.GetGeneratorMesh()
+            || config.GetTargets().empty()) {
+            G4Exception("NESSAWeightWindowMessenger::SetNewValue", "WW006", JustWarning,
+                ("Usage: iterate passes events [tolerance], with the generator mesh and "
+                 "targets set; got: " + val).c_str());
+            return;
+        }
+        // Each pass is an ordinary run: the run action makes and loads the
+        // windows at its end
+        auto* ui = G4UImanager::GetUIpointer();
+        for (G4int i = 0; i < nPasses; i++) {
+            if (ui->ApplyCommand("/run/beamOn " + std::to_string(nEvents)) != 0) break;
+            const auto& passes = config.GetPasses();
+            if (passes.size() < 2) continue;
+            const G4double last = passes.back().population;
+            const G4double previous = passes[passes.size() - 2].population;
+            if (last > 0. && previous > 0. && std::abs(last - previous) < tolerance * previous) {
+                G4cout << "Weight-window generator: target population stable after "
+                       << passes.size() << " passes" << G4endl;
+                break;
+            }
+        }
+    }
+}